@@ -1,6 +1,9 @@
 #include "json.h"
 
+#include <cctype>
+#include <charconv>
 #include <iterator>
+#include <string>
 
 namespace json
 {
@@ -9,421 +12,606 @@ namespace
 {
 using namespace std::literals;
 
-Node LoadNode(std::istream &input);
-Node LoadString(std::istream &input);
+//significant digits of DoubleFormat::PRECISION_6
+const int DOUBLE_PRECISION = 6;
+const size_t INDENT_STEP = 4;
 
-std::string LoadLiteral(std::istream &input)
+//Parser over the whole text in memory, strings without escapes become views into it
+class Parser
 {
-    std::string s;
-    while (std::isalpha(input.peek()))
+public:
+    Parser(std::string_view text)
+        : pos_(text.data()), end_(text.data() + text.size())
     {
-        s.push_back(static_cast<char>(input.get()));
     }
-    return s;
-}
 
-Node LoadArray(std::istream &input)
-{
-    std::vector<Node> result;
+    Node LoadNode()
+    {
+        char c;
+        if (!ReadChar(c))
+        {
+            throw ParsingError("Unexpected EOF"s);
+        }
+        switch (c)
+        {
+        case '[':
+            return LoadArray();
+        case '{':
+            return LoadDict();
+        case '"':
+            return LoadString();
+        case 't':
+            // Встретив t или f, переходим к попытке парсинга
+            // литералов true либо false
+            [[fallthrough]];
+        case 'f':
+            --pos_;
+            return LoadBool();
+        case 'n':
+            --pos_;
+            return LoadNull();
+        default:
+            --pos_;
+            return LoadNumber();
+        }
+    }
+
+private:
+    static bool IsSpace(char c)
+    {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+    }
 
-    for (char c; input >> c && c != ']';)
+    static bool IsDigit(char c)
     {
-        if (c != ',')
+        return c >= '0' && c <= '9';
+    }
+
+    //skips spaces and reads the next character
+    bool ReadChar(char &c)
+    {
+        while (pos_ != end_ && IsSpace(*pos_))
         {
-            input.putback(c);
+            ++pos_;
         }
-        result.push_back(LoadNode(input));
+        if (pos_ == end_)
+        {
+            return false;
+        }
+        c = *pos_++;
+        return true;
     }
-    if (!input)
+
+    std::string_view LoadLiteral()
     {
-        throw ParsingError("Array parsing error"s);
+        const char *begin = pos_;
+        while (pos_ != end_ && std::isalpha(static_cast<unsigned char>(*pos_)))
+        {
+            ++pos_;
+        }
+        return {begin, static_cast<size_t>(pos_ - begin)};
     }
-    return Node(std::move(result));
-}
 
-Node LoadDict(std::istream &input)
-{
-    Dict dict;
+    Node LoadArray()
+    {
+        std::vector<Node> result;
+
+        char c;
+        bool is_closed = false;
+        while (ReadChar(c))
+        {
+            if (c == ']')
+            {
+                is_closed = true;
+                break;
+            }
+            if (c != ',')
+            {
+                --pos_;
+            }
+            result.push_back(LoadNode());
+        }
+        if (!is_closed)
+        {
+            throw ParsingError("Array parsing error"s);
+        }
+        return Node(std::move(result));
+    }
 
-    for (char c; input >> c && c != '}';)
+    Node LoadDict()
     {
-        if (c == '"')
+        Dict dict;
+
+        char c;
+        bool is_closed = false;
+        while (ReadChar(c))
         {
-            std::string key = LoadString(input).AsString();
-            if (input >> c && c == ':')
+            if (c == '}')
+            {
+                is_closed = true;
+                break;
+            }
+            if (c == '"')
             {
-                if (dict.find(key) != dict.end())
+                const Node key = LoadString();
+                if (ReadChar(c) && c == ':')
                 {
-                    throw ParsingError("Duplicate key '"s + key + "' have been found");
+                    if (dict.find(key.AsString()) != dict.end())
+                    {
+                        throw ParsingError("Duplicate key '"s + std::string(key.AsString()) + "' have been found");
+                    }
+                    dict.emplace(std::string(key.AsString()), LoadNode());
+                }
+                else
+                {
+                    throw ParsingError(": is expected but '"s + c + "' has been found"s);
                 }
-                dict.emplace(std::move(key), LoadNode(input));
             }
-            else
+            else if (c != ',')
             {
-                throw ParsingError(": is expected but '"s + c + "' has been found"s);
+                throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
             }
         }
-        else if (c != ',')
+        if (!is_closed)
         {
-            throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+            throw ParsingError("Dictionary parsing error"s);
         }
+        return Node(std::move(dict));
     }
-    if (!input)
-    {
-        throw ParsingError("Dictionary parsing error"s);
-    }
-    return Node(std::move(dict));
-}
 
-Node LoadString(std::istream &input)
-{
-    auto it = std::istreambuf_iterator<char>(input);
-    auto end = std::istreambuf_iterator<char>();
-    std::string s;
-    while (true)
+    //the opening quote is already read
+    Node LoadString()
     {
-        if (it == end)
+        const char *begin = pos_;
+        while (pos_ != end_ && *pos_ != '"' && *pos_ != '\\' && *pos_ != '\n' && *pos_ != '\r')
         {
-            throw ParsingError("String parsing error");
+            ++pos_;
         }
-        const char ch = *it;
-        if (ch == '"')
+        if (pos_ != end_ && *pos_ == '"')
         {
-            ++it;
-            break;
+            return Node(std::string_view(begin, static_cast<size_t>(pos_++ - begin)));
         }
-        else if (ch == '\\')
+
+        //only strings with escapes are copied
+        std::string s(begin, pos_);
+        while (true)
         {
-            ++it;
-            if (it == end)
+            if (pos_ == end_)
             {
                 throw ParsingError("String parsing error");
             }
-            const char escaped_char = *(it);
-            switch (escaped_char)
+            const char ch = *pos_++;
+            if (ch == '"')
             {
-            case 'n':
-                s.push_back('\n');
-                break;
-            case 't':
-                s.push_back('\t');
                 break;
-            case 'r':
-                s.push_back('\r');
-                break;
-            case '"':
-                s.push_back('"');
-                break;
-            case '\\':
-                s.push_back('\\');
-                break;
-            default:
-                throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
+            }
+            else if (ch == '\\')
+            {
+                if (pos_ == end_)
+                {
+                    throw ParsingError("String parsing error");
+                }
+                const char escaped_char = *pos_++;
+                switch (escaped_char)
+                {
+                case 'n':
+                    s.push_back('\n');
+                    break;
+                case 't':
+                    s.push_back('\t');
+                    break;
+                case 'r':
+                    s.push_back('\r');
+                    break;
+                case '"':
+                    s.push_back('"');
+                    break;
+                case '\\':
+                    s.push_back('\\');
+                    break;
+                default:
+                    throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
+                }
+            }
+            else if (ch == '\n' || ch == '\r')
+            {
+                throw ParsingError("Unexpected end of line"s);
+            }
+            else
+            {
+                s.push_back(ch);
             }
         }
-        else if (ch == '\n' || ch == '\r')
+
+        return Node(std::move(s));
+    }
+
+    Node LoadBool()
+    {
+        const auto s = LoadLiteral();
+        if (s == "true"sv)
         {
-            throw ParsingError("Unexpected end of line"s);
+            return Node{true};
+        }
+        else if (s == "false"sv)
+        {
+            return Node{false};
         }
         else
         {
-            s.push_back(ch);
+            throw ParsingError("Failed to parse '"s + std::string(s) + "' as bool"s);
         }
-        ++it;
     }
 
-    return Node(std::move(s));
-}
-
-Node LoadBool(std::istream &input)
-{
-    const auto s = LoadLiteral(input);
-    if (s == "true"sv)
-    {
-        return Node{true};
-    }
-    else if (s == "false"sv)
+    Node LoadNull()
     {
-        return Node{false};
-    }
-    else
-    {
-        throw ParsingError("Failed to parse '"s + s + "' as bool"s);
+        if (auto literal = LoadLiteral(); literal == "null"sv)
+        {
+            return Node{nullptr};
+        }
+        else
+        {
+            throw ParsingError("Failed to parse '"s + std::string(literal) + "' as null"s);
+        }
     }
-}
 
-Node LoadNull(std::istream &input)
-{
-    if (auto literal = LoadLiteral(input); literal == "null"sv)
-    {
-        return Node{nullptr};
-    }
-    else
+    Node LoadNumber()
     {
-        throw ParsingError("Failed to parse '"s + literal + "' as null"s);
-    }
-}
+        const char *begin = pos_;
 
-Node LoadNumber(std::istream &input)
-{
-    std::string parsed_num;
+        auto peek = [this]
+        {
+            return pos_ != end_ ? *pos_ : '\0';
+        };
 
-    // Считывает в parsed_num очередной символ из input
-    auto read_char = [&parsed_num, &input]
-    {
-        parsed_num += static_cast<char>(input.get());
-        if (!input)
+        // Считывает одну или более цифр
+        auto read_digits = [this, &peek]
+        {
+            if (!IsDigit(peek()))
+            {
+                throw ParsingError("A digit is expected"s);
+            }
+            while (IsDigit(peek()))
+            {
+                ++pos_;
+            }
+        };
+
+        if (peek() == '-')
         {
-            throw ParsingError("Failed to read number from stream"s);
+            ++pos_;
         }
-    };
 
-    // Считывает одну или более цифр в parsed_num из input
-    auto read_digits = [&input, read_char]
-    {
-        if (!std::isdigit(input.peek()))
+        if (peek() == '0')
         {
-            throw ParsingError("A digit is expected"s);
+            ++pos_;
         }
-        while (std::isdigit(input.peek()))
+        else
         {
-            read_char();
+            read_digits();
         }
-    };
 
-    if (input.peek() == '-')
-    {
-        read_char();
-    }
+        bool is_int = true;
 
-    if (input.peek() == '0')
-    {
-        read_char();
-    }
-    else
-    {
-        read_digits();
+        // Парсим дробную часть числа
+        if (peek() == '.')
+        {
+            ++pos_;
+            read_digits();
+            is_int = false;
+        }
+
+        // Парсим экспоненциальную часть числа
+        if (char ch = peek(); ch == 'e' || ch == 'E')
+        {
+            ++pos_;
+            if (ch = peek(); ch == '+' || ch == '-')
+            {
+                ++pos_;
+            }
+            read_digits();
+            is_int = false;
+        }
+
+        if (is_int)
+        {
+            int value;
+            if (const auto [end, error] = std::from_chars(begin, pos_, value); error == std::errc{} && end == pos_)
+            {
+                return value;
+            }
+            // В случае неудачи, например, при переполнении
+            // код ниже попробует преобразовать строку в double
+        }
+        double value;
+        if (const auto [end, error] = std::from_chars(begin, pos_, value); error == std::errc{} && end == pos_)
+        {
+            return value;
+        }
+        throw ParsingError("Failed to convert "s + std::string(begin, pos_) + " to number"s);
     }
 
-    bool is_int = true;
+    const char *pos_;
+    const char *end_;
+};
+
+} // namespace
 
-    // Парсим дробную часть числа
-    if (input.peek() == '.')
+Dict::Dict(std::initializer_list<value_type> items)
+{
+    for (const value_type &item : items)
     {
-        read_char();
-        read_digits();
-        is_int = false;
+        emplace(item.first, item.second);
     }
+}
 
-    // Парсим экспоненциальную часть числа
-    if (int ch = input.peek(); ch == 'e' || ch == 'E')
+std::pair<Dict::iterator, bool> Dict::emplace(std::string key, Node value)
+{
+    if (sorted_positions_.empty())
     {
-        read_char();
-        if (ch = input.peek(); ch == '+' || ch == '-')
+        if (const auto iter = find(key); iter != end())
         {
-            read_char();
+            return {iter, false};
         }
-        read_digits();
-        is_int = false;
-    }
-
-    try
-    {
-        if (is_int)
+        items_.emplace_back(std::move(key), std::move(value));
+        if (items_.size() > LINEAR_SEARCH_SIZE)
         {
-            try
+            sorted_positions_.resize(items_.size());
+            for (uint32_t position = 0; position < items_.size(); position++)
             {
-                return std::stoi(parsed_num);
-            }
-            catch (...)
-            {
-                // В случае неудачи, например, при переполнении
-                // код ниже попробует преобразовать строку в double
+                sorted_positions_[position] = position;
             }
+            std::sort(sorted_positions_.begin(), sorted_positions_.end(), [this](uint32_t lhs, uint32_t rhs)
+                      { return items_[lhs].first < items_[rhs].first; });
         }
-        return std::stod(parsed_num);
+        return {std::prev(end()), true};
     }
-    catch (...)
+
+    const auto position = LowerBound(key);
+    if (position != sorted_positions_.end() && items_[*position].first == key)
     {
-        throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
+        return {begin() + *position, false};
     }
+    sorted_positions_.insert(position, static_cast<uint32_t>(items_.size()));
+    items_.emplace_back(std::move(key), std::move(value));
+    return {std::prev(end()), true};
 }
 
-Node LoadNode(std::istream &input)
+const Node &Dict::at(std::string_view key) const
 {
-    char c;
-    if (!(input >> c))
+    const auto iter = find(key);
+    if (iter == end())
     {
-        throw ParsingError("Unexpected EOF"s);
-    }
-    switch (c)
-    {
-    case '[':
-        return LoadArray(input);
-    case '{':
-        return LoadDict(input);
-    case '"':
-        return LoadString(input);
-    case 't':
-        // Встретив t или f, переходим к попытке парсинга
-        // литералов true либо false
-        [[fallthrough]];
-    case 'f':
-        input.putback(c);
-        return LoadBool(input);
-    case 'n':
-        input.putback(c);
-        return LoadNull(input);
-    default:
-        input.putback(c);
-        return LoadNumber(input);
+        throw std::out_of_range("No key '"s + std::string(key) + "' in the dictionary"s);
     }
+    return iter->second;
 }
 
-struct PrintContext
+bool operator==(const Dict &lhs, const Dict &rhs)
 {
-    std::ostream &out;
-    int indent_step = 4;
-    int indent = 0;
-
-    void PrintIndent() const
+    if (lhs.size() != rhs.size())
+    {
+        return false;
+    }
+    for (const auto &[key, value] : lhs)
     {
-        for (int i = 0; i < indent; ++i)
+        const auto iter = rhs.find(key);
+        if (iter == rhs.end() || iter->second != value)
         {
-            out.put(' ');
+            return false;
         }
     }
+    return true;
+}
 
-    PrintContext Indented() const
+Document Load(std::istream &input)
+{
+    const size_t CHUNK_SIZE = 1 << 16;
+    std::string text;
+    for (size_t size = 0;;)
     {
-        return {out, indent_step, indent_step + indent};
+        text.resize(size + CHUNK_SIZE);
+        const auto read_size = static_cast<size_t>(input.rdbuf()->sgetn(text.data() + size, CHUNK_SIZE));
+        size += read_size;
+        if (read_size < CHUNK_SIZE)
+        {
+            text.resize(size);
+            break;
+        }
     }
-};
+    return Load(std::move(text));
+}
 
-void PrintNode(const Node &value, const PrintContext &ctx);
+Document Load(std::string text)
+{
+    auto shared_text = std::make_shared<const std::string>(std::move(text));
+    Node root = Parser(*shared_text).LoadNode();
+    return Document{std::move(root), std::move(shared_text)};
+}
 
-template <typename Value>
-void PrintValue(const Value &value, const PrintContext &ctx)
+void Print(const Document &doc, std::ostream &output, DoubleFormat double_format)
 {
-    ctx.out << value;
+    std::string buffer;
+    Writer(buffer, double_format).Value(doc.GetRoot());
+    output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
 }
 
-void PrintString(const std::string &value, std::ostream &out)
+Writer::Writer(std::string &buffer, DoubleFormat double_format)
+    : buffer_(buffer), double_format_(double_format)
 {
-    out.put('"');
-    for (const char c : value)
-    {
-        switch (c)
-        {
-        case '\r':
-            out << "\\r"sv;
-            break;
-        case '\n':
-            out << "\\n"sv;
-            break;
-        case '"':
-            [[fallthrough]];
-        case '\\':
-            out.put('\\');
-            [[fallthrough]];
-        default:
-            out.put(c);
-            break;
-        }
-    }
-    out.put('"');
 }
 
-template <>
-void PrintValue<std::string>(const std::string &value, const PrintContext &ctx)
+Writer &Writer::StartDict()
 {
-    PrintString(value, ctx.out);
+    StartValue();
+    buffer_ += "{\n"sv;
+    is_empty_.push_back(true);
+    return *this;
 }
 
-template <>
-void PrintValue<std::nullptr_t>(const std::nullptr_t &, const PrintContext &ctx)
+Writer &Writer::EndDict()
 {
-    ctx.out << "null"sv;
+    is_empty_.pop_back();
+    buffer_.push_back('\n');
+    AppendIndent();
+    buffer_.push_back('}');
+    return *this;
 }
 
-template <>
-void PrintValue<bool>(const bool &value, const PrintContext &ctx)
+Writer &Writer::StartArray()
 {
-    ctx.out << (value ? "true"sv : "false"sv);
+    StartValue();
+    buffer_ += "[\n"sv;
+    is_empty_.push_back(true);
+    return *this;
 }
 
-template <>
-void PrintValue<Array>(const Array &nodes, const PrintContext &ctx)
+Writer &Writer::EndArray()
 {
-    std::ostream &out = ctx.out;
-    out << "[\n"sv;
-    bool first = true;
-    auto inner_ctx = ctx.Indented();
-    for (const Node &node : nodes)
-    {
-        if (first)
-        {
-            first = false;
-        }
-        else
-        {
-            out << ",\n"sv;
-        }
-        inner_ctx.PrintIndent();
-        PrintNode(node, inner_ctx);
-    }
-    out.put('\n');
-    ctx.PrintIndent();
-    out.put(']');
+    is_empty_.pop_back();
+    buffer_.push_back('\n');
+    AppendIndent();
+    buffer_.push_back(']');
+    return *this;
 }
 
-template <>
-void PrintValue<Dict>(const Dict &nodes, const PrintContext &ctx)
+Writer &Writer::Key(std::string_view key)
 {
-    std::ostream &out = ctx.out;
-    out << "{\n"sv;
-    bool first = true;
-    auto inner_ctx = ctx.Indented();
-    for (const auto &[key, node] : nodes)
+    StartValue();
+    AppendString(key);
+    buffer_ += ": "sv;
+    is_after_key_ = true;
+    return *this;
+}
+
+Writer &Writer::Null()
+{
+    StartValue();
+    buffer_ += "null"sv;
+    return *this;
+}
+
+Writer &Writer::Bool(bool value)
+{
+    StartValue();
+    buffer_ += value ? "true"sv : "false"sv;
+    return *this;
+}
+
+Writer &Writer::Int(int value)
+{
+    StartValue();
+    char text[16];
+    const auto result = std::to_chars(std::begin(text), std::end(text), value);
+    buffer_.append(text, result.ptr);
+    return *this;
+}
+
+Writer &Writer::Double(double value)
+{
+    StartValue();
+    char text[32];
+    const auto result = double_format_ == DoubleFormat::ROUND_TRIP
+                            ? std::to_chars(std::begin(text), std::end(text), value)
+                            : std::to_chars(std::begin(text), std::end(text), value, std::chars_format::general, DOUBLE_PRECISION);
+    buffer_.append(text, result.ptr);
+    return *this;
+}
+
+Writer &Writer::String(std::string_view value)
+{
+    StartValue();
+    AppendString(value);
+    return *this;
+}
+
+Writer &Writer::Value(const Node &node)
+{
+    if (node.IsNull())
     {
-        if (first)
-        {
-            first = false;
-        }
-        else
+        return Null();
+    }
+    if (node.IsBool())
+    {
+        return Bool(node.AsBool());
+    }
+    if (node.IsInt())
+    {
+        return Int(node.AsInt());
+    }
+    if (node.IsPureDouble())
+    {
+        return Double(node.AsDouble());
+    }
+    if (node.IsString())
+    {
+        return String(node.AsString());
+    }
+    if (node.IsArray())
+    {
+        StartArray();
+        for (const Node &item : node.AsArray())
         {
-            out << ",\n"sv;
+            Value(item);
         }
-        inner_ctx.PrintIndent();
-        PrintString(key, ctx.out);
-        out << ": "sv;
-        PrintNode(node, inner_ctx);
+        return EndArray();
     }
-    out.put('\n');
-    ctx.PrintIndent();
-    out.put('}');
+    StartDict();
+    for (const auto &[key, value] : node.AsDict())
+    {
+        Key(key).Value(value);
+    }
+    return EndDict();
 }
 
-void PrintNode(const Node &node, const PrintContext &ctx)
+void Writer::StartValue()
 {
-    std::visit(
-        [&ctx](const auto &value)
-        {
-            PrintValue(value, ctx);
-        },
-        node.GetValue());
+    if (is_after_key_)
+    {
+        is_after_key_ = false;
+        return;
+    }
+    if (is_empty_.empty())
+    {
+        return;
+    }
+    if (!is_empty_.back())
+    {
+        buffer_ += ",\n"sv;
+    }
+    is_empty_.back() = false;
+    AppendIndent();
 }
 
-} // namespace
-
-Document Load(std::istream &input)
+void Writer::AppendIndent()
 {
-    return Document{LoadNode(input)};
+    buffer_.append(INDENT_STEP * is_empty_.size(), ' ');
 }
 
-void Print(const Document &doc, std::ostream &output)
+void Writer::AppendString(std::string_view value)
 {
-    PrintNode(doc.GetRoot(), PrintContext{output});
+    buffer_.push_back('"');
+    for (const char c : value)
+    {
+        switch (c)
+        {
+        case '\r':
+            buffer_ += "\\r"sv;
+            break;
+        case '\n':
+            buffer_ += "\\n"sv;
+            break;
+        case '"':
+            [[fallthrough]];
+        case '\\':
+            buffer_.push_back('\\');
+            [[fallthrough]];
+        default:
+            buffer_.push_back(c);
+            break;
+        }
+    }
+    buffer_.push_back('"');
 }
 
-} // namespace json
\ No newline at end of file
+} // namespace json
@@ -1,8 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
 #include <iostream>
-#include <map>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -10,17 +16,72 @@ namespace json
 {
 
 class Node;
-using Dict = std::map<std::string, Node>;
 using Array = std::vector<Node>;
 
+//Pairs of a dictionary in the order they were added. Small dictionaries are searched linearly,
+//larger ones through positions of the pairs sorted by key. Keys are looked up as std::string_view.
+class Dict
+{
+public:
+    using value_type = std::pair<std::string, Node>;
+    using const_iterator = std::vector<value_type>::const_iterator;
+    using iterator = const_iterator;
+
+    Dict() = default;
+
+    Dict(std::initializer_list<value_type> items);
+
+    //does nothing and returns the pair with the key if there is one
+    std::pair<iterator, bool> emplace(std::string key, Node value);
+
+    iterator find(std::string_view key) const;
+
+    //throws std::out_of_range if there is no such key
+    const Node &at(std::string_view key) const;
+
+    size_t count(std::string_view key) const;
+
+    iterator begin() const;
+
+    iterator end() const;
+
+    size_t size() const;
+
+    bool empty() const;
+
+    //heap bytes of the pairs and the index, keys and values are not counted
+    size_t GetMemoryUsage() const;
+
+private:
+    //dictionaries up to this size have no index, a linear search over them is faster than the index
+    static constexpr size_t LINEAR_SEARCH_SIZE = 24;
+
+    //first of sorted_positions_ with a key not less than key
+    std::vector<uint32_t>::const_iterator LowerBound(std::string_view key) const;
+
+    std::vector<value_type> items_;
+    //positions of items_ sorted by key, empty for a small dictionary
+    std::vector<uint32_t> sorted_positions_;
+};
+
+//the same pairs in any order
+bool operator==(const Dict &lhs, const Dict &rhs);
+
+inline bool operator!=(const Dict &lhs, const Dict &rhs)
+{
+    return !(lhs == rhs);
+}
+
 class ParsingError : public std::runtime_error
 {
 public:
     using runtime_error::runtime_error;
 };
 
+//Strings without escapes are parsed as std::string_view into the text of the document,
+//such nodes are valid while the document is alive
 class Node final
-    : private std::variant<std::nullptr_t, Array, Dict, bool, int, double, std::string>
+    : private std::variant<std::nullptr_t, Array, Dict, bool, int, double, std::string, std::string_view>
 {
 public:
     using variant::variant;
@@ -96,11 +157,15 @@ public:
 
     bool IsString() const
     {
-        return std::holds_alternative<std::string>(*this);
+        return std::holds_alternative<std::string>(*this) || std::holds_alternative<std::string_view>(*this);
     }
-    const std::string &AsString() const
+    std::string_view AsString() const
     {
         using namespace std::literals;
+        if (const auto *value = std::get_if<std::string_view>(this))
+        {
+            return *value;
+        }
         if (!IsString())
         {
             throw std::logic_error("Not a string"s);
@@ -126,6 +191,10 @@ public:
 
     bool operator==(const Node &rhs) const
     {
+        if (IsString() && rhs.IsString())
+        {
+            return AsString() == rhs.AsString();
+        }
         return GetValue() == rhs.GetValue();
     }
 
@@ -144,6 +213,60 @@ inline bool operator!=(const Node &lhs, const Node &rhs)
     return !(lhs == rhs);
 }
 
+//members of Dict that need the complete Node
+
+inline Dict::iterator Dict::begin() const
+{
+    return items_.begin();
+}
+
+inline Dict::iterator Dict::end() const
+{
+    return items_.end();
+}
+
+inline size_t Dict::size() const
+{
+    return items_.size();
+}
+
+inline bool Dict::empty() const
+{
+    return items_.empty();
+}
+
+inline size_t Dict::GetMemoryUsage() const
+{
+    return items_.capacity() * sizeof(value_type) + sorted_positions_.capacity() * sizeof(uint32_t);
+}
+
+inline std::vector<uint32_t>::const_iterator Dict::LowerBound(std::string_view key) const
+{
+    return std::lower_bound(sorted_positions_.begin(), sorted_positions_.end(), key,
+                            [this](uint32_t position, std::string_view key)
+                            { return items_[position].first < key; });
+}
+
+inline Dict::iterator Dict::find(std::string_view key) const
+{
+    if (sorted_positions_.empty())
+    {
+        return std::find_if(items_.begin(), items_.end(), [key](const value_type &item)
+                            { return item.first == key; });
+    }
+    const auto position = LowerBound(key);
+    if (position != sorted_positions_.end() && items_[*position].first == key)
+    {
+        return items_.begin() + *position;
+    }
+    return items_.end();
+}
+
+inline size_t Dict::count(std::string_view key) const
+{
+    return find(key) != end() ? 1 : 0;
+}
+
 class Document
 {
 public:
@@ -152,13 +275,26 @@ public:
     {
     }
 
+    //strings of root may point into text, copies of the document share it
+    Document(Node root, std::shared_ptr<const std::string> text)
+        : root_(std::move(root)), text_(std::move(text))
+    {
+    }
+
     const Node &GetRoot() const
     {
         return root_;
     }
 
+    //size of the parsed text kept by the document, 0 for a built one
+    size_t GetTextSize() const
+    {
+        return text_ ? text_->size() : 0;
+    }
+
 private:
     Node root_;
+    std::shared_ptr<const std::string> text_;
 };
 
 inline bool operator==(const Document &lhs, const Document &rhs)
@@ -171,8 +307,65 @@ inline bool operator!=(const Document &lhs, const Document &rhs)
     return !(lhs == rhs);
 }
 
+//reads the rest of the stream into one buffer and parses it
 Document Load(std::istream &input);
 
-void Print(const Document &doc, std::ostream &output);
+Document Load(std::string text);
+
+//how doubles are written
+enum class DoubleFormat
+{
+    //%g with 6 significant digits like the default format of a stream, answers have always used it
+    PRECISION_6,
+    //the shortest text that is read back as the same double
+    ROUND_TRIP,
+};
+
+void Print(const Document &doc, std::ostream &output, DoubleFormat double_format = DoubleFormat::PRECISION_6);
+
+//Writes JSON text in the format of Print straight into a buffer without building nodes.
+//The calls must form a valid document. Keys go in the order of the calls like keys of a printed Dict.
+class Writer
+{
+public:
+    //text is appended to buffer, the caller may take it out and clear the buffer between calls
+    explicit Writer(std::string &buffer, DoubleFormat double_format = DoubleFormat::PRECISION_6);
+
+    Writer &StartDict();
+
+    Writer &EndDict();
+
+    Writer &StartArray();
+
+    Writer &EndArray();
+
+    Writer &Key(std::string_view key);
+
+    Writer &Null();
+
+    Writer &Bool(bool value);
+
+    Writer &Int(int value);
+
+    Writer &Double(double value);
+
+    Writer &String(std::string_view value);
+
+    Writer &Value(const Node &node);
+
+private:
+    //separator and indent of an item, nothing after a key
+    void StartValue();
+
+    void AppendIndent();
+
+    void AppendString(std::string_view value);
+
+    std::string &buffer_;
+    DoubleFormat double_format_;
+    //for every open container: it has no items yet
+    std::vector<bool> is_empty_;
+    bool is_after_key_ = false;
+};
 
 } // namespace json
\ No newline at end of file
@@ -0,0 +1,192 @@
+#include "json_stream.h"
+
+namespace json
+{
+
+namespace
+{
+using namespace std::literals;
+
+const size_t CHUNK_SIZE = 1 << 16;
+
+bool IsSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+} // namespace
+
+StreamReader::StreamReader(std::istream &input)
+    : input_(input)
+{
+}
+
+bool StreamReader::Fill()
+{
+    //the read part of the window is dropped, so it grows only for long values
+    buffer_.erase(0, pos_);
+    pos_ = 0;
+    const size_t size = buffer_.size();
+    buffer_.resize(size + CHUNK_SIZE);
+    const auto read_size = static_cast<size_t>(input_.rdbuf()->sgetn(buffer_.data() + size, CHUNK_SIZE));
+    buffer_.resize(size + read_size);
+    return read_size > 0;
+}
+
+char StreamReader::Peek()
+{
+    while (true)
+    {
+        while (pos_ < buffer_.size() && IsSpace(buffer_[pos_]))
+        {
+            ++pos_;
+        }
+        if (pos_ < buffer_.size())
+        {
+            return buffer_[pos_];
+        }
+        if (!Fill())
+        {
+            throw ParsingError("Unexpected EOF"s);
+        }
+    }
+}
+
+void StreamReader::Expect(char expected)
+{
+    if (const char c = Peek(); c != expected)
+    {
+        throw ParsingError("'"s + expected + "' is expected but '"s + c + "' has been found"s);
+    }
+    ++pos_;
+}
+
+bool StreamReader::NextKey(std::string &key)
+{
+    if (!is_dict_started_)
+    {
+        Expect('{');
+        is_dict_started_ = true;
+    }
+    if (Peek() == '}')
+    {
+        ++pos_;
+        return false;
+    }
+    if (!is_first_key_)
+    {
+        Expect(',');
+    }
+    is_first_key_ = false;
+    if (Peek() != '"')
+    {
+        throw ParsingError("A key is expected but '"s + Peek() + "' has been found"s);
+    }
+    key = Load(ExtractValue()).GetRoot().AsString();
+    Expect(':');
+    is_first_item_ = true;
+    return true;
+}
+
+Document StreamReader::ReadValue()
+{
+    return Load(ExtractValue());
+}
+
+void StreamReader::StartArray()
+{
+    Expect('[');
+    is_first_item_ = true;
+}
+
+std::optional<Document> StreamReader::NextItem()
+{
+    if (Peek() == ']')
+    {
+        ++pos_;
+        return std::nullopt;
+    }
+    if (!is_first_item_)
+    {
+        Expect(',');
+    }
+    is_first_item_ = false;
+    return Load(ExtractValue());
+}
+
+std::string StreamReader::ExtractValue()
+{
+    const char first = Peek();
+    //the window may move while it is filled, so the end is an offset from pos_
+    size_t size = 0;
+    int depth = 0;
+    bool in_string = false;
+    bool is_escaped = false;
+    while (true)
+    {
+        if (pos_ + size == buffer_.size())
+        {
+            if (!Fill())
+            {
+                //a number or a literal may end the input
+                if (depth == 0 && !in_string && first != '"')
+                {
+                    break;
+                }
+                throw ParsingError("Unexpected EOF"s);
+            }
+            continue;
+        }
+        const char c = buffer_[pos_ + size];
+        if (in_string)
+        {
+            ++size;
+            if (is_escaped)
+            {
+                is_escaped = false;
+            }
+            else if (c == '\\')
+            {
+                is_escaped = true;
+            }
+            else if (c == '"')
+            {
+                in_string = false;
+                if (depth == 0)
+                {
+                    break;
+                }
+            }
+            continue;
+        }
+        if (c == '"')
+        {
+            in_string = true;
+        }
+        else if (c == '{' || c == '[')
+        {
+            ++depth;
+        }
+        else if (c == '}' || c == ']')
+        {
+            if (depth == 0)
+            {
+                break;
+            }
+            --depth;
+        }
+        else if (depth == 0 && (c == ',' || IsSpace(c)))
+        {
+            break;
+        }
+        ++size;
+        if (depth == 0 && (c == '}' || c == ']'))
+        {
+            break;
+        }
+    }
+    std::string result = buffer_.substr(pos_, size);
+    pos_ += size;
+    return result;
+}
+
+} // namespace json
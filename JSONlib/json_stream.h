@@ -0,0 +1,59 @@
+#pragma once
+
+#include "json.h"
+
+#include <iostream>
+#include <optional>
+#include <string>
+
+namespace json
+{
+
+//Reads the root dictionary of a document key by key without loading the whole document.
+//An array value can be read item by item, every item is parsed as a document of its own,
+//so only the current item and a small window of the input are kept in memory.
+//Methods throw ParsingError if the input is broken.
+class StreamReader
+{
+public:
+    explicit StreamReader(std::istream &input);
+
+    //reads the next key of the root dictionary, false after the end of the dictionary
+    bool NextKey(std::string &key);
+
+    //parses the value of the current key
+    Document ReadValue();
+
+    //starts reading the value of the current key item by item, it must be an array
+    void StartArray();
+
+    //nullopt after the end of the array
+    std::optional<Document> NextItem();
+
+    //bytes of the input window
+    size_t GetBufferSize() const
+    {
+        return buffer_.capacity();
+    }
+
+private:
+    //appends the next chunk of the input to the window, false at the end of the input
+    bool Fill();
+
+    //skips spaces and returns the next character without reading it
+    char Peek();
+
+    void Expect(char expected);
+
+    //raw text of the value at the current position
+    std::string ExtractValue();
+
+    std::istream &input_;
+    std::string buffer_;
+    size_t pos_ = 0;
+    bool is_dict_started_ = false;
+    bool is_first_key_ = true;
+    bool is_first_item_ = true;
+};
+
+} // namespace json
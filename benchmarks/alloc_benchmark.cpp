@@ -0,0 +1,77 @@
+#include "counting_new.h"
+#include "frozen_catalogue.h"
+#include "serialization.h"
+#include "synthetic_city.h"
+
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+//Heap allocations made through operator new while the database of a synthetic city is written and loaded.
+//Writing starts from a loaded database, so only the serializer is counted and not the JSON or the router.
+//Usage: alloc_benchmark [stop_count]
+
+using namespace std::literals;
+using namespace transport_catalogue;
+
+namespace
+{
+void Count(std::string_view name, const std::function<void()> &action)
+{
+    const size_t count_before = benchmark::GetAllocationCount();
+    const size_t bytes_before = benchmark::GetAllocatedBytes();
+    action();
+    std::cout << name << ": "sv << benchmark::GetAllocationCount() - count_before << " allocations, "sv
+              << (benchmark::GetAllocatedBytes() - bytes_before) / 1024 << " KB"sv << std::endl;
+}
+
+std::ofstream OpenOutput(const std::string &file_name)
+{
+    std::ofstream output(file_name, std::ios::binary);
+    if (!output)
+    {
+        throw std::logic_error("Failed to open file: " + file_name);
+    }
+    return output;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    benchmark::CityParams params;
+    if (argc > 1)
+    {
+        params.stop_count = std::stoul(argv[1]);
+    }
+    const std::string file_name = "alloc_benchmark.db"s;
+    const std::string flat_file_name = "alloc_benchmark_flat.db"s;
+    std::cout << params.stop_count << " stops, "sv << params.bus_count << " buses"sv << std::endl;
+
+    Count("make_base with JSON and router"sv, [&]
+          { benchmark::MakeBase(benchmark::MakeCity(params, {{"file"s, file_name}})); });
+    const auto database = FrozenCatalogue::Load(file_name);
+    const transport_router::TransportRouter &router = *database->GetHandler().GetRouter();
+    serialization::Serializer serializer(database->GetCatalogue(), database->GetRenderer().GetSettings(), router);
+
+    Count("write protobuf stream"sv, [&]
+          {
+              std::ofstream output = OpenOutput(file_name);
+              serializer.SerializeToOstream(output);
+          });
+    Count("write flat"sv, [&]
+          {
+              std::ofstream output = OpenOutput(flat_file_name);
+              serializer.SerializeToFlatOstream(output);
+          });
+    Count("load protobuf stream"sv, [&]
+          { FrozenCatalogue::Load(file_name); });
+    Count("load flat"sv, [&]
+          { FrozenCatalogue::Load(flat_file_name); });
+
+    std::remove(file_name.c_str());
+    std::remove(flat_file_name.c_str());
+    return 0;
+}
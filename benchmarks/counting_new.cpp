@@ -0,0 +1,47 @@
+#include "counting_new.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+std::atomic<size_t> allocation_count = 0;
+std::atomic<size_t> allocated_bytes = 0;
+} // namespace
+
+namespace benchmark
+{
+
+size_t GetAllocationCount()
+{
+    return allocation_count;
+}
+
+size_t GetAllocatedBytes()
+{
+    return allocated_bytes;
+}
+
+} // namespace benchmark
+
+void *operator new(size_t size)
+{
+    ++allocation_count;
+    allocated_bytes += size;
+    if (void *result = std::malloc(size == 0 ? 1 : size))
+    {
+        return result;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+
+namespace benchmark
+{
+
+//counters of the replacement operator new of counting_new.cpp. The operators live in their own file,
+//so the compiler does not pair the inlined malloc of new with the free of delete and warn about a mismatch
+size_t GetAllocationCount();
+size_t GetAllocatedBytes();
+
+} // namespace benchmark
@@ -0,0 +1,117 @@
+#include "JSONlib/json.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//Key lookups in the dictionaries of the example inputs: every key of every dictionary is found,
+//then keys the reader asks for that may be missing. Small dictionaries are searched linearly,
+//larger ones through the sorted index, so they are reported apart.
+//Usage: dict_benchmark <json_file>...
+
+using namespace std::literals;
+
+namespace
+{
+const size_t MIN_LOOKUPS = 20000000;
+const size_t LARGE_DICT_SIZE = 9;
+
+using Clock = std::chrono::steady_clock;
+
+struct DictKeys
+{
+    const json::Dict *dict;
+    std::vector<std::string_view> keys;
+};
+
+void CollectDicts(const json::Node &node, std::vector<DictKeys> &small_dicts, std::vector<DictKeys> &large_dicts)
+{
+    if (node.IsArray())
+    {
+        for (const json::Node &item : node.AsArray())
+        {
+            CollectDicts(item, small_dicts, large_dicts);
+        }
+    }
+    else if (node.IsDict())
+    {
+        const json::Dict &dict = node.AsDict();
+        DictKeys dict_keys{&dict, {}};
+        for (const auto &[key, value] : dict)
+        {
+            dict_keys.keys.push_back(key);
+            CollectDicts(value, small_dicts, large_dicts);
+        }
+        (dict.size() >= LARGE_DICT_SIZE ? large_dicts : small_dicts).push_back(std::move(dict_keys));
+    }
+}
+
+//nanoseconds per lookup, count of found keys is returned so the lookups are not optimized out
+double MeasureLookups(const std::vector<DictKeys> &dicts, bool use_own_keys, size_t &found)
+{
+    static const std::vector<std::string_view> optional_keys{"id"sv, "count"sv, "radius"sv, "from_point"sv, "format"sv};
+    size_t lookups = 0;
+    const Clock::time_point start = Clock::now();
+    while (lookups < MIN_LOOKUPS)
+    {
+        for (const DictKeys &dict_keys : dicts)
+        {
+            for (std::string_view key : use_own_keys ? dict_keys.keys : optional_keys)
+            {
+                found += dict_keys.dict->count(key);
+                ++lookups;
+            }
+        }
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / lookups;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: dict_benchmark <json_file>...\n"sv;
+        return 1;
+    }
+    //the collected dictionaries point into the documents, so they must not move
+    std::vector<json::Document> documents;
+    documents.reserve(argc - 1);
+    std::vector<DictKeys> small_dicts;
+    std::vector<DictKeys> large_dicts;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::ifstream input(argv[i], std::ios::binary);
+        if (!input)
+        {
+            std::cerr << "Failed to open file "sv << argv[i] << std::endl;
+            return 2;
+        }
+        documents.push_back(json::Load(input));
+        CollectDicts(documents.back().GetRoot(), small_dicts, large_dicts);
+    }
+
+    size_t found = 0;
+    std::cout << std::fixed << std::setprecision(1);
+    for (const auto &[name, dicts] : {std::pair{"small dictionaries"sv, &small_dicts}, std::pair{"large dictionaries"sv, &large_dicts}})
+    {
+        if (dicts->empty())
+        {
+            continue;
+        }
+        size_t keys_count = 0;
+        for (const DictKeys &dict_keys : *dicts)
+        {
+            keys_count += dict_keys.keys.size();
+        }
+        std::cout << name << " ("sv << dicts->size() << ", "sv << keys_count << " keys): "sv
+                  << MeasureLookups(*dicts, true, found) << " ns per present key, "sv
+                  << MeasureLookups(*dicts, false, found) << " ns per optional key"sv << std::endl;
+    }
+    std::cerr << found << " keys found"sv << std::endl;
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include "JSONlib/json.h"
+
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+//Throughput of json::Load and json::Print on two generated documents: an array of numbers
+//and stop requests the way make_base gets them. The best of several runs is reported.
+//Usage: json_benchmark [number_count]
+
+using namespace std::literals;
+
+namespace
+{
+const int RUNS = 3;
+
+using Clock = std::chrono::steady_clock;
+
+//coordinates, distances and times, the numbers of our requests and answers
+json::Document MakeNumbers(size_t count)
+{
+    std::mt19937 generator(48);
+    std::uniform_real_distribution<double> coordinate(-180, 180);
+    std::uniform_int_distribution<int> distance(0, 100000);
+    json::Array numbers;
+    numbers.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i % 3 == 2)
+        {
+            numbers.emplace_back(distance(generator));
+        }
+        else
+        {
+            numbers.emplace_back(coordinate(generator));
+        }
+    }
+    return json::Document{std::move(numbers)};
+}
+
+json::Document MakeStops(size_t count)
+{
+    std::mt19937 generator(48);
+    std::uniform_real_distribution<double> latitude(55.6, 55.9);
+    std::uniform_real_distribution<double> longitude(37.4, 37.8);
+    std::uniform_int_distribution<size_t> stop_id(0, count - 1);
+    std::uniform_int_distribution<int> distance(300, 3000);
+    json::Array stops;
+    stops.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        json::Dict road_distances;
+        for (int j = 0; j < 3; ++j)
+        {
+            road_distances.emplace("Stop "s + std::to_string(stop_id(generator)), distance(generator));
+        }
+        stops.push_back(json::Dict{{"type"s, "Stop"s},
+                                   {"name"s, "Stop "s + std::to_string(i)},
+                                   {"latitude"s, latitude(generator)},
+                                   {"longitude"s, longitude(generator)},
+                                   {"road_distances"s, std::move(road_distances)}});
+    }
+    return json::Document{json::Dict{{"base_requests"s, std::move(stops)}}};
+}
+
+//seconds of the fastest run
+double Measure(const std::function<void()> &action)
+{
+    double best = 0;
+    for (int run = 0; run < RUNS; ++run)
+    {
+        const Clock::time_point start = Clock::now();
+        action();
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (run == 0 || seconds < best)
+        {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+void Report(std::string_view name, size_t bytes, double seconds)
+{
+    std::cout << "  "sv << name << ": "sv << bytes / seconds / (1 << 20) << " MB/s"sv << std::endl;
+}
+
+void Benchmark(std::string_view name, const json::Document &document)
+{
+    std::ostringstream output;
+    json::Print(document, output);
+    const std::string text = output.str();
+    std::cout << name << ", "sv << text.size() / 1024 << " KB:"sv << std::endl;
+
+    Report("Load(std::string)"sv, text.size(), Measure([&text]
+                                                         { json::Load(text); }));
+    Report("Load(std::istream)"sv, text.size(), Measure([&text]
+                                                          {
+                                                              std::istringstream input(text);
+                                                              json::Load(input);
+                                                          }));
+    for (const auto &[format_name, format] : {std::pair{"Print, 6 digits"sv, json::DoubleFormat::PRECISION_6},
+                                              std::pair{"Print, round trip"sv, json::DoubleFormat::ROUND_TRIP}})
+    {
+        size_t size = 0;
+        const double seconds = Measure([&document, &size, format = format]
+                                       {
+                                           std::ostringstream printed;
+                                           json::Print(document, printed, format);
+                                           size = printed.str().size();
+                                       });
+        Report(format_name, size, seconds);
+    }
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    size_t number_count = 3000000;
+    if (argc > 1)
+    {
+        number_count = std::stoul(argv[1]);
+    }
+    std::cout << std::fixed << std::setprecision(1);
+    Benchmark(std::to_string(number_count) + " numbers"s, MakeNumbers(number_count));
+    Benchmark(std::to_string(number_count / 10) + " stop requests"s, MakeStops(number_count / 10));
+    return 0;
+}
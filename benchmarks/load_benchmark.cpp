@@ -0,0 +1,89 @@
+#include "frozen_catalogue.h"
+#include "synthetic_city.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//Time to the first query of every database format: the database of a synthetic city is loaded
+//and one route is built from it, the best of several runs is reported.
+//Usage: load_benchmark [stop_count]
+
+using namespace std::literals;
+using namespace transport_catalogue;
+
+namespace
+{
+const int RUNS = 5;
+
+using Clock = std::chrono::steady_clock;
+
+double ToMilliseconds(Clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+struct Format
+{
+    std::string_view name;
+    json::Dict settings;
+};
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    benchmark::CityParams params;
+    if (argc > 1)
+    {
+        params.stop_count = std::stoul(argv[1]);
+    }
+    const std::vector<Format> formats{
+        {"protobuf"sv, {{"file"s, "load_benchmark.db"s}}},
+        {"flat"sv, {{"file"s, "load_benchmark_flat.db"s}, {"format"s, "flat"s}}},
+        {"flat zlib"sv, {{"file"s, "load_benchmark_z.db"s}, {"format"s, "flat"s}, {"compression"s, "zlib"s}}}};
+
+    //the first ring bus goes between these stops
+    const json::Dict city = benchmark::MakeCity(params, {});
+    const json::Array &first_bus = city.at("base_requests"sv).AsArray().at(params.stop_count).AsDict().at("stops"sv).AsArray();
+    const std::string from(first_bus.at(0).AsString());
+    const std::string to(first_bus.at(first_bus.size() / 2).AsString());
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << params.stop_count << " stops, "sv << params.bus_count << " buses, best of "sv << RUNS << " runs"sv << std::endl;
+    for (const Format &format : formats)
+    {
+        const std::string file_name(format.settings.at("file"sv).AsString());
+        benchmark::MakeBase(benchmark::MakeCity(params, format.settings));
+
+        double best_load = 0;
+        double best_total = 0;
+        size_t vertex_count = 0;
+        for (int run = 0; run < RUNS; ++run)
+        {
+            const Clock::time_point start = Clock::now();
+            const auto database = FrozenCatalogue::Load(file_name);
+            const Clock::time_point loaded = Clock::now();
+            if (!database->GetHandler().GetRouteInfo(from, to))
+            {
+                std::cerr << "No route from "sv << from << " to "sv << to << std::endl;
+                return 1;
+            }
+            const Clock::time_point answered = Clock::now();
+            vertex_count = database->GetHandler().GetRouter()->GetGraph().GetVertexCount();
+            if (run == 0 || ToMilliseconds(answered - start) < best_total)
+            {
+                best_load = ToMilliseconds(loaded - start);
+                best_total = ToMilliseconds(answered - start);
+            }
+        }
+        std::remove(file_name.c_str());
+        std::cout << format.name << ": load "sv << best_load << " ms, first route "sv << best_total - best_load
+                  << " ms, time to first query "sv << best_total << " ms ("sv << vertex_count << " route vertices)"sv << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include "name_search.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//Stop name autocomplete on generated names: time to build the index and microseconds per query
+//for prefixes of names and for names with a typo, the two kinds of matches of StopNamesIndex::Search.
+//Usage: name_search_benchmark [name_count]
+
+using namespace std::literals;
+
+namespace
+{
+const size_t QUERY_COUNT = 2000;
+const size_t RESULT_COUNT = 10;
+const int RUNS = 3;
+
+using Clock = std::chrono::steady_clock;
+
+//"Word Kind Number" from a few dozen words, so many names share prefixes and trigrams the way street names do
+std::vector<std::string> MakeNames(size_t count, std::mt19937 &generator)
+{
+    static const std::vector<std::string_view> kinds{"Street"sv, "Square"sv, "Avenue"sv, "Lane"sv, "Bridge"sv,
+                                                     "Station"sv, "Park"sv, "Market"sv};
+    static const std::vector<std::string_view> words{
+        "Lenina"sv,      "Pushkina"sv,   "Gagarina"sv,     "Mira"sv,         "Sadovaya"sv,
+        "Lesnaya"sv,     "Tverskaya"sv,  "Arbat"sv,        "Kutuzova"sv,     "Lomonosova"sv,
+        "Kirova"sv,      "Zarechnaya"sv, "Polevaya"sv,     "Shkolnaya"sv,    "Molodezhnaya"sv,
+        "Sovetskaya"sv,  "Ozernaya"sv,   "Tsentralnaya"sv, "Vokzalnaya"sv,   "Rechnaya"sv};
+    std::uniform_int_distribution<size_t> kind(0, kinds.size() - 1);
+    std::uniform_int_distribution<size_t> word(0, words.size() - 1);
+
+    std::vector<std::string> names;
+    names.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        names.push_back(std::string(words[word(generator)]) + " "s + std::string(kinds[kind(generator)]) + " "s +
+                        std::to_string(i));
+    }
+    return names;
+}
+
+//prefixes of random names and whole random names with one letter replaced
+void MakeQueries(const std::vector<std::string> &names, std::mt19937 &generator, std::vector<std::string> &prefixes,
+                 std::vector<std::string> &typos)
+{
+    std::uniform_int_distribution<size_t> name_id(0, names.size() - 1);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    for (size_t i = 0; i < QUERY_COUNT; ++i)
+    {
+        const std::string &name = names[name_id(generator)];
+        prefixes.push_back(name.substr(0, std::uniform_int_distribution<size_t>(2, name.size())(generator)));
+
+        std::string typo = names[name_id(generator)];
+        typo[std::uniform_int_distribution<size_t>(1, typo.size() - 1)(generator)] = static_cast<char>(letter(generator));
+        typos.push_back(std::move(typo));
+    }
+}
+
+//best of the runs in microseconds per query, count of found ids is returned so the queries are not optimized out
+double MeasureSearch(const transport_catalogue::name_search::StopNamesIndex &index,
+                     const std::vector<std::string> &queries, size_t &found)
+{
+    std::vector<uint32_t> stop_ids;
+    double best = 0;
+    for (int run = 0; run < RUNS; ++run)
+    {
+        const Clock::time_point start = Clock::now();
+        for (const std::string &query : queries)
+        {
+            index.Search(query, RESULT_COUNT, stop_ids);
+            found += stop_ids.size();
+        }
+        const double time = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / queries.size();
+        best = run == 0 ? time : std::min(best, time);
+    }
+    return best;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    size_t name_count = 50000;
+    if (argc > 1)
+    {
+        name_count = std::stoul(argv[1]);
+    }
+
+    std::mt19937 generator(33);
+    const std::vector<std::string> names = MakeNames(name_count, generator);
+    std::vector<std::string> prefixes;
+    std::vector<std::string> typos;
+    MakeQueries(names, generator, prefixes, typos);
+
+    const Clock::time_point start = Clock::now();
+    const transport_catalogue::name_search::StopNamesIndex index(std::vector<std::string_view>(names.begin(), names.end()));
+    const double build_time = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    size_t found = 0;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << name_count << " names: index built in "sv << build_time << " ms, "sv
+              << MeasureSearch(index, prefixes, found) << " us per prefix query, "sv
+              << MeasureSearch(index, typos, found) << " us per query with a typo"sv << std::endl;
+    std::cerr << found << " stops found"sv << std::endl;
+    return 0;
+}
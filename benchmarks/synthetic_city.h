@@ -0,0 +1,107 @@
+#pragma once
+
+#include "JSONlib/json.h"
+#include "json_reader.h"
+
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace benchmark
+{
+
+struct CityParams
+{
+    size_t stop_count = 5000;
+    //the routes matrix has a row for every stop of a bus and is built in cubic time,
+    //so by default buses go through about a thousand of the stops
+    size_t bus_count = 150;
+    size_t stops_per_bus = 8;
+    //the same seed gives the same city
+    unsigned seed = 1;
+};
+
+inline std::string GetStopName(size_t stop_id)
+{
+    return "Stop " + std::to_string(stop_id);
+}
+
+inline json::Dict MakeRenderSettings()
+{
+    using namespace std::literals;
+    return {{"width"s, 1500},
+            {"height"s, 950},
+            {"padding"s, 50},
+            {"stop_radius"s, 3},
+            {"line_width"s, 10},
+            {"bus_label_font_size"s, 18},
+            {"bus_label_offset"s, json::Array{7, 15}},
+            {"stop_label_font_size"s, 13},
+            {"stop_label_offset"s, json::Array{7, -3}},
+            {"underlayer_color"s, json::Array{255, 255, 255, 0.85}},
+            {"underlayer_width"s, 3},
+            {"color_palette"s, json::Array{"red"s, "green"s, "blue"s, "brown"s, "orange"s}}};
+}
+
+//make_base requests of a random city: stops are spread over a Moscow sized rectangle,
+//every bus is a ring through random stops with road distances between its neighbouring stops
+inline json::Dict MakeCity(const CityParams &params, json::Dict serialization_settings)
+{
+    using namespace std::literals;
+    std::mt19937 generator(params.seed);
+    std::uniform_real_distribution<double> latitude(55.6, 55.9);
+    std::uniform_real_distribution<double> longitude(37.4, 37.8);
+    std::uniform_int_distribution<size_t> stop_id(0, params.stop_count - 1);
+    std::uniform_int_distribution<int> road_distance(300, 3000);
+
+    std::vector<json::Dict> road_distances(params.stop_count);
+    json::Array buses;
+    for (size_t bus_id = 0; bus_id < params.bus_count; ++bus_id)
+    {
+        const size_t first = stop_id(generator);
+        size_t previous = first;
+        json::Array stops{GetStopName(first)};
+        for (size_t i = 1; i < params.stops_per_bus; ++i)
+        {
+            const size_t stop = stop_id(generator);
+            road_distances[previous].emplace(GetStopName(stop), road_distance(generator));
+            stops.push_back(GetStopName(stop));
+            previous = stop;
+        }
+        road_distances[previous].emplace(GetStopName(first), road_distance(generator));
+        stops.push_back(GetStopName(first));
+        buses.push_back(json::Dict{{"type"s, "Bus"s},
+                                   {"name"s, "Bus "s + std::to_string(bus_id)},
+                                   {"stops"s, std::move(stops)},
+                                   {"is_roundtrip"s, true}});
+    }
+
+    json::Array requests;
+    for (size_t stop = 0; stop < params.stop_count; ++stop)
+    {
+        requests.push_back(json::Dict{{"type"s, "Stop"s},
+                                      {"name"s, GetStopName(stop)},
+                                      {"latitude"s, latitude(generator)},
+                                      {"longitude"s, longitude(generator)},
+                                      {"road_distances"s, std::move(road_distances[stop])}});
+    }
+    requests.insert(requests.end(), buses.begin(), buses.end());
+
+    return {{"serialization_settings"s, std::move(serialization_settings)},
+            {"routing_settings"s, json::Dict{{"bus_wait_time"s, 2}, {"bus_velocity"s, 30}}},
+            {"render_settings"s, MakeRenderSettings()},
+            {"base_requests"s, std::move(requests)}};
+}
+
+//runs make_base on the requests
+inline void MakeBase(const json::Dict &requests)
+{
+    std::stringstream input;
+    json::Print(json::Document{requests}, input);
+    transport_catalogue::json_reader::JsonReader reader;
+    reader.ReadMakeBaseRequest(input);
+    reader.SerializeCatalogue();
+}
+
+} // namespace benchmark
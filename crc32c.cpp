@@ -0,0 +1,140 @@
+#include "crc32c.h"
+
+#include <array>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define TRANSPORT_CATALOGUE_HAS_SSE42_CRC
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#define TRANSPORT_CATALOGUE_HAS_ARM_CRC
+#include <arm_acle.h>
+#endif
+
+namespace transport_catalogue
+{
+namespace crc32c
+{
+
+namespace
+{
+//bits of the Castagnoli polynomial in reversed order
+const uint32_t POLYNOMIAL = 0x82f63b78;
+
+//tables[k][byte] is crc of the byte followed by k zero bytes
+using Tables = std::array<std::array<uint32_t, 256>, 8>;
+
+Tables MakeTables()
+{
+    Tables tables{};
+    for (uint32_t byte = 0; byte < 256; byte++)
+    {
+        uint32_t crc = byte;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 1) != 0 ? (crc >> 1) ^ POLYNOMIAL : crc >> 1;
+        }
+        tables[0][byte] = crc;
+    }
+    for (size_t k = 1; k < tables.size(); k++)
+    {
+        for (uint32_t byte = 0; byte < 256; byte++)
+        {
+            tables[k][byte] = (tables[k - 1][byte] >> 8) ^ tables[0][tables[k - 1][byte] & 0xff];
+        }
+    }
+    return tables;
+}
+
+uint32_t ReadLittleEndian32(const unsigned char *data)
+{
+    return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 | static_cast<uint32_t>(data[2]) << 16 |
+           static_cast<uint32_t>(data[3]) << 24;
+}
+
+//slicing by 8: eight bytes per step with eight table lookups
+uint32_t ExtendSoftware(uint32_t crc, const unsigned char *data, size_t size)
+{
+    static const Tables tables = MakeTables();
+    for (; size >= 8; data += 8, size -= 8)
+    {
+        const uint32_t low = ReadLittleEndian32(data) ^ crc;
+        const uint32_t high = ReadLittleEndian32(data + 4);
+        crc = tables[7][low & 0xff] ^ tables[6][(low >> 8) & 0xff] ^ tables[5][(low >> 16) & 0xff] ^ tables[4][low >> 24] ^
+              tables[3][high & 0xff] ^ tables[2][(high >> 8) & 0xff] ^ tables[1][(high >> 16) & 0xff] ^ tables[0][high >> 24];
+    }
+    for (; size > 0; data++, size--)
+    {
+        crc = (crc >> 8) ^ tables[0][(crc ^ *data) & 0xff];
+    }
+    return crc;
+}
+
+#if defined(TRANSPORT_CATALOGUE_HAS_SSE42_CRC)
+__attribute__((target("sse4.2"))) uint32_t ExtendHardware(uint32_t crc, const unsigned char *data, size_t size)
+{
+#if defined(__x86_64__)
+    uint64_t crc64 = crc;
+    for (; size >= 8; data += 8, size -= 8)
+    {
+        uint64_t value;
+        std::memcpy(&value, data, sizeof(value));
+        crc64 = _mm_crc32_u64(crc64, value);
+    }
+    crc = static_cast<uint32_t>(crc64);
+#endif
+    for (; size > 0; data++, size--)
+    {
+        crc = _mm_crc32_u8(crc, *data);
+    }
+    return crc;
+}
+
+bool HasHardwareCrc()
+{
+    return __builtin_cpu_supports("sse4.2");
+}
+#elif defined(TRANSPORT_CATALOGUE_HAS_ARM_CRC)
+uint32_t ExtendHardware(uint32_t crc, const unsigned char *data, size_t size)
+{
+    for (; size >= 8; data += 8, size -= 8)
+    {
+        uint64_t value;
+        std::memcpy(&value, data, sizeof(value));
+        crc = __crc32cd(crc, value);
+    }
+    for (; size > 0; data++, size--)
+    {
+        crc = __crc32cb(crc, *data);
+    }
+    return crc;
+}
+
+bool HasHardwareCrc()
+{
+    return true;
+}
+#else
+uint32_t ExtendHardware(uint32_t crc, const unsigned char *data, size_t size)
+{
+    return ExtendSoftware(crc, data, size);
+}
+
+bool HasHardwareCrc()
+{
+    return false;
+}
+#endif
+} // namespace
+
+uint32_t Extend(uint32_t crc, const char *data, size_t size)
+{
+    static const bool has_hardware_crc = HasHardwareCrc();
+    const auto *bytes = reinterpret_cast<const unsigned char *>(data);
+    crc = ~crc;
+    crc = has_hardware_crc ? ExtendHardware(crc, bytes, size) : ExtendSoftware(crc, bytes, size);
+    return ~crc;
+}
+
+} // namespace crc32c
+} // namespace transport_catalogue
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace transport_catalogue
+{
+namespace crc32c
+{
+
+//CRC-32C (Castagnoli) as in iSCSI and ext4. The SSE 4.2 or ARMv8 crc32 instructions are used
+//where the processor has them, other processors use tables.
+
+//continues crc of the previous bytes with the next ones, crc of no bytes is 0
+uint32_t Extend(uint32_t crc, const char *data, size_t size);
+
+inline uint32_t Compute(std::string_view data)
+{
+    return Extend(0, data.data(), data.size());
+}
+
+} // namespace crc32c
+} // namespace transport_catalogue
@@ -1,6 +1,8 @@
 #include "domain.h"
 #include "geo.h"
 
+#include <vector>
+
 namespace transport_catalogue
 {
 namespace domain
@@ -8,15 +10,26 @@ namespace domain
 
 double CalculateGeographicalDistance(const BusPtr bus)
 {
-    auto stops = bus->GetStops();
+    const auto &stops = bus->GetStops();
     if (stops.empty())
     {
         return 0;
     }
+
+    thread_local geo::CoordinatesTrigArrays points;
+    thread_local std::vector<double> distances;
+    points.Clear();
+    for (const StopPtr stop : stops)
+    {
+        points.PushBack(stop->GetCoordinatesTrig());
+    }
+    distances.resize(points.Size() - 1);
+    geo::ComputeClosestDistances(points.From(0), points.From(1), distances.size(), distances.data());
+
     double result = 0;
-    for (size_t i = 0; i < stops.size() - 1; i++)
+    for (double distance : distances)
     {
-        result = result + geo::ComputeClosestDistance(stops[i]->GetCoordinates(), stops[i + 1]->GetCoordinates());
+        result = result + distance;
     }
     return result;
 }
@@ -40,7 +40,7 @@ public:
         return name_;
     }
 
-    const std::vector<Stop *> GetStops() const
+    const std::vector<Stop *> &GetStops() const
     {
         return stops_;
     }
@@ -67,11 +67,16 @@ class Stop
 {
 public:
     Stop() = default;
-    explicit Stop(std::string stop_name, geo::Coordinates coordinates)
-        : name_(std::move(stop_name)), coordinates_(coordinates)
+    explicit Stop(std::string stop_name, geo::Coordinates coordinates, size_t id = 0)
+        : name_(std::move(stop_name)), coordinates_(coordinates), coordinates_trig_(geo::PrecomputeTrig(coordinates)), id_(id)
     {
     }
 
+    size_t GetId() const
+    {
+        return id_;
+    }
+
     const std::string &GetName() const
     {
         return name_;
@@ -82,9 +87,16 @@ public:
         return coordinates_;
     }
 
+    const geo::CoordinatesTrig &GetCoordinatesTrig() const
+    {
+        return coordinates_trig_;
+    }
+
 private:
     std::string name_;
     geo::Coordinates coordinates_;
+    geo::CoordinatesTrig coordinates_trig_;
+    size_t id_ = 0;
 };
 } // namespace domain
 } //transport_catalogue
\ No newline at end of file
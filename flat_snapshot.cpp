@@ -0,0 +1,739 @@
+#include "flat_snapshot.h"
+#include "crc32c.h"
+#include "memory_usage.h"
+#include "name_search.h"
+#include "spatial_index.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+namespace transport_catalogue
+{
+namespace flat_snapshot
+{
+
+namespace
+{
+struct Section
+{
+    SectionId id;
+    uint32_t element_size;
+    uint64_t size;
+    std::function<void(std::ostream &)> write;
+};
+
+template <typename T>
+Section MakeArraySection(SectionId id, std::vector<T> records)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    const uint64_t size = records.size() * sizeof(T);
+    return {id, sizeof(T), size, [records = std::move(records)](std::ostream &output)
+            { output.write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(T)); }};
+}
+
+Section MakeBytesSection(SectionId id, std::string bytes)
+{
+    const uint64_t size = bytes.size();
+    return {id, 1, size, [bytes = std::move(bytes)](std::ostream &output)
+            { output.write(bytes.data(), bytes.size()); }};
+}
+
+uint64_t Align(uint64_t offset)
+{
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+std::string CompressBlock(Compression compression, const char *data, size_t size)
+{
+    if (compression != Compression::ZLIB)
+    {
+        throw std::logic_error("Unknown compression");
+    }
+    uLongf compressed_size = compressBound(size);
+    std::string result(compressed_size, '\0');
+    if (compress2(reinterpret_cast<Bytef *>(result.data()), &compressed_size, reinterpret_cast<const Bytef *>(data), size,
+                  Z_DEFAULT_COMPRESSION) != Z_OK)
+    {
+        throw std::runtime_error("Failed to compress block");
+    }
+    result.resize(compressed_size);
+    return result;
+}
+
+//blocks are added one after another, then they become three sections
+class BlocksWriter
+{
+public:
+    BlocksWriter(Compression compression, uint32_t items_per_block)
+        : compression_(compression), items_per_block_(items_per_block)
+    {
+    }
+
+    uint32_t GetItemsPerBlock() const
+    {
+        return items_per_block_;
+    }
+
+    void AddBlock(const char *data, size_t size)
+    {
+        const std::string block = CompressBlock(compression_, data, size);
+        index_.push_back({blocks_.size(), block.size()});
+        blocks_ += block;
+    }
+
+    void AddSections(SectionId settings_id, SectionId index_id, SectionId blocks_id, uint64_t item_count,
+                     std::vector<Section> &sections)
+    {
+        sections.push_back(MakeArraySection(settings_id, std::vector<CompressedBlocksRecord>{{compression_, items_per_block_, item_count}}));
+        sections.push_back(MakeArraySection(index_id, std::move(index_)));
+        sections.push_back(MakeBytesSection(blocks_id, std::move(blocks_)));
+    }
+
+private:
+    Compression compression_;
+    uint32_t items_per_block_;
+    std::vector<BlockRecord> index_;
+    std::string blocks_;
+};
+
+uint32_t GetItemsPerBlock(size_t item_size)
+{
+    return std::max<size_t>(1, COMPRESSED_BLOCK_SIZE / std::max<size_t>(1, item_size));
+}
+
+void AddCatalogueSections(SnapshotData &data, std::vector<Section> &sections)
+{
+    sections.push_back(MakeBytesSection(SectionId::STRINGS, std::move(data.strings)));
+    sections.push_back(MakeArraySection(SectionId::STOPS, std::move(data.stops)));
+    sections.push_back(MakeArraySection(SectionId::BUSES, std::move(data.buses)));
+    sections.push_back(MakeArraySection(SectionId::BUS_STOPS, std::move(data.bus_stops)));
+    sections.push_back(MakeArraySection(SectionId::DISTANCES, std::move(data.distances)));
+    spatial_index::GridData &grid = data.grid;
+    sections.push_back(MakeArraySection(SectionId::STOPS_GRID, std::vector<GridRecord>{
+                                                                   {grid.min_lat, grid.min_lng, grid.lat_step, grid.lng_step, grid.side, 0}}));
+    sections.push_back(MakeArraySection(SectionId::STOPS_GRID_CELL_OFFSETS, std::move(grid.cell_offsets)));
+    sections.push_back(MakeArraySection(SectionId::STOPS_GRID_STOP_IDS, std::move(grid.stop_ids)));
+    name_search::NamesIndexData &names_index = data.names_index;
+    sections.push_back(MakeArraySection(SectionId::NAMES_INDEX_SORTED_STOP_IDS, std::move(names_index.sorted_stop_ids)));
+    sections.push_back(MakeArraySection(SectionId::NAMES_INDEX_TRIGRAMS, std::move(names_index.trigrams)));
+    sections.push_back(MakeArraySection(SectionId::NAMES_INDEX_TRIGRAM_OFFSETS, std::move(names_index.trigram_offsets)));
+    sections.push_back(MakeArraySection(SectionId::NAMES_INDEX_POSITIONS, std::move(names_index.positions)));
+}
+
+void AddRouterSections(SnapshotData &data, Compression compression, std::vector<Section> &sections)
+{
+    const uint64_t vertex_count = data.router_settings.vertex_count;
+    const graph::Router<double>::RoutesStorage &routes = *data.routes;
+    if (data.vertices.size() != vertex_count || data.incidence_offsets.size() != vertex_count + 1 ||
+        routes.GetVertexCount() != vertex_count)
+    {
+        throw std::logic_error("Routes matrix doesn't match the graph");
+    }
+
+    sections.push_back(MakeArraySection(SectionId::ROUTER_SETTINGS, std::vector<RouterSettingsRecord>{data.router_settings}));
+    sections.push_back(MakeArraySection(SectionId::VERTICES, std::move(data.vertices)));
+    if (compression == Compression::NONE)
+    {
+        sections.push_back(MakeArraySection(SectionId::EDGES, std::move(data.edges)));
+    }
+    else
+    {
+        const std::vector<EdgeRecord> &edges = data.edges;
+        BlocksWriter edges_blocks(compression, GetItemsPerBlock(sizeof(EdgeRecord)));
+        for (size_t first = 0; first < edges.size(); first += edges_blocks.GetItemsPerBlock())
+        {
+            const size_t count = std::min<size_t>(edges_blocks.GetItemsPerBlock(), edges.size() - first);
+            edges_blocks.AddBlock(reinterpret_cast<const char *>(edges.data() + first), count * sizeof(EdgeRecord));
+        }
+        edges_blocks.AddSections(SectionId::EDGES_BLOCKS_SETTINGS, SectionId::EDGES_BLOCK_INDEX, SectionId::EDGES_BLOCKS,
+                                 edges.size(), sections);
+    }
+    sections.push_back(MakeArraySection(SectionId::INCIDENCE_OFFSETS, std::move(data.incidence_offsets)));
+    sections.push_back(MakeArraySection(SectionId::INCIDENCE_EDGES, std::move(data.incidence_edges)));
+
+    if (compression != Compression::NONE)
+    {
+        //a block is compressed as soon as its rows are copied, so only one block is uncompressed at a time
+        BlocksWriter routes_blocks(compression, GetItemsPerBlock(vertex_count * (sizeof(double) + sizeof(uint32_t))));
+        std::vector<char> block;
+        for (size_t first = 0; first < vertex_count; first += routes_blocks.GetItemsPerBlock())
+        {
+            const size_t count = std::min<size_t>(routes_blocks.GetItemsPerBlock(), vertex_count - first);
+            block.resize(count * vertex_count * (sizeof(double) + sizeof(uint32_t)));
+            double *weights = reinterpret_cast<double *>(block.data());
+            uint32_t *prev_edges = reinterpret_cast<uint32_t *>(block.data() + count * vertex_count * sizeof(double));
+            for (size_t row = 0; row < count; ++row)
+            {
+                const graph::Router<double>::RoutesRow routes_row = routes.GetRow(first + row);
+                std::copy(routes_row.weights, routes_row.weights + vertex_count, weights + row * vertex_count);
+                std::copy(routes_row.prev_edges, routes_row.prev_edges + vertex_count, prev_edges + row * vertex_count);
+            }
+            routes_blocks.AddBlock(block.data(), block.size());
+        }
+        routes_blocks.AddSections(SectionId::ROUTES_BLOCKS_SETTINGS, SectionId::ROUTES_BLOCK_INDEX, SectionId::ROUTES_BLOCKS,
+                                  vertex_count, sections);
+        return;
+    }
+
+    //rows are written straight from the storage, the storage must outlive the sections
+    sections.push_back({SectionId::ROUTES_WEIGHTS, sizeof(double), vertex_count * vertex_count * sizeof(double),
+                        [&routes, vertex_count](std::ostream &output)
+                        {
+                            for (size_t from = 0; from < vertex_count; ++from)
+                            {
+                                const graph::Router<double>::RoutesRow row = routes.GetRow(from);
+                                output.write(reinterpret_cast<const char *>(row.weights), vertex_count * sizeof(double));
+                            }
+                        }});
+    sections.push_back({SectionId::ROUTES_PREV_EDGES, sizeof(uint32_t), vertex_count * vertex_count * sizeof(uint32_t),
+                        [&routes, vertex_count](std::ostream &output)
+                        {
+                            for (size_t from = 0; from < vertex_count; ++from)
+                            {
+                                const graph::Router<double>::RoutesRow row = routes.GetRow(from);
+                                output.write(reinterpret_cast<const char *>(row.prev_edges), vertex_count * sizeof(uint32_t));
+                            }
+                        }});
+}
+
+//Passes written bytes to the target and keeps CRC32C of every CHECKSUM_BLOCK_SIZE bytes of a section
+class ChecksumStreambuf : public std::streambuf
+{
+public:
+    explicit ChecksumStreambuf(std::streambuf *target)
+        : target_(target)
+    {
+    }
+
+    //the last block of a section may be shorter
+    void FinishSection()
+    {
+        if (block_filled_ > 0)
+        {
+            checksums_.push_back(block_checksum_);
+        }
+        block_filled_ = 0;
+        block_checksum_ = 0;
+    }
+
+    std::vector<uint32_t> &GetChecksums()
+    {
+        return checksums_;
+    }
+
+protected:
+    std::streamsize xsputn(const char *data, std::streamsize size) override
+    {
+        for (std::streamsize done = 0; done < size;)
+        {
+            const size_t part = std::min<uint64_t>(CHECKSUM_BLOCK_SIZE - block_filled_, size - done);
+            block_checksum_ = crc32c::Extend(block_checksum_, data + done, part);
+            block_filled_ += part;
+            done += part;
+            if (block_filled_ == CHECKSUM_BLOCK_SIZE)
+            {
+                FinishSection();
+            }
+        }
+        return target_->sputn(data, size);
+    }
+
+    int_type overflow(int_type ch) override
+    {
+        if (traits_type::eq_int_type(ch, traits_type::eof()))
+        {
+            return traits_type::not_eof(ch);
+        }
+        const char value = traits_type::to_char_type(ch);
+        return xsputn(&value, 1) == 1 ? ch : traits_type::eof();
+    }
+
+private:
+    std::streambuf *target_;
+    std::vector<uint32_t> checksums_;
+    uint64_t block_filled_ = 0;
+    uint32_t block_checksum_ = 0;
+};
+
+bool IsChecksumSection(SectionId id)
+{
+    return id == SectionId::CHECKSUMS_SETTINGS || id == SectionId::CHECKSUMS;
+}
+
+//sections that LazyChecksums checks when they are read, they are most of a big snapshot
+bool IsLazilyVerified(SectionId id)
+{
+    return id == SectionId::ROUTES_WEIGHTS || id == SectionId::ROUTES_PREV_EDGES || id == SectionId::EDGES_BLOCKS ||
+           id == SectionId::ROUTES_BLOCKS;
+}
+} // namespace
+
+bool IsFlatSnapshot(std::string_view data)
+{
+    return data.size() >= sizeof(MAGIC) && std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) == 0;
+}
+
+bool IsFlatSnapshot(std::istream &input)
+{
+    const auto position = input.tellg();
+    char magic[sizeof(MAGIC)];
+    input.read(magic, sizeof(magic));
+    const bool result = input.gcount() == sizeof(magic) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+    input.clear();
+    input.seekg(position);
+    return result;
+}
+
+SnapshotView::SnapshotView(std::string_view data)
+    : data_(data)
+{
+    if (!IsFlatSnapshot(data) || data.size() < sizeof(Header))
+    {
+        throw std::runtime_error("Not a flat snapshot");
+    }
+    Header header;
+    std::memcpy(&header, data.data(), sizeof(Header));
+    if (header.byte_order_mark != BYTE_ORDER_MARK)
+    {
+        throw std::runtime_error("Snapshot was written on a machine with other byte order");
+    }
+    if (header.version < MIN_FORMAT_VERSION || header.version > FORMAT_VERSION)
+    {
+        throw std::runtime_error("Unsupported snapshot version " + std::to_string(header.version));
+    }
+    if (header.file_size != data.size() || header.section_count > (data.size() - sizeof(Header)) / sizeof(SectionEntry))
+    {
+        throw std::runtime_error("Truncated snapshot");
+    }
+    version_ = header.version;
+
+    sections_ = {reinterpret_cast<const SectionEntry *>(data.data() + sizeof(Header)), header.section_count};
+    if (version_ >= 2 && crc32c::Extend(0, reinterpret_cast<const char *>(sections_.data()), sections_.size() * sizeof(SectionEntry)) !=
+                             header.table_checksum)
+    {
+        throw std::runtime_error("Broken section table of snapshot");
+    }
+    for (const SectionEntry &section : sections_)
+    {
+        if (section.element_size == 0 || section.size % section.element_size != 0 ||
+            section.offset > data.size() || section.size > data.size() - section.offset)
+        {
+            throw std::runtime_error("Broken section " + std::to_string(static_cast<uint32_t>(section.id)) + " of snapshot");
+        }
+    }
+}
+
+void SnapshotView::VerifyChecksums() const
+{
+    if (version_ < 2)
+    {
+        return;
+    }
+    const uint64_t block_size = GetChecksumBlockSize();
+    const ArrayView<uint32_t> checksums = GetArray<uint32_t>(SectionId::CHECKSUMS);
+    const std::vector<size_t> positions = GetChecksumPositions();
+
+    struct Block
+    {
+        SectionId section;
+        std::string_view data;
+        uint32_t checksum;
+    };
+    std::vector<Block> blocks;
+    for (size_t i = 0; i < sections_.size(); ++i)
+    {
+        const SectionEntry &section = sections_[i];
+        if (IsChecksumSection(section.id) || IsLazilyVerified(section.id))
+        {
+            continue;
+        }
+        size_t position = positions[i];
+        for (uint64_t offset = 0; offset < section.size; offset += block_size)
+        {
+            blocks.push_back({section.id, data_.substr(section.offset + offset, std::min(block_size, section.size - offset)),
+                              checksums[position++]});
+        }
+    }
+
+    //threads take blocks one by one until all are checked or one doesn't match
+    std::atomic<size_t> next_block = 0;
+    std::atomic<bool> is_broken = false;
+    std::atomic<uint32_t> broken_section = 0;
+    auto verify = [&]()
+    {
+        for (size_t i = next_block++; i < blocks.size() && !is_broken; i = next_block++)
+        {
+            if (crc32c::Compute(blocks[i].data) != blocks[i].checksum)
+            {
+                broken_section = static_cast<uint32_t>(blocks[i].section);
+                is_broken = true;
+            }
+        }
+    };
+    const size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), blocks.size());
+    std::vector<std::future<void>> tasks;
+    for (size_t i = 1; i < threads; i++)
+    {
+        tasks.push_back(std::async(std::launch::async, verify));
+    }
+    verify();
+    for (auto &task : tasks)
+    {
+        task.get();
+    }
+    if (is_broken)
+    {
+        throw std::runtime_error("Checksum mismatch in section " + std::to_string(broken_section) + " of snapshot");
+    }
+}
+
+uint64_t SnapshotView::GetChecksumBlockSize() const
+{
+    if (version_ < 2)
+    {
+        return 0;
+    }
+    const uint64_t block_size = GetRecord<ChecksumsRecord>(SectionId::CHECKSUMS_SETTINGS).block_size;
+    if (block_size == 0)
+    {
+        throw std::runtime_error("Broken checksums of snapshot");
+    }
+    return block_size;
+}
+
+std::vector<size_t> SnapshotView::GetChecksumPositions() const
+{
+    const uint64_t block_size = GetChecksumBlockSize();
+    std::vector<size_t> positions;
+    positions.reserve(sections_.size());
+    size_t position = 0;
+    for (const SectionEntry &section : sections_)
+    {
+        positions.push_back(position);
+        if (!IsChecksumSection(section.id))
+        {
+            position += (section.size + block_size - 1) / block_size;
+        }
+    }
+    if (position != GetArray<uint32_t>(SectionId::CHECKSUMS).size())
+    {
+        throw std::runtime_error("Broken checksums of snapshot");
+    }
+    return positions;
+}
+
+ArrayView<uint32_t> SnapshotView::GetChecksums(SectionId id) const
+{
+    if (version_ < 2)
+    {
+        return {};
+    }
+    const SectionEntry &section = GetSection(id);
+    const std::vector<size_t> positions = GetChecksumPositions();
+    const uint64_t block_size = GetChecksumBlockSize();
+    return {GetArray<uint32_t>(SectionId::CHECKSUMS).data() + positions[&section - sections_.data()],
+            (section.size + block_size - 1) / block_size};
+}
+
+LazyChecksums::LazyChecksums(const SnapshotView &snapshot, SectionId id)
+    : id_(id),
+      data_(snapshot.GetBytes(id)),
+      block_size_(snapshot.GetChecksumBlockSize()),
+      checksums_(snapshot.GetChecksums(id)),
+      is_verified_(checksums_.size())
+{
+}
+
+void LazyChecksums::VerifyBlock(size_t block) const
+{
+    if (crc32c::Compute(data_.substr(block * block_size_, block_size_)) != checksums_[block])
+    {
+        throw std::runtime_error("Checksum mismatch in section " + std::to_string(static_cast<uint32_t>(id_)) + " of snapshot");
+    }
+    is_verified_[block].store(true, std::memory_order_release);
+}
+
+void LazyChecksums::VerifyRest(const std::atomic<bool> &is_cancelled) const
+{
+    for (size_t block = 0; block < is_verified_.size() && !is_cancelled.load(std::memory_order_relaxed); ++block)
+    {
+        if (!is_verified_[block].load(std::memory_order_acquire))
+        {
+            VerifyBlock(block);
+        }
+    }
+}
+
+const SectionEntry &SnapshotView::GetSection(SectionId id) const
+{
+    const auto iter = std::find_if(sections_.begin(), sections_.end(), [id](const SectionEntry &section)
+                                   { return section.id == id; });
+    if (iter == sections_.end())
+    {
+        throw std::runtime_error("No section " + std::to_string(static_cast<uint32_t>(id)) + " in snapshot");
+    }
+    return *iter;
+}
+
+bool SnapshotView::HasSection(SectionId id) const
+{
+    return std::any_of(sections_.begin(), sections_.end(), [id](const SectionEntry &section)
+                       { return section.id == id; });
+}
+
+std::string_view SnapshotView::GetBytes(SectionId id) const
+{
+    const SectionEntry &section = GetSection(id);
+    return data_.substr(section.offset, section.size);
+}
+
+void Write(SnapshotData data, std::ostream &output, Compression compression)
+{
+    std::vector<Section> sections;
+    AddCatalogueSections(data, sections);
+    sections.push_back(MakeBytesSection(SectionId::RENDER_SETTINGS, std::move(data.render_settings)));
+    AddRouterSections(data, compression, sections);
+
+    //checksums are known when the other sections are written, so they go last
+    uint64_t checksums_count = 0;
+    for (const Section &section : sections)
+    {
+        checksums_count += (section.size + CHECKSUM_BLOCK_SIZE - 1) / CHECKSUM_BLOCK_SIZE;
+    }
+    ChecksumStreambuf checksum_buffer(output.rdbuf());
+    sections.push_back(MakeArraySection(SectionId::CHECKSUMS_SETTINGS, std::vector<ChecksumsRecord>{{CHECKSUM_BLOCK_SIZE}}));
+    sections.push_back({SectionId::CHECKSUMS, sizeof(uint32_t), checksums_count * sizeof(uint32_t), [&checksum_buffer](std::ostream &output)
+                        {
+                            const std::vector<uint32_t> &checksums = checksum_buffer.GetChecksums();
+                            output.write(reinterpret_cast<const char *>(checksums.data()), checksums.size() * sizeof(uint32_t));
+                        }});
+
+    std::vector<SectionEntry> table;
+    uint64_t offset = Align(sizeof(Header) + sections.size() * sizeof(SectionEntry));
+    for (const Section &section : sections)
+    {
+        table.push_back({section.id, section.element_size, offset, section.size});
+        offset = Align(offset + section.size);
+    }
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.byte_order_mark = BYTE_ORDER_MARK;
+    header.version = FORMAT_VERSION;
+    header.file_size = offset;
+    header.section_count = sections.size();
+    header.table_checksum = crc32c::Extend(0, reinterpret_cast<const char *>(table.data()), table.size() * sizeof(SectionEntry));
+    output.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+    output.write(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(SectionEntry));
+
+    uint64_t written = sizeof(Header) + table.size() * sizeof(SectionEntry);
+    const std::string padding(SECTION_ALIGNMENT, '\0');
+    //sections are written through the checksums, padding goes around them
+    std::ostream section_output(&checksum_buffer);
+    for (size_t i = 0; i < sections.size(); ++i)
+    {
+        output.write(padding.data(), table[i].offset - written);
+        if (IsChecksumSection(sections[i].id))
+        {
+            sections[i].write(output);
+        }
+        else
+        {
+            sections[i].write(section_output);
+            checksum_buffer.FinishSection();
+        }
+        if (!section_output)
+        {
+            output.setstate(std::ios::badbit);
+        }
+        written = table[i].offset + table[i].size;
+    }
+    output.write(padding.data(), offset - written);
+    if (!output)
+    {
+        throw std::runtime_error("Failed to write snapshot");
+    }
+}
+
+MappedRoutesStorage::MappedRoutesStorage(std::shared_ptr<const MappedFile> file, const SnapshotView &snapshot, size_t vertex_count)
+    : file_(std::move(file)),
+      vertex_count_(vertex_count),
+      weights_checksums_(snapshot, SectionId::ROUTES_WEIGHTS),
+      prev_edges_checksums_(snapshot, SectionId::ROUTES_PREV_EDGES)
+{
+    const ArrayView<double> weights = snapshot.GetArray<double>(SectionId::ROUTES_WEIGHTS);
+    const ArrayView<uint32_t> prev_edges = snapshot.GetArray<uint32_t>(SectionId::ROUTES_PREV_EDGES);
+    if (weights.size() != vertex_count * vertex_count || prev_edges.size() != vertex_count * vertex_count)
+    {
+        throw std::runtime_error("Routes matrix doesn't match the graph");
+    }
+    weights_ = weights.data();
+    prev_edges_ = prev_edges.data();
+}
+
+CompressedBlocks::CompressedBlocks(const SnapshotView &snapshot, SectionId settings_id, SectionId index_id, SectionId blocks_id,
+                                   size_t item_size)
+    : settings_(snapshot.GetRecord<CompressedBlocksRecord>(settings_id)),
+      index_(snapshot.GetArray<BlockRecord>(index_id)),
+      blocks_(snapshot.GetBytes(blocks_id)),
+      checksums_(snapshot, blocks_id),
+      item_size_(item_size)
+{
+    const uint64_t items_per_block = settings_.items_per_block;
+    if (settings_.compression != Compression::ZLIB || items_per_block == 0 ||
+        index_.size() != (settings_.item_count + items_per_block - 1) / items_per_block)
+    {
+        throw std::runtime_error("Broken compressed section " + std::to_string(static_cast<uint32_t>(blocks_id)) + " of snapshot");
+    }
+    for (const BlockRecord &block : index_)
+    {
+        if (block.offset > blocks_.size() || block.size > blocks_.size() - block.offset)
+        {
+            throw std::runtime_error("Broken compressed section " + std::to_string(static_cast<uint32_t>(blocks_id)) + " of snapshot");
+        }
+    }
+}
+
+size_t CompressedBlocks::GetBlockItemCount(size_t block_id) const
+{
+    const size_t first = block_id * GetItemsPerBlock();
+    return std::min(GetItemsPerBlock(), GetItemCount() - first);
+}
+
+void CompressedBlocks::Decompress(size_t block_id, char *destination) const
+{
+    const BlockRecord &block = index_[block_id];
+    checksums_.Verify(block.offset, block.size);
+    const uLongf expected_size = GetBlockItemCount(block_id) * item_size_;
+    uLongf size = expected_size;
+    if (uncompress(reinterpret_cast<Bytef *>(destination), &size, reinterpret_cast<const Bytef *>(blocks_.data() + block.offset),
+                   block.size) != Z_OK ||
+        size != expected_size)
+    {
+        throw std::runtime_error("Broken compressed block " + std::to_string(block_id) + " of snapshot");
+    }
+}
+
+CompressedRoutesStorage::CompressedRoutesStorage(std::shared_ptr<const MappedFile> file, const SnapshotView &snapshot, size_t vertex_count,
+                                                 size_t cache_blocks)
+    : file_(std::move(file)),
+      blocks_(snapshot, SectionId::ROUTES_BLOCKS_SETTINGS, SectionId::ROUTES_BLOCK_INDEX, SectionId::ROUTES_BLOCKS,
+              vertex_count * (sizeof(double) + sizeof(uint32_t))),
+      vertex_count_(vertex_count),
+      cache_blocks_(std::max<size_t>(1, cache_blocks))
+{
+    if (blocks_.GetItemCount() != vertex_count)
+    {
+        throw std::runtime_error("Routes matrix doesn't match the graph");
+    }
+}
+
+std::shared_ptr<const CompressedRoutesStorage::Block> CompressedRoutesStorage::GetBlock(size_t block_id) const
+{
+    {
+        std::lock_guard guard(cache_mutex_);
+        if (const auto iter = cache_index_.find(block_id); iter != cache_index_.end())
+        {
+            cache_.splice(cache_.begin(), cache_, iter->second);
+            return iter->second->second;
+        }
+    }
+
+    //other threads keep using the cache while the block is decompressed
+    auto block = std::make_shared<Block>(blocks_.GetBlockItemCount(block_id) * vertex_count_ * (sizeof(double) + sizeof(uint32_t)));
+    blocks_.Decompress(block_id, block->data());
+
+    std::lock_guard guard(cache_mutex_);
+    if (const auto iter = cache_index_.find(block_id); iter != cache_index_.end())
+    {
+        //decompressed by another thread meanwhile
+        cache_.splice(cache_.begin(), cache_, iter->second);
+        return iter->second->second;
+    }
+    cache_.emplace_front(block_id, block);
+    cache_index_[block_id] = cache_.begin();
+    if (cache_.size() > cache_blocks_)
+    {
+        //rows of the evicted block stay alive while routes use them
+        cache_index_.erase(cache_.back().first);
+        cache_.pop_back();
+    }
+    return block;
+}
+
+graph::Router<double>::RoutesRow CompressedRoutesStorage::GetRow(graph::VertexId from) const
+{
+    const size_t block_id = from / blocks_.GetItemsPerBlock();
+    const size_t row = from % blocks_.GetItemsPerBlock();
+    const size_t block_rows = blocks_.GetBlockItemCount(block_id);
+    std::shared_ptr<const Block> block = GetBlock(block_id);
+    const double *weights = reinterpret_cast<const double *>(block->data()) + row * vertex_count_;
+    const uint32_t *prev_edges = reinterpret_cast<const uint32_t *>(block->data() + block_rows * vertex_count_ * sizeof(double)) +
+                                 row * vertex_count_;
+    return {weights, prev_edges, std::move(block)};
+}
+
+size_t CompressedRoutesStorage::GetMemoryUsage() const
+{
+    std::lock_guard guard(cache_mutex_);
+    //a list node holds two pointers and the value
+    size_t result = cache_.size() * (2 * sizeof(void *) + sizeof(cache_.front())) + memory_usage::OfHashTable(cache_index_);
+    for (const auto &[block_id, block] : cache_)
+    {
+        result += memory_usage::OfVector(*block);
+    }
+    return result;
+}
+
+BackgroundVerification::BackgroundVerification(std::shared_ptr<const void> owner, std::vector<const LazyChecksums *> checksums)
+    : owner_(std::move(owner)),
+      checksums_(std::move(checksums))
+{
+    task_ = std::async(std::launch::async, [this]
+                       {
+                           try
+                           {
+                               for (const LazyChecksums *checksums : checksums_)
+                               {
+                                   checksums->VerifyRest(is_cancelled_);
+                               }
+                           }
+                           catch (const std::runtime_error &error)
+                           {
+                               error_ = error.what();
+                               is_broken_.store(true, std::memory_order_release);
+                           }
+                       });
+}
+
+BackgroundVerification::~BackgroundVerification()
+{
+    is_cancelled_ = true;
+    task_.wait();
+}
+
+void BackgroundVerification::ThrowIfBroken() const
+{
+    if (is_broken_.load(std::memory_order_acquire))
+    {
+        throw std::runtime_error("Broken database: " + error_);
+    }
+}
+
+void BackgroundVerification::Wait() const
+{
+    task_.wait();
+    ThrowIfBroken();
+}
+
+} // namespace flat_snapshot
+} // namespace transport_catalogue
@@ -0,0 +1,528 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "name_search.h"
+#include "router.h"
+#include "spatial_index.h"
+
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace transport_catalogue
+{
+namespace flat_snapshot
+{
+
+//Flat database format: a header, a table of sections and sections of fixed-width records,
+//every section starts at SECTION_ALIGNMENT. Numbers are stored in the byte order of the machine,
+//a reader with another byte order rejects the file. Stops and buses are referenced by position.
+//Since version 2 the section table and every CHECKSUM_BLOCK_SIZE bytes of the sections have CRC32C checksums.
+
+inline const char MAGIC[8] = {'T', 'C', 'F', 'L', 'A', 'T', '0', '1'};
+inline const uint32_t BYTE_ORDER_MARK = 0x01020304;
+inline const uint32_t FORMAT_VERSION = 2;
+//snapshots of version 1 have no checksums
+inline const uint32_t MIN_FORMAT_VERSION = 1;
+inline const uint64_t SECTION_ALIGNMENT = 64;
+//no bus for a walking edge, no second stop for a bus edge
+inline const uint32_t NO_ID = 0xffffffff;
+
+enum class SectionId : uint32_t
+{
+    //names of stops and buses one after another
+    STRINGS = 1,
+    STOPS,
+    BUSES,
+    //stops of all buses, a bus refers to its range
+    BUS_STOPS,
+    DISTANCES,
+    STOPS_GRID,
+    STOPS_GRID_CELL_OFFSETS,
+    STOPS_GRID_STOP_IDS,
+    NAMES_INDEX_SORTED_STOP_IDS,
+    NAMES_INDEX_TRIGRAMS,
+    NAMES_INDEX_TRIGRAM_OFFSETS,
+    NAMES_INDEX_POSITIONS,
+    //transport_catalogue_serialize::RenderSettings message, it is tiny and has no fixed layout
+    RENDER_SETTINGS,
+    ROUTER_SETTINGS,
+    //stop of every vertex
+    VERTICES,
+    EDGES,
+    //incidence lists in CSR form: vertex_count + 1 offsets into INCIDENCE_EDGES
+    INCIDENCE_OFFSETS,
+    INCIDENCE_EDGES,
+    //vertex_count * vertex_count cells, rows one after another
+    ROUTES_WEIGHTS,
+    ROUTES_PREV_EDGES,
+    //compressed EDGES, used instead of it
+    EDGES_BLOCKS_SETTINGS,
+    EDGES_BLOCK_INDEX,
+    EDGES_BLOCKS,
+    //compressed routes matrix, used instead of ROUTES_WEIGHTS and ROUTES_PREV_EDGES;
+    //a block holds weights of its rows and then their prev edges
+    ROUTES_BLOCKS_SETTINGS,
+    ROUTES_BLOCK_INDEX,
+    ROUTES_BLOCKS,
+    //checksums of the sections before them in the table, they go last
+    CHECKSUMS_SETTINGS,
+    //CRC32C of every block of every section in the order of the table, the last block of a section may be shorter
+    CHECKSUMS,
+};
+
+enum class Compression : uint32_t
+{
+    NONE = 0,
+    ZLIB = 1,
+};
+
+//rows of the routes matrix kept decompressed by CompressedRoutesStorage
+inline const size_t ROUTES_CACHE_BLOCKS = 64;
+//approximate size of a decompressed block
+inline const size_t COMPRESSED_BLOCK_SIZE = 1 << 16;
+//bytes of a section covered by one checksum, blocks are verified in parallel
+inline const uint64_t CHECKSUM_BLOCK_SIZE = 1 << 20;
+
+struct Header
+{
+    char magic[8];
+    uint32_t byte_order_mark;
+    uint32_t version;
+    uint64_t file_size;
+    uint32_t section_count;
+    //CRC32C of the section table, 0 in version 1
+    uint32_t table_checksum;
+};
+
+struct SectionEntry
+{
+    SectionId id;
+    uint32_t element_size;
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct StopRecord
+{
+    double lat;
+    double lng;
+    uint32_t name_offset;
+    uint32_t name_size;
+};
+
+struct BusRecord
+{
+    uint32_t name_offset;
+    uint32_t name_size;
+    uint32_t stops_offset;
+    uint32_t stops_count;
+    uint32_t is_roundtrip;
+    uint32_t reserved;
+};
+
+struct DistanceRecord
+{
+    uint32_t from_stop;
+    uint32_t to_stop;
+    int32_t distance;
+};
+
+struct GridRecord
+{
+    double min_lat;
+    double min_lng;
+    double lat_step;
+    double lng_step;
+    uint32_t side;
+    uint32_t reserved;
+};
+
+struct RouterSettingsRecord
+{
+    double walk_velocity;
+    uint64_t vertex_count;
+};
+
+struct EdgeRecord
+{
+    double time_in_road;
+    double weight;
+    uint32_t is_walk;
+    uint32_t bus;
+    uint32_t stop;
+    uint32_t stop_to;
+    int32_t span_count;
+    int32_t wait_time;
+    uint32_t from;
+    uint32_t to;
+};
+
+struct CompressedBlocksRecord
+{
+    Compression compression;
+    uint32_t items_per_block;
+    uint64_t item_count;
+};
+
+//position of a block in the blocks section
+struct BlockRecord
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct ChecksumsRecord
+{
+    uint64_t block_size;
+};
+
+//typed view of a section
+template <typename T>
+class ArrayView
+{
+public:
+    ArrayView() = default;
+
+    ArrayView(const T *data, size_t size)
+        : data_(data), size_(size)
+    {
+    }
+
+    const T *begin() const
+    {
+        return data_;
+    }
+
+    const T *end() const
+    {
+        return data_ + size_;
+    }
+
+    const T *data() const
+    {
+        return data_;
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    const T &operator[](size_t index) const
+    {
+        return data_[index];
+    }
+
+private:
+    const T *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+bool IsFlatSnapshot(std::string_view data);
+
+//checks the magic and restores the position of the stream
+bool IsFlatSnapshot(std::istream &input);
+
+//Sections of a snapshot in memory, data must outlive the view
+class SnapshotView
+{
+public:
+    //checks sizes of the file and the sections and the checksum of the section table;
+    //throws std::runtime_error if the header or the section table is broken
+    explicit SnapshotView(std::string_view data);
+
+    //reads every section except the routes matrix and compressed blocks, those are checked by LazyChecksums
+    //when they are read; blocks are checked on all cores and the first mismatch stops the check;
+    //does nothing for a snapshot of version 1, throws std::runtime_error if a section doesn't match its checksums
+    void VerifyChecksums() const;
+
+    //bytes covered by one checksum, 0 for a snapshot of version 1
+    uint64_t GetChecksumBlockSize() const;
+
+    //checksums of the blocks of the section, empty for a snapshot of version 1;
+    //throws std::runtime_error if the checksums don't cover the sections
+    ArrayView<uint32_t> GetChecksums(SectionId id) const;
+
+    //throws std::runtime_error if there is no such section or it has other records
+    template <typename T>
+    ArrayView<T> GetArray(SectionId id) const
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const SectionEntry &section = GetSection(id);
+        if (section.element_size != sizeof(T) || section.offset % alignof(T) != 0)
+        {
+            throw std::runtime_error("Unexpected records in snapshot section " + std::to_string(static_cast<uint32_t>(id)));
+        }
+        return {reinterpret_cast<const T *>(data_.data() + section.offset), section.size / sizeof(T)};
+    }
+
+    template <typename T>
+    const T &GetRecord(SectionId id) const
+    {
+        const ArrayView<T> records = GetArray<T>(id);
+        if (records.size() != 1)
+        {
+            throw std::runtime_error("Unexpected records in snapshot section " + std::to_string(static_cast<uint32_t>(id)));
+        }
+        return records[0];
+    }
+
+    std::string_view GetBytes(SectionId id) const;
+
+    bool HasSection(SectionId id) const;
+
+private:
+    const SectionEntry &GetSection(SectionId id) const;
+
+    //position of the first checksum of every section in the table, checksum sections have none
+    std::vector<size_t> GetChecksumPositions() const;
+
+    std::string_view data_;
+    uint32_t version_ = 0;
+    ArrayView<SectionEntry> sections_;
+};
+
+//Checks blocks of a section against their checksums when they are read for the first time.
+//Big sections are checked this way instead of on load, a block is checked once for all threads.
+class LazyChecksums
+{
+public:
+    //nothing is checked for a snapshot of version 1;
+    //throws std::runtime_error if the checksums don't cover the section
+    LazyChecksums(const SnapshotView &snapshot, SectionId id);
+
+    //checks the blocks under [offset, offset + size) of the section;
+    //throws std::runtime_error if one of them doesn't match its checksum
+    void Verify(uint64_t offset, uint64_t size) const
+    {
+        if (checksums_.size() == 0 || size == 0)
+        {
+            return;
+        }
+        for (uint64_t block = offset / block_size_, last = (offset + size - 1) / block_size_; block <= last; ++block)
+        {
+            if (!is_verified_[block].load(std::memory_order_acquire))
+            {
+                VerifyBlock(block);
+            }
+        }
+    }
+
+    //checks the blocks no reader has checked yet, stops early once is_cancelled is set;
+    //throws std::runtime_error if one of them doesn't match its checksum
+    void VerifyRest(const std::atomic<bool> &is_cancelled) const;
+
+private:
+    void VerifyBlock(size_t block) const;
+
+    SectionId id_;
+    std::string_view data_;
+    uint64_t block_size_ = 0;
+    ArrayView<uint32_t> checksums_;
+    //two threads may check a block at once, both set the same flag
+    mutable std::vector<std::atomic<bool>> is_verified_;
+};
+
+//Records of a database to write, stops and buses are referenced by position
+struct SnapshotData
+{
+    //names of stops and buses one after another
+    std::string strings;
+    std::vector<StopRecord> stops;
+    std::vector<BusRecord> buses;
+    std::vector<uint32_t> bus_stops;
+    std::vector<DistanceRecord> distances;
+    spatial_index::GridData grid;
+    name_search::NamesIndexData names_index;
+    //serialized transport_catalogue_serialize::RenderSettings
+    std::string render_settings;
+    RouterSettingsRecord router_settings;
+    std::vector<uint32_t> vertices;
+    std::vector<EdgeRecord> edges;
+    std::vector<uint32_t> incidence_offsets;
+    std::vector<uint32_t> incidence_edges;
+    //the matrix is not copied, its rows are read one by one while the file is written
+    const graph::Router<double>::RoutesStorage *routes = nullptr;
+};
+
+//writes the database in the flat format, the routes matrix is written row by row;
+//with compression edges and the matrix are stored as independently compressed blocks,
+//only the compressed blocks are kept in memory until they are written
+void Write(SnapshotData data, std::ostream &output, Compression compression = Compression::NONE);
+
+//Array of fixed-size items split into independently compressed blocks with an index
+class CompressedBlocks
+{
+public:
+    //throws std::runtime_error if the sections are broken
+    CompressedBlocks(const SnapshotView &snapshot, SectionId settings_id, SectionId index_id, SectionId blocks_id, size_t item_size);
+
+    size_t GetItemCount() const
+    {
+        return settings_.item_count;
+    }
+
+    size_t GetItemsPerBlock() const
+    {
+        return settings_.items_per_block;
+    }
+
+    size_t GetBlockCount() const
+    {
+        return index_.size();
+    }
+
+    //items in the block, the last block may be shorter
+    size_t GetBlockItemCount(size_t block_id) const;
+
+    //destination must have room for the items of the block, the block is checked against its checksums first;
+    //throws std::runtime_error if the block is broken or doesn't decompress to them
+    void Decompress(size_t block_id, char *destination) const;
+
+    const LazyChecksums &GetChecksums() const
+    {
+        return checksums_;
+    }
+
+    template <typename T>
+    std::vector<T> DecompressAll() const
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        std::vector<T> result(GetItemCount());
+        for (size_t block_id = 0; block_id < GetBlockCount(); ++block_id)
+        {
+            Decompress(block_id, reinterpret_cast<char *>(result.data() + block_id * GetItemsPerBlock()));
+        }
+        return result;
+    }
+
+private:
+    CompressedBlocksRecord settings_;
+    ArrayView<BlockRecord> index_;
+    std::string_view blocks_;
+    LazyChecksums checksums_;
+    size_t item_size_;
+};
+
+//Routes matrix read straight from the mapped file, rows are never copied
+class MappedRoutesStorage : public graph::Router<double>::RoutesStorage
+{
+public:
+    //throws std::runtime_error if the matrix sections don't match vertex_count
+    MappedRoutesStorage(std::shared_ptr<const MappedFile> file, const SnapshotView &snapshot, size_t vertex_count);
+
+    size_t GetVertexCount() const override
+    {
+        return vertex_count_;
+    }
+
+    //a row is checked against its checksums on first use, throws std::runtime_error if it doesn't match
+    graph::Router<double>::RoutesRow GetRow(graph::VertexId from) const override
+    {
+        weights_checksums_.Verify(from * vertex_count_ * sizeof(double), vertex_count_ * sizeof(double));
+        prev_edges_checksums_.Verify(from * vertex_count_ * sizeof(uint32_t), vertex_count_ * sizeof(uint32_t));
+        return {weights_ + from * vertex_count_, prev_edges_ + from * vertex_count_, nullptr};
+    }
+
+    size_t GetMemoryUsage() const override
+    {
+        return vertex_count_ * vertex_count_ * (sizeof(double) + sizeof(uint32_t));
+    }
+
+    std::vector<const LazyChecksums *> GetLazyChecksums() const
+    {
+        return {&weights_checksums_, &prev_edges_checksums_};
+    }
+
+private:
+    std::shared_ptr<const MappedFile> file_;
+    size_t vertex_count_;
+    const double *weights_;
+    const uint32_t *prev_edges_;
+    LazyChecksums weights_checksums_;
+    LazyChecksums prev_edges_checksums_;
+};
+
+//Compressed routes matrix: a route query decompresses only the block with its source row,
+//recently used blocks are kept in a small LRU cache shared by all threads
+class CompressedRoutesStorage : public graph::Router<double>::RoutesStorage
+{
+public:
+    //throws std::runtime_error if the matrix sections don't match vertex_count
+    CompressedRoutesStorage(std::shared_ptr<const MappedFile> file, const SnapshotView &snapshot, size_t vertex_count,
+                            size_t cache_blocks = ROUTES_CACHE_BLOCKS);
+
+    size_t GetVertexCount() const override
+    {
+        return vertex_count_;
+    }
+
+    graph::Router<double>::RoutesRow GetRow(graph::VertexId from) const override;
+
+    //decompressed blocks in the cache
+    size_t GetMemoryUsage() const override;
+
+    std::vector<const LazyChecksums *> GetLazyChecksums() const
+    {
+        return {&blocks_.GetChecksums()};
+    }
+
+private:
+    using Block = std::vector<char>;
+
+    std::shared_ptr<const Block> GetBlock(size_t block_id) const;
+
+    std::shared_ptr<const MappedFile> file_;
+    CompressedBlocks blocks_;
+    size_t vertex_count_;
+    size_t cache_blocks_;
+    mutable std::mutex cache_mutex_;
+    //the most recently used block goes first
+    mutable std::list<std::pair<size_t, std::shared_ptr<const Block>>> cache_;
+    mutable std::unordered_map<size_t, std::list<std::pair<size_t, std::shared_ptr<const Block>>>::iterator> cache_index_;
+};
+
+//Checks the lazily checked sections of a loaded snapshot on a thread of its own, so a broken block
+//is found soon after loading even if no query reads it. Blocks already checked by queries are skipped.
+class BackgroundVerification
+{
+public:
+    //starts the check, owner keeps the checksums alive until it is done
+    BackgroundVerification(std::shared_ptr<const void> owner, std::vector<const LazyChecksums *> checksums);
+
+    BackgroundVerification(const BackgroundVerification &) = delete;
+    BackgroundVerification &operator=(const BackgroundVerification &) = delete;
+
+    //stops the check and waits for its thread
+    ~BackgroundVerification();
+
+    //doesn't wait for the check, throws std::runtime_error if it has already found a broken block
+    void ThrowIfBroken() const;
+
+    //waits for the end of the check, throws std::runtime_error if a block is broken
+    void Wait() const;
+
+private:
+    std::shared_ptr<const void> owner_;
+    std::vector<const LazyChecksums *> checksums_;
+    std::atomic<bool> is_cancelled_ = false;
+    //the message is written before the flag is set
+    std::atomic<bool> is_broken_ = false;
+    std::string error_;
+    std::future<void> task_;
+};
+
+} // namespace flat_snapshot
+} // namespace transport_catalogue
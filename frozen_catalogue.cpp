@@ -0,0 +1,99 @@
+#include "frozen_catalogue.h"
+#include "flat_snapshot.h"
+#include "serialization.h"
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+namespace transport_catalogue
+{
+
+FrozenCatalogue::FrozenCatalogue(std::istream &input)
+    : handler_(catalogue_, renderer_)
+{
+    serialization::Deserializer deserializer(catalogue_, renderer_, handler_.GetRouter());
+    if (!deserializer.DeserializeFromIstream(input))
+    {
+        throw std::runtime_error("Failed to parse database");
+    }
+    database_memory_usage_ = deserializer.GetDatabaseMemoryUsage();
+}
+
+FrozenCatalogue::FrozenCatalogue(std::shared_ptr<const MappedFile> file)
+    : handler_(catalogue_, renderer_)
+{
+    serialization::Deserializer deserializer(catalogue_, renderer_, handler_.GetRouter());
+    if (!deserializer.DeserializeFromFlatSnapshot(std::move(file)))
+    {
+        throw std::runtime_error("Failed to parse database");
+    }
+    database_memory_usage_ = deserializer.GetDatabaseMemoryUsage();
+    background_verification_ = deserializer.GetBackgroundVerification();
+}
+
+void FrozenCatalogue::ThrowIfBroken() const
+{
+    if (background_verification_)
+    {
+        background_verification_->ThrowIfBroken();
+    }
+}
+
+void FrozenCatalogue::WaitVerified() const
+{
+    if (background_verification_)
+    {
+        background_verification_->Wait();
+    }
+}
+
+std::shared_ptr<const FrozenCatalogue> FrozenCatalogue::Load(std::istream &input)
+{
+    return std::shared_ptr<const FrozenCatalogue>(new FrozenCatalogue(input));
+}
+
+std::unique_ptr<FrozenCatalogue> FrozenCatalogue::Open(const std::string &file_name)
+{
+    std::ifstream input(file_name, std::ios::binary);
+    if (!input)
+    {
+        throw std::logic_error("Failed to open file: " + file_name);
+    }
+    if (!flat_snapshot::IsFlatSnapshot(input))
+    {
+        return std::unique_ptr<FrozenCatalogue>(new FrozenCatalogue(input));
+    }
+    input.close();
+    return std::unique_ptr<FrozenCatalogue>(new FrozenCatalogue(MappedFile::Open(file_name)));
+}
+
+void FrozenCatalogue::ApplyDelta(const std::string &file_name)
+{
+    std::ifstream input(file_name, std::ios::binary);
+    if (!input)
+    {
+        throw std::logic_error("Failed to open file: " + file_name);
+    }
+    serialization::Deserializer deserializer(catalogue_, renderer_, handler_.GetRouter());
+    if (!deserializer.ApplyDeltaFromIstream(input))
+    {
+        throw std::runtime_error("Failed to parse delta database: " + file_name);
+    }
+    database_memory_usage_ = std::max(database_memory_usage_, deserializer.GetDatabaseMemoryUsage());
+}
+
+std::shared_ptr<const FrozenCatalogue> FrozenCatalogue::Load(const std::string &file_name,
+                                                             const std::vector<std::string> &delta_file_names)
+{
+    //the catalogue is changed only before it is shared
+    std::unique_ptr<FrozenCatalogue> result = Open(file_name);
+    for (const std::string &delta_file_name : delta_file_names)
+    {
+        result->ApplyDelta(delta_file_name);
+    }
+    return result;
+}
+
+} // namespace transport_catalogue
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "map_renderer.h"
+#include "mapped_file.h"
+#include "request_handler.h"
+#include "transport_catalogue.h"
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace transport_catalogue
+{
+namespace flat_snapshot
+{
+class BackgroundVerification;
+} // namespace flat_snapshot
+
+//Read-only catalogue, renderer and router loaded from the database.
+//After loading nothing can change it, so one instance can be queried from many threads without locks.
+class FrozenCatalogue
+{
+public:
+    FrozenCatalogue(const FrozenCatalogue &) = delete;
+    FrozenCatalogue &operator=(const FrozenCatalogue &) = delete;
+
+    //throws std::runtime_error if the database is broken
+    static std::shared_ptr<const FrozenCatalogue> Load(std::istream &input);
+
+    //detects the format of the file, a flat snapshot is mapped into memory instead of being read;
+    //deltas are applied on top of it in the given order, each one to the result of the previous ones;
+    //throws std::logic_error if a file can't be opened
+    static std::shared_ptr<const FrozenCatalogue> Load(const std::string &file_name,
+                                                       const std::vector<std::string> &delta_file_names = {});
+
+    const TransportCatalogue &GetCatalogue() const
+    {
+        return catalogue_;
+    }
+
+    const renderer::MapRenderer &GetRenderer() const
+    {
+        return renderer_;
+    }
+
+    //all queries of the handler are const
+    const request_handler::RequestHandler &GetHandler() const
+    {
+        return handler_;
+    }
+
+    //heap bytes of the protobuf message the catalogue was loaded from
+    size_t GetDatabaseMemoryUsage() const
+    {
+        return database_memory_usage_;
+    }
+
+    //the routes matrix of a flat snapshot is checked against its checksums in the background after loading;
+    //doesn't wait for the check, throws std::runtime_error if it has already found a broken block
+    void ThrowIfBroken() const;
+
+    //waits for the background check, throws std::runtime_error if the database is broken
+    void WaitVerified() const;
+
+private:
+    explicit FrozenCatalogue(std::istream &input);
+
+    explicit FrozenCatalogue(std::shared_ptr<const MappedFile> file);
+
+    static std::unique_ptr<FrozenCatalogue> Open(const std::string &file_name);
+
+    //throws std::runtime_error if the delta is broken or made for another database
+    void ApplyDelta(const std::string &file_name);
+
+    TransportCatalogue catalogue_;
+    renderer::MapRenderer renderer_;
+    request_handler::RequestHandler handler_;
+    size_t database_memory_usage_ = 0;
+    std::shared_ptr<const flat_snapshot::BackgroundVerification> background_verification_;
+};
+
+} // namespace transport_catalogue
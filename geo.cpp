@@ -0,0 +1,230 @@
+#include "geo.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define TRANSPORT_CATALOGUE_HAS_AVX2_DISTANCES
+#endif
+
+//the loops are vectorized only when the whole computation is inlined into them, which the compiler
+//does not do by itself at -O2
+#if defined(__GNUC__) || defined(__clang__)
+#define TRANSPORT_CATALOGUE_ALWAYS_INLINE __attribute__((always_inline)) inline
+#else
+#define TRANSPORT_CATALOGUE_ALWAYS_INLINE inline
+#endif
+
+namespace geo
+{
+
+namespace
+{
+//pi and 2 pi split in two parts, so that a reduced angle keeps the bits the rounded constant loses
+const double PI_HI = 3.141592653589793116;
+const double PI_LO = 1.2246467991473532e-16;
+const double TWO_PI_HI = 2 * PI_HI;
+const double TWO_PI_LO = 2 * PI_LO;
+const double HALF_PI = PI_HI / 2;
+const double INV_TWO_PI = 0.15915494309189535;
+//adding and subtracting it rounds a double below 2^51 to an integer without a call
+const double ROUND_MAGIC = 6755399441055744.0;
+
+//terms of the Taylor series of cos(x) in x^2 up to x^20, on [0, pi/2] the rest is below 2e-17
+const size_t COS_TERMS = 11;
+//terms of asin(s) = s + s^3 * R(s^2) in R up to s^41, for s <= 0.5 the rest is below 4e-16,
+//that is nanometers on the Earth
+const size_t ASIN_TERMS = 20;
+
+template <size_t N>
+constexpr std::array<double, N> MakeCosCoefficients()
+{
+    std::array<double, N> result{};
+    double term = 1;
+    for (size_t n = 0; n < N; ++n)
+    {
+        result[n] = term;
+        term = -term / ((2 * n + 1) * (2 * n + 2));
+    }
+    return result;
+}
+
+//c_n of asin(s) = sum of c_n s^(2n+1) starting from c_1
+template <size_t N>
+constexpr std::array<double, N> MakeAsinCoefficients()
+{
+    std::array<double, N> result{};
+    //(2n)! / (4^n (n!)^2) without the 1 / (2n + 1)
+    double central = 1;
+    for (size_t n = 1; n <= N; ++n)
+    {
+        central = central * (2 * n - 1) / (2 * n);
+        result[n - 1] = central / (2 * n + 1);
+    }
+    return result;
+}
+
+constexpr std::array<double, COS_TERMS> COS_COEFFICIENTS = MakeCosCoefficients<COS_TERMS>();
+constexpr std::array<double, ASIN_TERMS> ASIN_COEFFICIENTS = MakeAsinCoefficients<ASIN_TERMS>();
+
+//largest power of two below count
+constexpr size_t GetLowerHalf(size_t count)
+{
+    size_t half = 1;
+    while (half * 2 < count)
+    {
+        half *= 2;
+    }
+    return half;
+}
+
+constexpr size_t GetLog2(size_t value)
+{
+    return value == 1 ? 0 : 1 + GetLog2(value / 2);
+}
+
+//Estrin's scheme: both halves of a polynomial are evaluated independently and joined with x^half,
+//so the chain of dependent operations is logarithmic and not linear as in Horner's scheme.
+//powers[k] = x^(2^k)
+template <size_t First, size_t Count, size_t N, size_t P>
+TRANSPORT_CATALOGUE_ALWAYS_INLINE double Estrin(const std::array<double, N> &coefficients, const std::array<double, P> &powers)
+{
+    if constexpr (Count == 1)
+    {
+        return coefficients[First];
+    }
+    else
+    {
+        constexpr size_t half = GetLowerHalf(Count);
+        return Estrin<First, half>(coefficients, powers) +
+               powers[GetLog2(half)] * Estrin<First + half, Count - half>(coefficients, powers);
+    }
+}
+
+template <size_t N>
+TRANSPORT_CATALOGUE_ALWAYS_INLINE double Polynomial(const std::array<double, N> &coefficients, double x)
+{
+    std::array<double, GetLog2(GetLowerHalf(N)) + 1> powers{x};
+    //unrolled, otherwise at -O2 the array stays in memory and blocks the vectorization of the caller
+#pragma GCC unroll 8
+    for (size_t k = 1; k < powers.size(); ++k)
+    {
+        powers[k] = powers[k - 1] * powers[k - 1];
+    }
+    return Estrin<0, N>(coefficients, powers);
+}
+
+//Cos and Acos have no branches and no calls, so the loops over them are vectorized
+
+TRANSPORT_CATALOGUE_ALWAYS_INLINE double Cos(double x)
+{
+    const double turns = (x * INV_TWO_PI + ROUND_MAGIC) - ROUND_MAGIC;
+    const double reduced = std::abs((x - turns * TWO_PI_HI) - turns * TWO_PI_LO);
+    //cos(x) = -cos(pi - x) keeps the argument of the series within [0, pi/2]
+    const bool is_far = reduced > HALF_PI;
+    const double argument = is_far ? (PI_HI - reduced) + PI_LO : reduced;
+    const double result = Polynomial(COS_COEFFICIENTS, argument * argument);
+    return is_far ? -result : result;
+}
+
+//x must be in [-1, 1]
+TRANSPORT_CATALOGUE_ALWAYS_INLINE double Acos(double x)
+{
+    const double abs_x = std::abs(x);
+    //near 1 acos(x) = 2 asin(sqrt((1 - x) / 2)), elsewhere acos(x) = pi/2 - asin(x);
+    //the square of the argument of asin is the smaller of the two, so the series is computed once
+    const double square = std::min((1 - abs_x) * 0.5, abs_x * abs_x);
+    const double sine = std::sqrt(square);
+    const double asin = sine + sine * square * Polynomial(ASIN_COEFFICIENTS, square);
+    const double near_one = x < 0 ? (PI_HI - 2 * asin) + PI_LO : 2 * asin;
+    const double elsewhere = x < 0 ? HALF_PI + asin : HALF_PI - asin;
+    return abs_x > 0.5 ? near_one : elsewhere;
+}
+
+TRANSPORT_CATALOGUE_ALWAYS_INLINE double ComputeDistance(CoordinatesTrig from, CoordinatesTrig to)
+{
+    const double cos_angle = from.sin_lat * to.sin_lat + from.cos_lat * to.cos_lat * Cos(from.lng - to.lng);
+    return Acos(std::clamp(cos_angle, -1., 1.)) * EARTH_RADIUS;
+}
+
+TRANSPORT_CATALOGUE_ALWAYS_INLINE CoordinatesTrig GetPoint(const CoordinatesTrigPointers &points, size_t i)
+{
+    return {points.sin_lat[i], points.cos_lat[i], points.lng[i]};
+}
+
+TRANSPORT_CATALOGUE_ALWAYS_INLINE CoordinatesTrig GetPoint(const CoordinatesTrig &point, size_t)
+{
+    return point;
+}
+
+template <typename From>
+TRANSPORT_CATALOGUE_ALWAYS_INLINE void ComputeDistances(const From &from, CoordinatesTrigPointers to, size_t count,
+                                                        double *distances)
+{
+#pragma omp simd
+    for (size_t i = 0; i < count; ++i)
+    {
+        distances[i] = ComputeDistance(GetPoint(from, i), GetPoint(to, i));
+    }
+}
+
+//with two doubles in a vector the polynomials are slower than the scalar libm calls,
+//so without AVX2 the batch is a plain loop over ComputeClosestDistance
+template <typename From>
+void ComputeDistancesScalar(const From &from, CoordinatesTrigPointers to, size_t count, double *distances)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        distances[i] = ComputeClosestDistance(GetPoint(from, i), GetPoint(to, i));
+    }
+}
+
+#if defined(TRANSPORT_CATALOGUE_HAS_AVX2_DISTANCES)
+//four doubles in a vector
+template <typename From>
+__attribute__((target("avx2,fma"))) void ComputeDistancesAvx2(const From &from, CoordinatesTrigPointers to, size_t count,
+                                                              double *distances)
+{
+    ComputeDistances(from, to, count, distances);
+}
+
+bool HasAvx2()
+{
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+template <typename From>
+void DispatchDistances(const From &from, CoordinatesTrigPointers to, size_t count, double *distances)
+{
+    static const bool has_avx2 = HasAvx2();
+    if (has_avx2)
+    {
+        ComputeDistancesAvx2(from, to, count, distances);
+    }
+    else
+    {
+        ComputeDistancesScalar(from, to, count, distances);
+    }
+}
+#else
+template <typename From>
+void DispatchDistances(const From &from, CoordinatesTrigPointers to, size_t count, double *distances)
+{
+    ComputeDistancesScalar(from, to, count, distances);
+}
+#endif
+} // namespace
+
+void ComputeClosestDistances(CoordinatesTrigPointers from, CoordinatesTrigPointers to, size_t count, double *distances)
+{
+    DispatchDistances(from, to, count, distances);
+}
+
+void ComputeClosestDistances(const CoordinatesTrig &from, CoordinatesTrigPointers to, size_t count, double *distances)
+{
+    DispatchDistances(from, to, count, distances);
+}
+
+} // namespace geo
@@ -1,19 +1,128 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <vector>
 
 namespace geo
 {
+inline const double EARTH_RADIUS = 6371000;
+inline const double DEGREES_TO_RADIANS = 3.1415926535 / 180.;
+
 struct Coordinates
 {
     double lat;
     double lng;
 };
 
+//rounding may push the cosine of a central angle slightly out of [-1, 1] for equal or antipodal points
+inline double CentralAngleToDistance(double cos_angle)
+{
+    return std::acos(std::clamp(cos_angle, -1., 1.)) * EARTH_RADIUS;
+}
+
 inline double ComputeClosestDistance(Coordinates from, Coordinates to)
 {
     using namespace std;
-    static const double dr = 3.1415926535 / 180.;
-    return acos(sin(from.lat * dr) * sin(to.lat * dr) + cos(from.lat * dr) * cos(to.lat * dr) * cos(abs(from.lng - to.lng) * dr)) * 6371000;
+    static const double dr = DEGREES_TO_RADIANS;
+    return CentralAngleToDistance(sin(from.lat * dr) * sin(to.lat * dr) + cos(from.lat * dr) * cos(to.lat * dr) * cos(abs(from.lng - to.lng) * dr));
 }
-} //namespace geo
\ No newline at end of file
+
+//point with precomputed trigonometry, distance between two of them needs one cos and one acos
+struct CoordinatesTrig
+{
+    double sin_lat = 0;
+    double cos_lat = 1;
+    //in radians
+    double lng = 0;
+};
+
+inline CoordinatesTrig PrecomputeTrig(Coordinates coordinates)
+{
+    return {std::sin(coordinates.lat * DEGREES_TO_RADIANS), std::cos(coordinates.lat * DEGREES_TO_RADIANS),
+            coordinates.lng * DEGREES_TO_RADIANS};
+}
+
+inline double ComputeClosestDistance(const CoordinatesTrig &from, const CoordinatesTrig &to)
+{
+    return CentralAngleToDistance(from.sin_lat * to.sin_lat + from.cos_lat * to.cos_lat * std::cos(from.lng - to.lng));
+}
+
+//points of CoordinatesTrigArrays starting from one of them
+struct CoordinatesTrigPointers
+{
+    const double *sin_lat;
+    const double *cos_lat;
+    const double *lng;
+};
+
+//points with precomputed trigonometry as a structure of arrays, so the batch kernels load them with vector instructions
+class CoordinatesTrigArrays
+{
+public:
+    size_t Size() const
+    {
+        return lng_.size();
+    }
+
+    void Clear()
+    {
+        sin_lat_.clear();
+        cos_lat_.clear();
+        lng_.clear();
+    }
+
+    void Reserve(size_t size)
+    {
+        sin_lat_.reserve(size);
+        cos_lat_.reserve(size);
+        lng_.reserve(size);
+    }
+
+    void Resize(size_t size)
+    {
+        sin_lat_.resize(size);
+        cos_lat_.resize(size);
+        lng_.resize(size);
+    }
+
+    void Set(size_t position, const CoordinatesTrig &point)
+    {
+        sin_lat_[position] = point.sin_lat;
+        cos_lat_[position] = point.cos_lat;
+        lng_[position] = point.lng;
+    }
+
+    void PushBack(const CoordinatesTrig &point)
+    {
+        sin_lat_.push_back(point.sin_lat);
+        cos_lat_.push_back(point.cos_lat);
+        lng_.push_back(point.lng);
+    }
+
+    CoordinatesTrigPointers From(size_t position) const
+    {
+        return {sin_lat_.data() + position, cos_lat_.data() + position, lng_.data() + position};
+    }
+
+    size_t GetCapacityBytes() const
+    {
+        return (sin_lat_.capacity() + cos_lat_.capacity() + lng_.capacity()) * sizeof(double);
+    }
+
+private:
+    std::vector<double> sin_lat_;
+    std::vector<double> cos_lat_;
+    std::vector<double> lng_;
+};
+
+//Batch kernels over arrays of points. On CPUs with AVX2 they use polynomials for cos and acos instead of libm calls,
+//so the loops are vectorized; the results are within millimeters of ComputeClosestDistance.
+
+//distances[i] = distance between point i of from and point i of to
+void ComputeClosestDistances(CoordinatesTrigPointers from, CoordinatesTrigPointers to, size_t count, double *distances);
+
+//distances[i] = distance between from and point i of to
+void ComputeClosestDistances(const CoordinatesTrig &from, CoordinatesTrigPointers to, size_t count, double *distances);
+} //namespace geo
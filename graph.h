@@ -3,6 +3,7 @@
 #include "ranges.h"
 
 #include <cstdlib>
+#include <string>
 #include <vector>
 
 namespace graph
@@ -11,11 +12,20 @@ namespace graph
 using VertexId = size_t;
 using EdgeId = size_t;
 
+enum class EdgeType
+{
+    BUS,
+    WALK
+};
+
 template <typename Weight>
 struct Edge
 {
+    EdgeType type = EdgeType::BUS;
     std::string bus_name;
     std::string stop_name;
+    //destination stop of walking edge, empty if the walk ends at arbitrary point
+    std::string stop_to_name;
     int span_count = 0;
     int wait_time = 0;
     double time_in_road = 0;
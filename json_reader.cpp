@@ -1,9 +1,10 @@
 #include "json_reader.h"
-#include "JSONlib/json_builder.h"
 #include "serialization.h"
 
+#include <algorithm>
 #include <deque>
 #include <iostream>
+#include <limits>
 #include <set>
 #include <fstream>
 #include <sstream>
@@ -14,260 +15,703 @@ namespace transport_catalogue
 {
 namespace json_reader
 {
-using namespace std::string_literals;
-JsonReader::JsonReader(TransportCatalogue &catalogue, request_handler::RequestHandler &handler,
-                       renderer::MapRenderer &map_renderer)
-    : catalogue_(catalogue), handler_(handler), map_renderer_(map_renderer)
+using namespace std::literals;
+
+namespace
+{
+size_t GetJsonMemoryUsage(const json::Node &node);
+
+size_t GetJsonMemoryUsage(const json::Dict &dict)
 {
+    size_t result = dict.GetMemoryUsage();
+    for (const auto &[key, value] : dict)
+    {
+        result += memory_usage::OfString(key) + GetJsonMemoryUsage(value);
+    }
+    return result;
 }
 
-void JsonReader::ReadMakeBaseRequest(std::istream &input)
+size_t GetJsonMemoryUsage(const json::Array &array)
 {
-    using namespace std::literals;
-    json::Document doc = json::Load(input);
-    const auto &base_requests_ = doc.GetRoot().AsDict().at("base_requests"s).AsArray();
-    render_settings_ = doc.GetRoot().AsDict().at("render_settings"s).AsDict();
-    routing_settings_ = doc.GetRoot().AsDict().at("routing_settings"s).AsDict();
-    serialization_file_name = doc.GetRoot().AsDict().at("serialization_settings").AsDict().at("file").AsString();
-    for (auto &request : base_requests_)
-    {
-        const auto &type = request.AsDict().at("type"s);
-        if (type.AsString() == "Stop"s)
+    size_t result = memory_usage::OfVector(array);
+    for (const auto &value : array)
+    {
+        result += GetJsonMemoryUsage(value);
+    }
+    return result;
+}
+
+size_t GetJsonMemoryUsage(const json::Node &node)
+{
+    //strings without escapes point into the text of the document
+    if (const auto *value = std::get_if<std::string>(&node.GetValue()))
+    {
+        return memory_usage::OfString(*value);
+    }
+    if (node.IsArray())
+    {
+        return GetJsonMemoryUsage(node.AsArray());
+    }
+    if (node.IsDict())
+    {
+        return GetJsonMemoryUsage(node.AsDict());
+    }
+    return 0;
+}
+
+//json::Node has no unsigned integers, so big sizes go as double
+json::Node BytesToNode(size_t bytes)
+{
+    if (bytes <= static_cast<size_t>(std::numeric_limits<int>::max()))
+    {
+        return json::Node(static_cast<int>(bytes));
+    }
+    return json::Node(static_cast<double>(bytes));
+}
+
+//throws std::runtime_error if the node is not a color
+svg::Color ReadColor(const json::Node &node)
+{
+    if (node.IsString())
+    {
+        return std::string(node.AsString());
+    }
+    if (node.IsArray())
+    {
+        const json::Array &color = node.AsArray();
+        if (color.size() == 3)
         {
-            stop_requests_.emplace_back(std::move(request.AsDict()));
+            return svg::Rgb(color[0].AsInt(), color[1].AsInt(), color[2].AsInt());
         }
-        else if (type.AsString() == "Bus"s)
+        if (color.size() == 4)
         {
-            bus_requests_.emplace_back(std::move(request.AsDict()));
+            return svg::Rgba(color[0].AsInt(), color[1].AsInt(), color[2].AsInt(), color[3].AsDouble());
         }
     }
+    throw std::runtime_error("Failed to get color from JSON"s);
+}
+
+svg::Point ReadOffset(const json::Node &node)
+{
+    const json::Array &offset = node.AsArray();
+    return {offset.at(0).AsDouble(), offset.at(1).AsDouble()};
+}
+
+renderer::RendererSettings ReadRenderSettings(const json::Dict &settings)
+{
+    renderer::RendererSettings result;
+    result.width = settings.at("width"sv).AsDouble();
+    result.height = settings.at("height"sv).AsDouble();
+    result.padding = settings.at("padding"sv).AsDouble();
+    result.line_width = settings.at("line_width"sv).AsDouble();
+    result.stop_radius = settings.at("stop_radius"sv).AsDouble();
+    result.bus_label_font_size = settings.at("bus_label_font_size"sv).AsInt();
+    result.bus_label_offset = ReadOffset(settings.at("bus_label_offset"sv));
+    result.stop_label_font_size = settings.at("stop_label_font_size"sv).AsInt();
+    result.stop_label_offset = ReadOffset(settings.at("stop_label_offset"sv));
+    result.underlayer_color = ReadColor(settings.at("underlayer_color"sv));
+    result.underlayer_width = settings.at("underlayer_width"sv).AsDouble();
+    for (const json::Node &color : settings.at("color_palette"sv).AsArray())
+    {
+        result.AddColor(ReadColor(color));
+    }
+    return result;
 }
 
-void JsonReader::ReadStatRequest(std::istream &input)
+//gives stops of the base their ids in it and puts buses of the base first in their order, so a delta keeps ids;
+//throws std::logic_error if a stop of the base is missing
+void OrderLikeBase(const TransportCatalogue &base_catalogue, CatalogueData &data)
+{
+    std::unordered_map<std::string_view, uint32_t> stop_ids;
+    stop_ids.reserve(data.stops.size());
+    for (uint32_t stop_id = 0; stop_id < data.stops.size(); stop_id++)
+    {
+        stop_ids.emplace(data.stops[stop_id].name, stop_id);
+    }
+    const size_t base_stops_count = base_catalogue.GetAllStops().size();
+    std::vector<uint32_t> new_stop_ids(data.stops.size(), std::numeric_limits<uint32_t>::max());
+    std::vector<CatalogueData::StopData> stops;
+    stops.reserve(data.stops.size());
+    for (size_t base_stop_id = 0; base_stop_id < base_stops_count; base_stop_id++)
+    {
+        const std::string_view stop_name = base_catalogue.GetStopById(base_stop_id)->GetName();
+        const auto iter = stop_ids.find(stop_name);
+        if (iter == stop_ids.end())
+        {
+            throw std::logic_error("A delta can't remove stop "s + std::string(stop_name));
+        }
+        new_stop_ids[iter->second] = static_cast<uint32_t>(stops.size());
+        stops.push_back(std::move(data.stops[iter->second]));
+    }
+    for (uint32_t stop_id = 0; stop_id < data.stops.size(); stop_id++)
+    {
+        if (new_stop_ids[stop_id] == std::numeric_limits<uint32_t>::max())
+        {
+            new_stop_ids[stop_id] = static_cast<uint32_t>(stops.size());
+            stops.push_back(std::move(data.stops[stop_id]));
+        }
+    }
+    data.stops = std::move(stops);
+
+    for (CatalogueData::BusData &bus : data.buses)
+    {
+        for (uint32_t &stop_id : bus.stop_ids)
+        {
+            stop_id = new_stop_ids[stop_id];
+        }
+    }
+    for (CatalogueData::DistanceData &distance : data.distances)
+    {
+        distance.from_stop_id = new_stop_ids[distance.from_stop_id];
+        distance.to_stop_id = new_stop_ids[distance.to_stop_id];
+    }
+
+    std::unordered_map<std::string_view, size_t> base_bus_positions;
+    const std::deque<domain::Bus> &base_buses = base_catalogue.GetAllBuses();
+    for (size_t position = 0; position < base_buses.size(); position++)
+    {
+        base_bus_positions.emplace(base_buses[position].GetName(), position);
+    }
+    std::stable_partition(data.buses.begin(), data.buses.end(), [&base_bus_positions](const CatalogueData::BusData &bus)
+                          { return base_bus_positions.count(bus.name) > 0; });
+    const auto new_buses = std::find_if(data.buses.begin(), data.buses.end(), [&base_bus_positions](const CatalogueData::BusData &bus)
+                                        { return base_bus_positions.count(bus.name) == 0; });
+    std::sort(data.buses.begin(), new_buses, [&base_bus_positions](const CatalogueData::BusData &lhs, const CatalogueData::BusData &rhs)
+              { return base_bus_positions.at(lhs.name) < base_bus_positions.at(rhs.name); });
+}
+
+json::Dict MemoryUsageToJson(const memory_usage::MemoryUsage &usage, size_t &total)
+{
+    json::Dict result;
+    for (const auto &[name, bytes] : usage)
+    {
+        result.emplace(name, BytesToNode(bytes));
+    }
+    result.emplace("total"s, BytesToNode(memory_usage::Total(usage)));
+    total += memory_usage::Total(usage);
+    return result;
+}
+} // namespace
+
+void JsonReader::ReadMakeBaseRequest(std::istream &input)
 {
     using namespace std::literals;
     json::Document doc = json::Load(input);
-    stat_requests_ = doc.GetRoot().AsDict().at("stat_requests"s).AsArray();
-    serialization_file_name = doc.GetRoot().AsDict().at("serialization_settings").AsDict().at("file").AsString();
+    const json::Dict &root = doc.GetRoot().AsDict();
+    render_settings_ = ReadRenderSettings(root.at("render_settings"sv).AsDict());
+    ReadRoutingSettings(root.at("routing_settings"sv).AsDict());
+    ReadSerializationSettings(root.at("serialization_settings"sv).AsDict());
+    if (!base_file_name_.empty())
+    {
+        //the delta is made against the base with its own deltas applied
+        base_ = FrozenCatalogue::Load(base_file_name_, delta_file_names_);
+    }
+    ReadBaseRequests(root.at("base_requests"sv).AsArray());
 }
-void JsonReader::ProcessRouteRequest()
+
+void JsonReader::ReadBaseRequests(const json::Array &base_requests)
 {
-    std::unordered_map<std::string, std::vector<std::string>> bus_to_stops;
-    std::set<std::string> using_stops;
-    for (const json::Dict &request : bus_requests_)
+    CatalogueData data;
+    //stop ids are positions of stop requests, names point into the requests
+    std::unordered_map<std::string_view, uint32_t> stop_ids;
+    for (const json::Node &request : base_requests)
     {
-        std::vector<std::string> stops;
-        for (const json::Node &stop_name : request.at("stops"s).AsArray())
+        const json::Dict &stop = request.AsDict();
+        if (stop.at("type"sv).AsString() == "Stop"sv)
         {
-            using_stops.insert(stop_name.AsString());
-            stops.emplace_back(stop_name.AsString());
+            const std::string_view stop_name = stop.at("name"sv).AsString();
+            stop_ids.emplace(stop_name, static_cast<uint32_t>(data.stops.size()));
+            data.stops.push_back({std::string(stop_name), {stop.at("latitude"sv).AsDouble(), stop.at("longitude"sv).AsDouble()}});
         }
-        if (!request.at("is_roundtrip"s).AsBool())
+    }
+
+    auto get_stop_id = [&stop_ids](std::string_view stop_name)
+    {
+        const auto iter = stop_ids.find(stop_name);
+        if (iter == stop_ids.end())
         {
-            for (int i = stops.size() - 2; i >= 0; i--)
+            throw std::logic_error("Unknown stop: " + std::string(stop_name));
+        }
+        return iter->second;
+    };
+    for (const json::Node &request : base_requests)
+    {
+        const json::Dict &dict = request.AsDict();
+        const std::string_view type = dict.at("type"sv).AsString();
+        if (type == "Stop"sv)
+        {
+            const auto iter = dict.find("road_distances"sv);
+            if (iter == dict.end())
+            {
+                continue;
+            }
+            const uint32_t from_stop_id = get_stop_id(dict.at("name"sv).AsString());
+            for (const auto &[stop_name_to, distance] : iter->second.AsDict())
             {
-                stops.push_back(stops[i]);
+                data.distances.push_back({from_stop_id, get_stop_id(stop_name_to), distance.AsInt()});
             }
         }
-        bus_to_stops[request.at("name"s).AsString()] = std::move(stops);
-    }
-    std::unordered_map<std::string, std::unordered_map<std::string, int>> stop_to_stops_distance_;
-    for (const json::Dict &request : stop_requests_)
-    {
-        const std::string &stop_name_from = request.at("name"s).AsString();
-        std::unordered_map<std::string, int> stop_to_distance;
-        for (const auto &[stop_name_to, distance] : request.at("road_distances"s).AsDict())
+        else if (type == "Bus"sv)
         {
-            stop_to_distance[stop_name_to] = distance.AsInt();
+            CatalogueData::BusData bus;
+            bus.name = dict.at("name"sv).AsString();
+            bus.is_circle = dict.at("is_roundtrip"sv).AsBool();
+            const json::Array &stops = dict.at("stops"sv).AsArray();
+            bus.stop_ids.reserve(stops.size());
+            for (const json::Node &stop_name : stops)
+            {
+                bus.stop_ids.push_back(get_stop_id(stop_name.AsString()));
+            }
+            data.buses.push_back(std::move(bus));
         }
-        stop_to_stops_distance_[stop_name_from] = std::move(stop_to_distance);
     }
+    if (base_)
+    {
+        OrderLikeBase(base_->GetCatalogue(), data);
+    }
+    catalogue_.BulkLoad(std::move(data));
 
-    transport_router::TransportRouterParams router_params;
-    router_params.bus_to_stops = std::move(bus_to_stops);
-    router_params.stop_to_stops_distance = std::move(stop_to_stops_distance_);
-    router_params.using_stops = std::move(using_stops);
-    router_params.bus_velocity = routing_settings_.at("bus_velocity"s).AsDouble();
-    router_params.bus_wait_time = routing_settings_.at("bus_wait_time"s).AsInt();
-    handler_.CreateRouter(std::move(router_params));
+    const size_t stops_count = catalogue_.GetAllStops().size();
+    std::vector<geo::Coordinates> stops_coordinates;
+    std::vector<std::string_view> stop_names;
+    stops_coordinates.reserve(stops_count);
+    stop_names.reserve(stops_count);
+    for (size_t stop_id = 0; stop_id < stops_count; stop_id++)
+    {
+        const domain::StopPtr stop = catalogue_.GetStopById(stop_id);
+        stops_coordinates.push_back(stop->GetCoordinates());
+        stop_names.push_back(stop->GetName());
+    }
+    catalogue_.SetStopsIndex(spatial_index::StopsSpatialIndex(stops_coordinates));
+    catalogue_.SetStopNamesIndex(name_search::StopNamesIndex(stop_names));
 }
 
-void JsonReader::SerializeCatalogue()
+void JsonReader::ReadRoutingSettings(const json::Dict &settings)
 {
-    ProcessRouteRequest();
-    std::ofstream out(serialization_file_name, std::ios::binary);
-    if (!out)
+    routing_settings_.bus_velocity = settings.at("bus_velocity"sv).AsDouble();
+    routing_settings_.bus_wait_time = settings.at("bus_wait_time"sv).AsInt();
+    if (const auto iter = settings.find("walk_velocity"sv); iter != settings.end())
     {
-        throw std::logic_error("Failed to open file: " + serialization_file_name);
+        routing_settings_.walk_velocity = iter->second.AsDouble();
+    }
+    if (const auto iter = settings.find("walk_transfer_radius"sv); iter != settings.end())
+    {
+        routing_settings_.walk_transfer_radius = iter->second.AsDouble();
     }
-    transport_catalogue::serialization::Serializer serializer(stop_requests_, bus_requests_, render_settings_, *handler_.GetRouter());
-    serializer.SerializeToOstream(out);
 }
 
-void JsonReader::DeserializeCatalogue()
+void JsonReader::ProcessStatRequests(std::istream &input, std::ostream &output, VersionedCatalogue &catalogue)
 {
-    std::ifstream input(serialization_file_name, std::ios::binary);
-    if (!input)
+    json::StreamReader reader(input);
+    //every answer is written out of the buffer as soon as it is complete, the buffer is reused
+    std::string buffer;
+    json::Writer answers(buffer);
+    auto output_request = [&](const json::Document &request)
     {
-        throw std::logic_error("Failed to open file: " + serialization_file_name);
+        const std::shared_ptr<const CatalogueVersion> version = catalogue.Acquire();
+        //a broken database found by the background check stops the batch before the next answer
+        version->catalogue->ThrowIfBroken();
+        OutputRequest(*version->catalogue, request.GetRoot().AsDict(), answers);
+        output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    };
+    answers.StartArray();
+    std::vector<json::Document> waiting_requests;
+    size_t waiting_memory_usage = 0;
+    bool has_database = false;
+    std::string key;
+    while (reader.NextKey(key))
+    {
+        if (key == "serialization_settings"s)
+        {
+            ReadSerializationSettings(reader.ReadValue().GetRoot().AsDict());
+            catalogue.Publish(DeserializeCatalogue());
+            has_database = true;
+            for (const json::Document &request : waiting_requests)
+            {
+                output_request(request);
+            }
+            waiting_requests = {};
+            waiting_memory_usage = 0;
+        }
+        else if (key == "stat_requests"s)
+        {
+            reader.StartArray();
+            while (std::optional<json::Document> request = reader.NextItem())
+            {
+                const size_t request_memory_usage = GetJsonMemoryUsage(request->GetRoot()) + request->GetTextSize();
+                requests_memory_usage_ = std::max(requests_memory_usage_,
+                                                  waiting_memory_usage + request_memory_usage + reader.GetBufferSize());
+                if (has_database)
+                {
+                    output_request(*request);
+                }
+                else
+                {
+                    waiting_memory_usage += request_memory_usage;
+                    waiting_requests.push_back(std::move(*request));
+                }
+            }
+        }
+        else
+        {
+            reader.ReadValue();
+        }
     }
-
-    transport_catalogue::serialization::Deserializer deserializer(catalogue_, map_renderer_, handler_.GetRouter());
-    deserializer.DeserializeFromIstream(input);
+    if (!has_database)
+    {
+        throw std::logic_error("No serialization_settings in the requests");
+    }
+    //answers are complete only if the whole database matches its checksums
+    catalogue.Acquire()->catalogue->WaitVerified();
+    answers.EndArray();
+    output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
 }
 
-void JsonReader::OutputRequest(std::ostream &output)
+void JsonReader::ReadSerializationSettings(const json::Dict &settings)
 {
-    json::Array result;
-    for (const auto &out_request : stat_requests_)
+    serialization_file_name = std::string(settings.at("file"sv).AsString());
+    if (const auto iter = settings.find("format"sv); iter != settings.end())
+    {
+        if (iter->second.AsString() == "flat"sv)
+        {
+            is_flat_format_ = true;
+        }
+        else if (iter->second.AsString() != "protobuf"sv)
+        {
+            throw std::logic_error("Unknown serialization format: " + std::string(iter->second.AsString()));
+        }
+    }
+    if (const auto iter = settings.find("compression"sv); iter != settings.end())
     {
-        const auto &type = out_request.AsDict().at("type"s);
-        if (type.AsString() == "Bus"s)
+        if (iter->second.AsString() == "zlib"sv)
         {
-            result.emplace_back(OutputBusRequest(out_request.AsDict()));
+            compression_ = flat_snapshot::Compression::ZLIB;
         }
-        else if (type.AsString() == "Stop"s)
+        else if (iter->second.AsString() != "none"sv)
         {
-            result.emplace_back(OutputStopRequest(out_request.AsDict()));
+            throw std::logic_error("Unknown compression: " + std::string(iter->second.AsString()));
         }
-        else if (type.AsString() == "Map"s)
+    }
+    if (compression_ != flat_snapshot::Compression::NONE && !is_flat_format_)
+    {
+        throw std::logic_error("Compression is supported only by the flat format");
+    }
+    if (const auto iter = settings.find("base"sv); iter != settings.end())
+    {
+        base_file_name_ = std::string(iter->second.AsString());
+    }
+    if (const auto iter = settings.find("deltas"sv); iter != settings.end())
+    {
+        for (const json::Node &delta_file_name : iter->second.AsArray())
         {
-            result.emplace_back(OutputMap(out_request.AsDict()));
+            delta_file_names_.emplace_back(delta_file_name.AsString());
         }
-        else if (type.AsString() == "Route"s)
+    }
+    if (!base_file_name_.empty() && is_flat_format_)
+    {
+        throw std::logic_error("A delta is written only in the protobuf format");
+    }
+}
+
+transport_router::TransportRouterParams JsonReader::ProcessRouteRequest() const
+{
+    transport_router::TransportRouterParams router_params = routing_settings_;
+    for (const domain::Bus &bus : catalogue_.GetAllBuses())
+    {
+        std::vector<std::string> stops;
+        stops.reserve(bus.GetStops().size());
+        for (const domain::StopPtr stop : bus.GetStops())
         {
-            result.emplace_back(OutputRouteRequest(out_request.AsDict()));
+            router_params.using_stops.insert(stop->GetName());
+            stops.push_back(stop->GetName());
         }
+        router_params.bus_to_stops[bus.GetName()] = std::move(stops);
     }
+    for (const auto &[stop_name, stop] : catalogue_.GetAllStops())
+    {
+        router_params.stops_coordinates[stop->GetName()] = stop->GetCoordinates();
+        //the router looks up distances of every stop
+        router_params.stop_to_stops_distance[stop->GetName()];
+    }
+    catalogue_.ForEachDistance([&router_params](const domain::StopPtr from, const domain::StopPtr to, int distance)
+                               { router_params.stop_to_stops_distance[from->GetName()][to->GetName()] = distance; });
+    return router_params;
+}
 
-    json::Print(json::Document{result}, output);
+void JsonReader::SerializeCatalogue(std::ostream *memory_report) const
+{
+    const transport_router::TransportRouter *base_router = nullptr;
+    if (base_)
+    {
+        if (!base_->GetHandler().GetRouter())
+        {
+            throw std::logic_error("The base database has no router");
+        }
+        base_router = &*base_->GetHandler().GetRouter();
+    }
+    const transport_router::TransportRouter router(ProcessRouteRequest(), base_router);
+    std::ofstream out(serialization_file_name, std::ios::binary);
+    if (!out)
+    {
+        throw std::logic_error("Failed to open file: " + serialization_file_name);
+    }
+    transport_catalogue::serialization::Serializer serializer(catalogue_, render_settings_, router, memory_report != nullptr);
+    if (base_)
+    {
+        serializer.SerializeDeltaToOstream(out, base_->GetCatalogue(), base_->GetRenderer().GetSettings(), *base_router);
+    }
+    else if (is_flat_format_)
+    {
+        serializer.SerializeToFlatOstream(out, compression_);
+    }
+    else
+    {
+        serializer.SerializeToOstream(out);
+    }
+
+    if (memory_report)
+    {
+        size_t total = 0;
+        json::Dict report{{"catalogue"s, MemoryUsageToJson(catalogue_.GetMemoryUsage(), total)}};
+        report.emplace("router"s, MemoryUsageToJson(router.GetMemoryUsage(), total));
+        report.emplace("protobuf"s, BytesToNode(serializer.GetDatabaseMemoryUsage()));
+        report.emplace("json_requests"s, BytesToNode(GetRequestsMemoryUsage()));
+        total += serializer.GetDatabaseMemoryUsage() + GetRequestsMemoryUsage();
+        report.emplace("total"s, BytesToNode(total));
+        json::Print(json::Document{report}, *memory_report, json::DoubleFormat::ROUND_TRIP);
+        *memory_report << std::endl;
+    }
 }
 
-json::Dict JsonReader::OutputMap(const Request &request) const
+size_t JsonReader::GetRequestsMemoryUsage() const
+{
+    return requests_memory_usage_;
+}
+
+void JsonReader::PrintMemoryReport(const FrozenCatalogue &database, std::ostream &output) const
+{
+    size_t total = 0;
+    json::Dict report{{"catalogue"s, MemoryUsageToJson(database.GetCatalogue().GetMemoryUsage(), total)}};
+    if (const auto &router = database.GetHandler().GetRouter())
+    {
+        report.emplace("router"s, MemoryUsageToJson(router->GetMemoryUsage(), total));
+    }
+    report.emplace("protobuf"s, BytesToNode(database.GetDatabaseMemoryUsage()));
+    report.emplace("json_requests"s, BytesToNode(GetRequestsMemoryUsage()));
+    total += database.GetDatabaseMemoryUsage() + GetRequestsMemoryUsage();
+    report.emplace("total"s, BytesToNode(total));
+    json::Print(json::Document{report}, output, json::DoubleFormat::ROUND_TRIP);
+    output << std::endl;
+}
+
+std::shared_ptr<const FrozenCatalogue> JsonReader::DeserializeCatalogue() const
+{
+    return FrozenCatalogue::Load(serialization_file_name, delta_file_names_);
+}
+
+void JsonReader::OutputRequest(const FrozenCatalogue &database, const Request &request, json::Writer &answers) const
+{
+    const request_handler::RequestHandler &handler = database.GetHandler();
+    const std::string_view type = request.at("type"sv).AsString();
+    if (type == "Bus"sv)
+    {
+        OutputBusRequest(handler, request, answers);
+    }
+    else if (type == "Stop"sv)
+    {
+        OutputStopRequest(handler, request, answers);
+    }
+    else if (type == "Map"sv)
+    {
+        OutputMap(handler, request, answers);
+    }
+    else if (type == "Route"sv)
+    {
+        OutputRouteRequest(handler, request, answers);
+    }
+    else if (type == "NearestStops"sv)
+    {
+        OutputNearestStopsRequest(handler, request, answers);
+    }
+    else if (type == "StopSearch"sv)
+    {
+        OutputStopSearchRequest(handler, request, answers);
+    }
+}
+
+//keys of every answer go in alphabetical order as they always did
+
+void JsonReader::OutputNotFound(const Request &request, json::Writer &answers) const
+{
+    answers.StartDict()
+        .Key("error_message"sv).String("not found"sv)
+        .Key("request_id"sv).Int(request.at("id"sv).AsInt())
+        .EndDict();
+}
+
+void JsonReader::OutputMap(const request_handler::RequestHandler &handler, const Request &request, json::Writer &answers) const
 {
     svg::Document map;
-    handler_.RenderMap(map);
+    handler.RenderMap(map);
     std::stringstream io_stream;
     map.Render(io_stream);
 
-    return json::Builder{}
-        .StartDict()
-        .Key("map"s).Value(io_stream.str())
-        .Key("request_id"s).Value(request.at("id"s).AsInt())
-        .EndDict()
-        .Build()
-        .AsDict();
+    answers.StartDict()
+        .Key("map"sv).String(io_stream.str())
+        .Key("request_id"sv).Int(request.at("id"sv).AsInt())
+        .EndDict();
 }
 
-json::Dict JsonReader::OutputBusRequest(const Request &request)
+void JsonReader::OutputBusRequest(const request_handler::RequestHandler &handler, const Request &request, json::Writer &answers) const
 {
-    using namespace std::string_literals;
-
-    auto bus_info = handler_.GetBusStat(request.at("name"s).AsString());
+    auto bus_info = handler.GetBusStat(request.at("name"sv).AsString());
 
     if (bus_info == std::nullopt)
     {
-        return json::Builder{}
-            .StartDict()
-            .Key("error_message"s).Value("not found"s)
-            .Key("request_id"s).Value(request.at("id"s).AsInt())
-            .EndDict()
-            .Build()
-            .AsDict();
-    }
-
-    return json::Builder{}
-        .StartDict()
-        .Key("request_id"s).Value(request.at("id"s).AsInt())
-        .Key("curvature"s).Value(bus_info->curvature)
-        .Key("route_length"s).Value(bus_info->route_length)
-        .Key("stop_count"s).Value(bus_info->stops_on_route)
-        .Key("unique_stop_count"s).Value(bus_info->unique_stops)
-        .EndDict()
-        .Build()
-        .AsDict();
+        OutputNotFound(request, answers);
+        return;
+    }
+
+    answers.StartDict()
+        .Key("curvature"sv).Double(bus_info->curvature)
+        .Key("request_id"sv).Int(request.at("id"sv).AsInt())
+        .Key("route_length"sv).Int(bus_info->route_length)
+        .Key("stop_count"sv).Int(bus_info->stops_on_route)
+        .Key("unique_stop_count"sv).Int(bus_info->unique_stops)
+        .EndDict();
 }
 
-json::Dict JsonReader::OutputStopRequest(const Request &request)
+void JsonReader::OutputStopRequest(const request_handler::RequestHandler &handler, const Request &request, json::Writer &answers) const
 {
-    using namespace std::string_literals;
-    auto stop_info = handler_.GetBusesNameByStop(request.at("name"s).AsString());
+    auto stop_info = handler.GetBusesNameByStop(request.at("name"sv).AsString());
     if (stop_info == std::nullopt)
     {
-        return json::Builder{}
-            .StartDict()
-            .Key("error_message"s).Value("not found"s)
-            .Key("request_id"s).Value(request.at("id"s).AsInt())
-            .EndDict()
-            .Build()
-            .AsDict();
+        OutputNotFound(request, answers);
+        return;
     }
 
-    json::Array buses;
+    answers.StartDict().Key("buses"sv).StartArray();
     for (const auto &bus : *stop_info)
     {
-        buses.emplace_back(std::string{bus});
+        answers.String(bus);
     }
-    return json::Builder{}
-        .StartDict()
-        .Key("buses"s).Value(buses)
-        .Key("request_id"s).Value(request.at("id"s).AsInt())
-        .EndDict()
-        .Build()
-        .AsDict();
+    answers.EndArray()
+        .Key("request_id"sv).Int(request.at("id"sv).AsInt())
+        .EndDict();
 }
 
-json::Dict JsonReader::OutputRouteRequest(const Request &request)
+void JsonReader::OutputRouteRequest(const request_handler::RequestHandler &handler, const Request &request, json::Writer &answers) const
 {
-    using namespace std::string_literals;
-
-    auto route_info = handler_.GetRouteInfo(request.at("from"s).AsString(), request.at("to"s).AsString());
+    auto read_route_point = [&request](std::string_view stop_key, std::string_view point_key)
+    {
+        if (const auto iter = request.find(point_key); iter != request.end())
+        {
+            const auto &point = iter->second.AsDict();
+            return request_handler::RoutePoint(geo::Coordinates{point.at("latitude"sv).AsDouble(),
+                                                                point.at("longitude"sv).AsDouble()});
+        }
+        return request_handler::RoutePoint(std::string(request.at(stop_key).AsString()));
+    };
+    auto route_info = handler.GetRouteInfo(read_route_point("from"sv, "from_point"sv), read_route_point("to"sv, "to_point"sv));
 
     if (route_info == std::nullopt)
     {
-
-        return json::Builder{}
-            .StartDict()
-            .Key("error_message"s).Value("not found"s)
-            .Key("request_id"s).Value(request.at("id"s).AsInt())
-            .EndDict()
-            .Build()
-            .AsDict();
+        OutputNotFound(request, answers);
+        return;
     }
-    json::Array result_items;
+
+    answers.StartDict().Key("items"sv).StartArray();
     for (const auto &item : route_info->items)
     {
-        json::Dict json_wait_item = json::Builder{}
-                                        .StartDict()
-                                        .Key("type"s).Value("Wait"s)
-                                        .Key("stop_name"s).Value(std::string(item.stop_name))
-                                        .Key("time"s).Value(item.wait_time)
-                                        .EndDict()
-                                        .Build()
-                                        .AsDict();
-        result_items.push_back(std::move(json_wait_item));
-
-        json::Dict json_bus_item = json::Builder{}
-                                       .StartDict()
-                                       .Key("type"s).Value("Bus"s)
-                                       .Key("bus"s).Value(std::string(item.bus_name))
-                                       .Key("span_count"s).Value(item.span_count)
-                                       .Key("time"s).Value(item.time_in_road)
-                                       .EndDict()
-                                       .Build()
-                                       .AsDict();
-
-        result_items.push_back(std::move(json_bus_item));
-    }
-    return json::Builder{}
-        .StartDict()
-        .Key("request_id"s).Value(request.at("id"s).AsInt())
-        .Key("total_time"s).Value(route_info->total_time)
-        .Key("items"s).Value(result_items)
-        .EndDict()
-        .Build()
-        .AsDict();
+        if (item.type == graph::EdgeType::WALK)
+        {
+            answers.StartDict();
+            if (!item.stop_name.empty())
+            {
+                answers.Key("from"sv).String(item.stop_name);
+            }
+            answers.Key("time"sv).Double(item.time_in_road);
+            if (!item.stop_to_name.empty())
+            {
+                answers.Key("to"sv).String(item.stop_to_name);
+            }
+            answers.Key("type"sv).String("Walk"sv).EndDict();
+            continue;
+        }
+
+        answers.StartDict()
+            .Key("stop_name"sv).String(item.stop_name)
+            .Key("time"sv).Int(item.wait_time)
+            .Key("type"sv).String("Wait"sv)
+            .EndDict();
+
+        answers.StartDict()
+            .Key("bus"sv).String(item.bus_name)
+            .Key("span_count"sv).Int(item.span_count)
+            .Key("time"sv).Double(item.time_in_road)
+            .Key("type"sv).String("Bus"sv)
+            .EndDict();
+    }
+    answers.EndArray()
+        .Key("request_id"sv).Int(request.at("id"sv).AsInt())
+        .Key("total_time"sv).Double(route_info->total_time)
+        .EndDict();
+}
+
+void JsonReader::OutputNearestStopsRequest(const request_handler::RequestHandler &handler, const Request &request,
+                                           json::Writer &answers) const
+{
+    const geo::Coordinates point{request.at("latitude"sv).AsDouble(), request.at("longitude"sv).AsDouble()};
+    std::optional<size_t> count;
+    if (const auto iter = request.find("count"sv); iter != request.end())
+    {
+        count = std::max(iter->second.AsInt(), 0);
+    }
+    std::optional<double> radius;
+    if (const auto iter = request.find("radius"sv); iter != request.end())
+    {
+        radius = iter->second.AsDouble();
+    }
+    if (!count && !radius)
+    {
+        count = 1;
+    }
+
+    answers.StartDict()
+        .Key("request_id"sv).Int(request.at("id"sv).AsInt())
+        .Key("stops"sv).StartArray();
+    for (const auto &stop : handler.GetNearestStops(point, count, radius))
+    {
+        answers.StartDict()
+            .Key("distance"sv).Double(stop.distance)
+            .Key("name"sv).String(stop.name)
+            .EndDict();
+    }
+    answers.EndArray().EndDict();
+}
+
+void JsonReader::OutputStopSearchRequest(const request_handler::RequestHandler &handler, const Request &request,
+                                         json::Writer &answers) const
+{
+    size_t count = DEFAULT_STOP_SEARCH_COUNT;
+    if (const auto iter = request.find("count"sv); iter != request.end())
+    {
+        count = std::max(iter->second.AsInt(), 0);
+    }
+
+    thread_local std::vector<std::string_view> stop_names;
+    handler.SearchStops(request.at("query"sv).AsString(), count, stop_names);
+
+    answers.StartDict()
+        .Key("request_id"sv).Int(request.at("id"sv).AsInt())
+        .Key("stops"sv).StartArray();
+    for (std::string_view stop_name : stop_names)
+    {
+        answers.String(stop_name);
+    }
+    answers.EndArray().EndDict();
 }
 
 } // namespace json_reader
-} // namespace transport_catalogue
\ No newline at end of file
+} // namespace transport_catalogue
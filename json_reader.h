@@ -1,59 +1,92 @@
 #pragma once
 
 #include "JSONlib/json.h"
+#include "JSONlib/json_stream.h"
+#include "flat_snapshot.h"
+#include "frozen_catalogue.h"
 #include "map_renderer.h"
 #include "request_handler.h"
 #include "transport_catalogue.h"
+#include "transport_router.h"
+#include "versioned_catalogue.h"
 
 #include <deque>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace transport_catalogue
 {
 namespace json_reader
 {
-using Request = std::map<std::string, json::Node>;
+using Request = json::Dict;
+
+inline const size_t DEFAULT_STOP_SEARCH_COUNT = 5;
 
 class JsonReader
 {
 public:
-    JsonReader(TransportCatalogue &catalogue,
-               request_handler::RequestHandler &handler,
-               renderer::MapRenderer &map_renderer);
-
+    //builds the catalogue right away, the parsed JSON is not kept
     void ReadMakeBaseRequest(std::istream &input);
 
-    void ReadStatRequest(std::istream &input);
+    //answers stat requests while they are read, every answer is written as soon as its request is parsed;
+    //the database is loaded into catalogue when serialization_settings is read, requests before it wait in memory
+    void ProcessStatRequests(std::istream &input, std::ostream &output, VersionedCatalogue &catalogue);
+
+    //memory_report receives approximate heap usage of the built database as JSON if set
+    void SerializeCatalogue(std::ostream *memory_report = nullptr) const;
 
-    void OutputRequest(std::ostream &ouput);
+    std::shared_ptr<const FrozenCatalogue> DeserializeCatalogue() const;
 
-    void SerializeCatalogue();
+    //prints approximate heap usage of the loaded database and the requests as JSON
+    void PrintMemoryReport(const FrozenCatalogue &database, std::ostream &output) const;
 
-    void DeserializeCatalogue();
+    //writes the answer to one stat request, requests of unknown types have no answer;
+    //does not change the reader, so one database can be queried this way from many threads
+    void OutputRequest(const FrozenCatalogue &database, const Request &request, json::Writer &answers) const;
 
 private:
+    void ReadSerializationSettings(const json::Dict &settings);
+
+    void ReadRoutingSettings(const json::Dict &settings);
+
+    //throws std::logic_error if a bus or a distance refers to an unknown stop
+    void ReadBaseRequests(const json::Array &base_requests);
+
+    size_t GetRequestsMemoryUsage() const;
+
+    void OutputNotFound(const Request &request, json::Writer &answers) const;
+
+    void OutputMap(const request_handler::RequestHandler &handler, const Request &request, json::Writer &answers) const;
+
+    transport_router::TransportRouterParams ProcessRouteRequest() const;
 
-    json::Dict OutputMap(const Request &request) const;
+    void OutputBusRequest(const request_handler::RequestHandler &handler, const Request &request, json::Writer &answers) const;
 
-    void ProcessRouteRequest();
+    void OutputStopRequest(const request_handler::RequestHandler &handler, const Request &request, json::Writer &answers) const;
 
-    json::Dict OutputBusRequest(const Request &request);
+    void OutputRouteRequest(const request_handler::RequestHandler &handler, const Request &request, json::Writer &answers) const;
 
-    json::Dict OutputStopRequest(const Request &request);
+    void OutputNearestStopsRequest(const request_handler::RequestHandler &handler, const Request &request,
+                                   json::Writer &answers) const;
 
-    json::Dict OutputRouteRequest(const Request &request);
+    void OutputStopSearchRequest(const request_handler::RequestHandler &handler, const Request &request,
+                                 json::Writer &answers) const;
 
-    TransportCatalogue &catalogue_;
-    request_handler::RequestHandler &handler_;
-    renderer::MapRenderer &map_renderer_;
-    std::vector<Request> stop_requests_;
-    std::vector<Request> bus_requests_;
-    json::Array stat_requests_;
-    json::Dict render_settings_;
-    json::Dict routing_settings_;
-    std::unordered_map<std::string, std::unordered_map<std::string, int>> stop_to_stop_distance_requests_;
+    //the most memory the stat requests took at once
+    size_t requests_memory_usage_ = 0;
+    TransportCatalogue catalogue_;
+    renderer::RendererSettings render_settings_;
+    //only velocities, wait time and transfer radius, stops and buses come from catalogue_
+    transport_router::TransportRouterParams routing_settings_;
     std::string serialization_file_name;
+    //make_base writes a delta against the base, process_requests applies the deltas to the database
+    std::string base_file_name_;
+    std::vector<std::string> delta_file_names_;
+    std::shared_ptr<const FrozenCatalogue> base_;
+    bool is_flat_format_ = false;
+    flat_snapshot::Compression compression_ = flat_snapshot::Compression::NONE;
 };
 } // namespace json_reader
 } // namespace transport_catalogue
\ No newline at end of file
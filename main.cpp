@@ -1,8 +1,9 @@
 #include "json_reader.h"
-#include "map_renderer.h"
-#include "transport_catalogue.h"
-#include "transport_router.h"
+#include "versioned_catalogue.h"
+
 #include <assert.h>
+#include <cstdio>
+#include <exception>
 #include <fstream>
 #include <iostream>
 #include <string_view>
@@ -12,33 +13,35 @@ using namespace std::literals;
 
 void PrintUsageMakeBase(std::ostream &stream = std::cerr) 
 {
-    stream << "Usage: make_base <input_file>\n"sv;
+    stream << "Usage: make_base <input_file> [--memory-report]\n"sv;
 }
 
 void PrintUsageProcessRequest(std::ostream &stream = std::cerr) 
 {
-    stream << "Usage: process_requests <input_file> <output_file>\n"sv;
+    stream << "Usage: process_requests <input_file> <output_file> [--memory-report]\n"sv;
 }
 
 void PrintUsage(std::ostream &stream = std::cerr)
 {
-    stream << "Usage: transport_catalogue [ make_base <input_file> ] | [ process_requests <input_file> <output_file> ] \n"sv;
+    stream << "Usage: transport_catalogue [ make_base <input_file> ] | [ process_requests <input_file> <output_file> ] [--memory-report]\n"sv;
 }
 
 int main(int argc, char *argv[])
 {
-
-    PrintUsage();
+    //report of memory usage goes to stderr as JSON
+    bool memory_report = false;
+    if (argc > 1 && argv[argc - 1] == "--memory-report"sv)
+    {
+        memory_report = true;
+        --argc;
+    }
 
     if (argc == 1 || argc > 4)
     {
         PrintUsage();
         return 1;
     }
-    transport_catalogue::TransportCatalogue catalogue;
-    transport_catalogue::renderer::MapRenderer render;
-    transport_catalogue::request_handler::RequestHandler handler(catalogue, render);
-    transport_catalogue::json_reader::JsonReader reader(catalogue, handler, render);
+    transport_catalogue::json_reader::JsonReader reader;
 
     const std::string_view mode(argv[1]);
     if (mode == "make_base"sv)
@@ -56,7 +59,7 @@ int main(int argc, char *argv[])
             return 2;
         }
         reader.ReadMakeBaseRequest(input);
-        reader.SerializeCatalogue();
+        reader.SerializeCatalogue(memory_report ? &std::cerr : nullptr);
         return 0;
     }
     else if (mode == "process_requests"sv)
@@ -79,9 +82,23 @@ int main(int argc, char *argv[])
             std::cerr << "Failed to open file " << argv[3] << std::endl;
             return 2;
         }
-        reader.ReadStatRequest(input);
-        reader.DeserializeCatalogue();
-        reader.OutputRequest(output);
+        transport_catalogue::VersionedCatalogue catalogue;
+        try
+        {
+            reader.ProcessStatRequests(input, output, catalogue);
+        }
+        catch (const std::exception &error)
+        {
+            //answers written before the failure are not the answers to the requests
+            output.close();
+            std::remove(argv[3]);
+            std::cerr << "Failed to process requests: " << error.what() << std::endl;
+            return 3;
+        }
+        if (memory_report)
+        {
+            reader.PrintMemoryReport(*catalogue.Acquire()->catalogue, std::cerr);
+        }
         return 0;
     }
     else
@@ -117,20 +117,26 @@ public:
         settings_ = std::move(settings);
     }
 
-    svg::Document &PrintBusName(const domain::BusPtr bus, svg::Document &doc) const;
-    svg::Document &PrintRoad(const domain::BusPtr bus, svg::Document &doc);
-    svg::Document &PrintStopSymbol(const domain::StopPtr stop, svg::Document &doc) const;
-    svg::Document &PrintStopName(const domain::StopPtr stop, svg::Document &doc) const;
+    const RendererSettings &GetSettings() const
+    {
+        return settings_;
+    }
+
+    svg::Document &PrintBusName(const domain::BusPtr bus, const svg::Color &color, const SphereProjector &projector,
+                                svg::Document &doc) const;
+    svg::Document &PrintRoad(const domain::BusPtr bus, const svg::Color &color, const SphereProjector &projector,
+                             svg::Document &doc) const;
+    svg::Document &PrintStopSymbol(const domain::StopPtr stop, const SphereProjector &projector, svg::Document &doc) const;
+    svg::Document &PrintStopName(const domain::StopPtr stop, const SphereProjector &projector, svg::Document &doc) const;
 
-    svg::Document &Render(svg::Document &doc, std::vector<domain::BusPtr> &buses_to_render, const std::vector<domain::StopPtr> &stop_to_render);
+    //does not change the renderer, so it can be called from several threads at once
+    svg::Document &Render(svg::Document &doc, const std::vector<domain::BusPtr> &buses_to_render,
+                          const std::vector<domain::StopPtr> &stop_to_render) const;
 
 private:
-    void CalibrateMap(const std::vector<geo::Coordinates> &all_stops_coordinates);
+    SphereProjector CalibrateMap(const std::vector<geo::Coordinates> &all_stops_coordinates) const;
 
     RendererSettings settings_;
-    std::optional<SphereProjector> projector_;
-    size_t current_color_index = 0;
-    std::map<const domain::BusPtr, svg::Color> bus_to_color;
 };
 } // namespace renderer
 } // namespace transport_catalogue
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "mapped_file.h"
+
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TRANSPORT_CATALOGUE_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace transport_catalogue
+{
+
+MappedFile::~MappedFile()
+{
+#ifdef TRANSPORT_CATALOGUE_HAS_MMAP
+    if (is_mapped_)
+    {
+        munmap(const_cast<char *>(data_), size_);
+    }
+#endif
+}
+
+std::shared_ptr<const MappedFile> MappedFile::Open(const std::string &file_name)
+{
+    std::shared_ptr<MappedFile> result(new MappedFile());
+#ifdef TRANSPORT_CATALOGUE_HAS_MMAP
+    const int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Failed to open file: " + file_name);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("Failed to get size of file: " + file_name);
+    }
+    result->size_ = static_cast<size_t>(file_stat.st_size);
+    if (result->size_ > 0)
+    {
+        void *data = mmap(nullptr, result->size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("Failed to map file: " + file_name);
+        }
+        result->data_ = static_cast<const char *>(data);
+        result->is_mapped_ = true;
+    }
+    //the mapping stays valid after the descriptor is closed
+    close(fd);
+#else
+    std::ifstream input(file_name, std::ios::binary);
+    if (!input)
+    {
+        throw std::runtime_error("Failed to open file: " + file_name);
+    }
+    result->buffer_.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    result->data_ = result->buffer_.data();
+    result->size_ = result->buffer_.size();
+#endif
+    return result;
+}
+
+} // namespace transport_catalogue
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace transport_catalogue
+{
+
+//Read-only view of a whole file. The file is mapped into memory where mmap is available,
+//so its pages are loaded on first access and shared between processes through the page cache.
+class MappedFile
+{
+public:
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile();
+
+    //throws std::runtime_error if the file can't be opened or mapped
+    static std::shared_ptr<const MappedFile> Open(const std::string &file_name);
+
+    std::string_view GetData() const
+    {
+        return {data_, size_};
+    }
+
+private:
+    MappedFile() = default;
+
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+    bool is_mapped_ = false;
+    //contents of the file on systems without mmap
+    std::vector<char> buffer_;
+};
+
+} // namespace transport_catalogue
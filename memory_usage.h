@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace transport_catalogue
+{
+namespace memory_usage
+{
+
+//bytes used by named parts of a subsystem
+using MemoryUsage = std::map<std::string, size_t>;
+
+//Estimates of heap bytes owned by containers, the object itself is counted by its owner.
+//Node and bucket overheads follow the libstdc++ layout.
+
+inline const size_t TREE_NODE_OVERHEAD = 4 * sizeof(void *);
+inline const size_t HASH_NODE_OVERHEAD = sizeof(void *) + sizeof(size_t);
+inline const size_t DEQUE_BLOCK_SIZE = 512;
+
+inline size_t OfString(const std::string &value)
+{
+    //short strings are stored inside the object
+    return value.capacity() > 15 ? value.capacity() + 1 : 0;
+}
+
+template <typename T>
+size_t OfVector(const std::vector<T> &value)
+{
+    return value.capacity() * sizeof(T);
+}
+
+template <typename T>
+size_t OfDeque(const std::deque<T> &value)
+{
+    const size_t block_elements = sizeof(T) < DEQUE_BLOCK_SIZE ? DEQUE_BLOCK_SIZE / sizeof(T) : 1;
+    const size_t blocks = value.size() / block_elements + 1;
+    return blocks * block_elements * sizeof(T) + (blocks + 2) * sizeof(T *);
+}
+
+//std::map and std::set
+template <typename Tree>
+size_t OfTree(const Tree &value)
+{
+    return value.size() * (TREE_NODE_OVERHEAD + sizeof(typename Tree::value_type));
+}
+
+//std::unordered_map and std::unordered_set
+template <typename HashTable>
+size_t OfHashTable(const HashTable &value)
+{
+    return value.bucket_count() * sizeof(void *) +
+           value.size() * (HASH_NODE_OVERHEAD + sizeof(typename HashTable::value_type));
+}
+
+inline size_t Total(const MemoryUsage &usage)
+{
+    size_t result = 0;
+    for (const auto &[name, bytes] : usage)
+    {
+        result += bytes;
+    }
+    return result;
+}
+
+} // namespace memory_usage
+} // namespace transport_catalogue
@@ -0,0 +1,388 @@
+#include "name_search.h"
+#include "memory_usage.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace transport_catalogue
+{
+namespace name_search
+{
+
+namespace
+{
+//Jaccard similarity of trigram sets below which names are not suggested
+const double MIN_SIMILARITY = 0.3;
+
+//marks a byte that is not a part of valid UTF-8, as surrogates are never decoded it is unique
+const uint32_t INVALID_BYTE_BASE = 0xdc00;
+//trigrams of ASCII letters are three bytes, other trigrams are hashes with this bit set
+const uint32_t NON_ASCII_TRIGRAM = 1u << 31;
+
+//reads the code point at pos and moves pos past it; a byte of broken UTF-8 is read as INVALID_BYTE_BASE + byte
+uint32_t ReadCodePoint(std::string_view text, size_t &pos)
+{
+    const auto byte = [text](size_t i) -> uint32_t
+    {
+        return static_cast<unsigned char>(text[i]);
+    };
+    const uint32_t first = byte(pos);
+    size_t length = 0;
+    uint32_t code_point = 0;
+    uint32_t min_code_point = 0;
+    if (first < 0x80)
+    {
+        ++pos;
+        return first;
+    }
+    if ((first & 0xe0) == 0xc0)
+    {
+        length = 2;
+        code_point = first & 0x1f;
+        min_code_point = 0x80;
+    }
+    else if ((first & 0xf0) == 0xe0)
+    {
+        length = 3;
+        code_point = first & 0x0f;
+        min_code_point = 0x800;
+    }
+    else if ((first & 0xf8) == 0xf0)
+    {
+        length = 4;
+        code_point = first & 0x07;
+        min_code_point = 0x10000;
+    }
+    bool is_valid = length > 0 && pos + length <= text.size();
+    for (size_t i = 1; is_valid && i < length; ++i)
+    {
+        is_valid = (byte(pos + i) & 0xc0) == 0x80;
+        code_point = (code_point << 6) | (byte(pos + i) & 0x3f);
+    }
+    if (!is_valid || code_point < min_code_point || code_point > 0x10ffff || (code_point >= 0xd800 && code_point <= 0xdfff))
+    {
+        ++pos;
+        return INVALID_BYTE_BASE + first;
+    }
+    pos += length;
+    return code_point;
+}
+
+void WriteCodePoint(uint32_t code_point, std::string &result)
+{
+    if (code_point >= INVALID_BYTE_BASE + 0x80 && code_point <= INVALID_BYTE_BASE + 0xff)
+    {
+        result.push_back(static_cast<char>(code_point - INVALID_BYTE_BASE));
+    }
+    else if (code_point < 0x80)
+    {
+        result.push_back(static_cast<char>(code_point));
+    }
+    else if (code_point < 0x800)
+    {
+        result.push_back(static_cast<char>(0xc0 | (code_point >> 6)));
+        result.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    }
+    else if (code_point < 0x10000)
+    {
+        result.push_back(static_cast<char>(0xe0 | (code_point >> 12)));
+        result.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+        result.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    }
+    else
+    {
+        result.push_back(static_cast<char>(0xf0 | (code_point >> 18)));
+        result.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3f)));
+        result.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+        result.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    }
+}
+
+//lower case for Latin (ASCII, Latin-1, Latin Extended-A), Greek and Cyrillic letters
+uint32_t FoldCase(uint32_t c)
+{
+    if ((c >= 'A' && c <= 'Z') || (c >= 0xc0 && c <= 0xde && c != 0xd7) || (c >= 0x391 && c <= 0x3ab && c != 0x3a2) ||
+        (c >= 0x410 && c <= 0x42f))
+    {
+        return c + 0x20;
+    }
+    if (c >= 0x400 && c <= 0x40f)
+    {
+        return c + 0x50;
+    }
+    if (c == 0x178)
+    {
+        return 0xff;
+    }
+    //Latin Extended-A pairs the cases as even and odd code points, except for three ranges paired the other way
+    const bool is_odd_upper = (c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17e);
+    if (c >= 0x100 && c <= 0x17f && c != 0x130 && c != 0x131 && c != 0x138 && c != 0x149 && c != 0x17f &&
+        (c % 2 == 1) == is_odd_upper)
+    {
+        return c + 1;
+    }
+    //Cyrillic pairs from Ѡ to ӿ, the same even and odd order
+    if (c >= 0x460 && c <= 0x4ff && c != 0x482 && !(c >= 0x483 && c <= 0x489) && c != 0x4c0 && c != 0x4cf)
+    {
+        const bool is_shifted = c >= 0x4c1 && c <= 0x4ce;
+        if ((c % 2 == 1) == is_shifted)
+        {
+            return c + 1;
+        }
+    }
+    return c;
+}
+
+void Normalize(std::string_view name, std::string &result)
+{
+    result.clear();
+    for (size_t pos = 0; pos < name.size();)
+    {
+        WriteCodePoint(FoldCase(ReadCodePoint(name, pos)), result);
+    }
+}
+
+uint32_t MakeTrigram(uint32_t first, uint32_t second, uint32_t third)
+{
+    if (first < 0x80 && second < 0x80 && third < 0x80)
+    {
+        return (first << 16) | (second << 8) | third;
+    }
+    //FNV-1a over the code points, a collision only makes two names look a bit more similar
+    uint32_t hash = 2166136261u;
+    for (uint32_t code_point : {first, second, third})
+    {
+        hash = (hash ^ code_point) * 16777619u;
+    }
+    return NON_ASCII_TRIGRAM | hash;
+}
+
+//trigrams of code points of the normalized name padded with two spaces before and one after, as in "  abc "
+template <typename Action>
+void ForEachTrigram(std::string_view name, Action action)
+{
+    uint32_t first = ' ';
+    uint32_t second = ' ';
+    for (size_t pos = 0; pos < name.size();)
+    {
+        const uint32_t third = ReadCodePoint(name, pos);
+        action(MakeTrigram(first, second, third));
+        first = std::exchange(second, third);
+    }
+    action(MakeTrigram(first, second, ' '));
+}
+
+//first position in [0, size) for which the predicate is false, predicate must be partitioned
+template <typename Predicate>
+uint32_t FindFirstFalse(uint32_t size, Predicate predicate)
+{
+    uint32_t left = 0;
+    uint32_t right = size;
+    while (left < right)
+    {
+        const uint32_t middle = left + (right - left) / 2;
+        if (predicate(middle))
+        {
+            left = middle + 1;
+        }
+        else
+        {
+            right = middle;
+        }
+    }
+    return left;
+}
+} // namespace
+
+StopNamesIndex::StopNamesIndex(const std::vector<std::string_view> &stop_names)
+{
+    std::vector<std::string> normalized(stop_names.size());
+    for (size_t stop_id = 0; stop_id < stop_names.size(); ++stop_id)
+    {
+        Normalize(stop_names[stop_id], normalized[stop_id]);
+    }
+
+    data_.sorted_stop_ids.resize(stop_names.size());
+    for (uint32_t stop_id = 0; stop_id < stop_names.size(); ++stop_id)
+    {
+        data_.sorted_stop_ids[stop_id] = stop_id;
+    }
+    std::sort(data_.sorted_stop_ids.begin(), data_.sorted_stop_ids.end(), [&normalized](uint32_t lhs, uint32_t rhs)
+              { return std::pair(std::string_view(normalized[lhs]), lhs) < std::pair(std::string_view(normalized[rhs]), rhs); });
+
+    //(trigram, position) pairs, sorting them gives both the postings and deduplication
+    std::vector<uint64_t> trigram_positions;
+    for (uint32_t position = 0; position < data_.sorted_stop_ids.size(); ++position)
+    {
+        ForEachTrigram(normalized[data_.sorted_stop_ids[position]], [&trigram_positions, position](uint32_t trigram)
+                       { trigram_positions.push_back((static_cast<uint64_t>(trigram) << 32) | position); });
+    }
+    std::sort(trigram_positions.begin(), trigram_positions.end());
+    trigram_positions.erase(std::unique(trigram_positions.begin(), trigram_positions.end()), trigram_positions.end());
+
+    data_.positions.reserve(trigram_positions.size());
+    for (uint64_t trigram_position : trigram_positions)
+    {
+        const uint32_t trigram = static_cast<uint32_t>(trigram_position >> 32);
+        if (data_.trigrams.empty() || data_.trigrams.back() != trigram)
+        {
+            data_.trigrams.push_back(trigram);
+            data_.trigram_offsets.push_back(data_.positions.size());
+        }
+        data_.positions.push_back(static_cast<uint32_t>(trigram_position));
+    }
+    data_.trigram_offsets.push_back(data_.positions.size());
+
+    Prepare(stop_names);
+}
+
+StopNamesIndex::StopNamesIndex(NamesIndexData data, const std::vector<std::string_view> &stop_names)
+    : data_(std::move(data))
+{
+    //offsets must cover positions exactly and trigrams must be sorted for the binary search,
+    //the database may be damaged
+    const bool is_broken = data_.sorted_stop_ids.size() != stop_names.size() ||
+                           data_.trigram_offsets.size() != data_.trigrams.size() + 1 ||
+                           data_.trigram_offsets.front() != 0 ||
+                           data_.trigram_offsets.back() != data_.positions.size() ||
+                           !std::is_sorted(data_.trigram_offsets.begin(), data_.trigram_offsets.end()) ||
+                           std::adjacent_find(data_.trigrams.begin(), data_.trigrams.end(), std::greater_equal<uint32_t>()) != data_.trigrams.end() ||
+                           std::any_of(data_.sorted_stop_ids.begin(), data_.sorted_stop_ids.end(), [&stop_names](uint32_t stop_id)
+                                       { return stop_id >= stop_names.size(); }) ||
+                           std::any_of(data_.positions.begin(), data_.positions.end(), [&stop_names](uint32_t position)
+                                       { return position >= stop_names.size(); });
+    if (is_broken)
+    {
+        throw std::runtime_error("Broken stop names index");
+    }
+    Prepare(stop_names);
+}
+
+void StopNamesIndex::Prepare(const std::vector<std::string_view> &stop_names)
+{
+    size_t names_size = 0;
+    for (std::string_view name : stop_names)
+    {
+        names_size += name.size();
+    }
+    names_.reserve(names_size);
+    name_offsets_.reserve(stop_names.size() + 1);
+    name_offsets_.push_back(0);
+    std::string normalized_name;
+    for (uint32_t stop_id : data_.sorted_stop_ids)
+    {
+        Normalize(stop_names[stop_id], normalized_name);
+        names_ += normalized_name;
+        name_offsets_.push_back(names_.size());
+    }
+
+    trigrams_count_.assign(stop_names.size(), 0);
+    for (uint32_t position : data_.positions)
+    {
+        ++trigrams_count_[position];
+    }
+}
+
+size_t StopNamesIndex::GetMemoryUsage() const
+{
+    return memory_usage::OfVector(data_.sorted_stop_ids) + memory_usage::OfVector(data_.trigrams) +
+           memory_usage::OfVector(data_.trigram_offsets) + memory_usage::OfVector(data_.positions) +
+           memory_usage::OfString(names_) + memory_usage::OfVector(name_offsets_) + memory_usage::OfVector(trigrams_count_);
+}
+
+std::string_view StopNamesIndex::GetName(uint32_t position) const
+{
+    return std::string_view(names_).substr(name_offsets_[position], name_offsets_[position + 1] - name_offsets_[position]);
+}
+
+void StopNamesIndex::Search(std::string_view query, size_t count, std::vector<uint32_t> &stop_ids) const
+{
+    stop_ids.clear();
+    if (count == 0 || IsEmpty())
+    {
+        return;
+    }
+
+    thread_local std::string normalized_query;
+    Normalize(query, normalized_query);
+    const std::string_view prefix = normalized_query;
+
+    const uint32_t names_count = data_.sorted_stop_ids.size();
+    const uint32_t prefix_begin = FindFirstFalse(names_count, [this, prefix](uint32_t position)
+                                                 { return GetName(position) < prefix; });
+    const uint32_t prefix_end = FindFirstFalse(names_count, [this, prefix](uint32_t position)
+                                               { return GetName(position).substr(0, prefix.size()) <= prefix; });
+    for (uint32_t position = prefix_begin; position < prefix_end && stop_ids.size() < count; ++position)
+    {
+        stop_ids.push_back(data_.sorted_stop_ids[position]);
+    }
+    if (stop_ids.size() == count || prefix.empty())
+    {
+        return;
+    }
+
+    thread_local std::vector<uint32_t> query_trigrams;
+    query_trigrams.clear();
+    ForEachTrigram(prefix, [](uint32_t trigram)
+                   { query_trigrams.push_back(trigram); });
+    std::sort(query_trigrams.begin(), query_trigrams.end());
+    query_trigrams.erase(std::unique(query_trigrams.begin(), query_trigrams.end()), query_trigrams.end());
+
+    //common trigrams of every name with the query, zero between queries
+    thread_local std::vector<uint32_t> common_trigrams;
+    thread_local std::vector<uint32_t> touched_positions;
+    if (common_trigrams.size() < names_count)
+    {
+        common_trigrams.resize(names_count, 0);
+    }
+    touched_positions.clear();
+    for (uint32_t trigram : query_trigrams)
+    {
+        const auto trigram_it = std::lower_bound(data_.trigrams.begin(), data_.trigrams.end(), trigram);
+        if (trigram_it == data_.trigrams.end() || *trigram_it != trigram)
+        {
+            continue;
+        }
+        const size_t trigram_index = trigram_it - data_.trigrams.begin();
+        for (uint32_t i = data_.trigram_offsets[trigram_index]; i < data_.trigram_offsets[trigram_index + 1]; ++i)
+        {
+            const uint32_t position = data_.positions[i];
+            if (common_trigrams[position]++ == 0)
+            {
+                touched_positions.push_back(position);
+            }
+        }
+    }
+
+    thread_local std::vector<std::pair<double, uint32_t>> candidates;
+    candidates.clear();
+    for (uint32_t position : touched_positions)
+    {
+        const uint32_t common = std::exchange(common_trigrams[position], 0);
+        if (position >= prefix_begin && position < prefix_end)
+        {
+            continue;
+        }
+        const double similarity = static_cast<double>(common) / (query_trigrams.size() + trigrams_count_[position] - common);
+        if (similarity >= MIN_SIMILARITY)
+        {
+            candidates.push_back({similarity, position});
+        }
+    }
+
+    const size_t left_count = std::min(count - stop_ids.size(), candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + left_count, candidates.end(), [](const auto &lhs, const auto &rhs)
+                      { return lhs.first > rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second); });
+    for (size_t i = 0; i < left_count; ++i)
+    {
+        stop_ids.push_back(data_.sorted_stop_ids[candidates[i].second]);
+    }
+}
+
+} // namespace name_search
+} // namespace transport_catalogue
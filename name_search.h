@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace transport_catalogue
+{
+namespace name_search
+{
+
+//packed data of the index, exactly what is stored in the database
+struct NamesIndexData
+{
+    //stop ids in order of normalized names
+    std::vector<uint32_t> sorted_stop_ids;
+    //trigram -> positions in sorted_stop_ids, in CSR form
+    std::vector<uint32_t> trigrams;
+    std::vector<uint32_t> trigram_offsets;
+    std::vector<uint32_t> positions;
+};
+
+//Autocomplete over stop names: prefix ranges over the sorted names and
+//typo tolerant matching by common trigrams of code points. Names are UTF-8, case is folded
+//for Latin, Greek and Cyrillic letters.
+class StopNamesIndex
+{
+public:
+    StopNamesIndex() = default;
+
+    //build index, stop_id is a position in stop_names
+    explicit StopNamesIndex(const std::vector<std::string_view> &stop_names);
+
+    //restore serialized index, stop_names are indexed by stop_id
+    StopNamesIndex(NamesIndexData data, const std::vector<std::string_view> &stop_names);
+
+    //up to count stop ids: names starting with query in lexicographical order first,
+    //then names similar to query from the most similar.
+    //Scratch buffers are kept per thread, so a query does not allocate after warming up.
+    void Search(std::string_view query, size_t count, std::vector<uint32_t> &stop_ids) const;
+
+    const NamesIndexData &GetData() const
+    {
+        return data_;
+    }
+
+    bool IsEmpty() const
+    {
+        return data_.sorted_stop_ids.empty();
+    }
+
+    size_t GetMemoryUsage() const;
+
+private:
+    std::string_view GetName(uint32_t position) const;
+
+    //fills normalized names and trigram counts from data_
+    void Prepare(const std::vector<std::string_view> &stop_names);
+
+    NamesIndexData data_;
+    //normalized names in sorted order, one buffer for all of them
+    std::string names_;
+    std::vector<uint32_t> name_offsets_;
+    //count of distinct trigrams of every name
+    std::vector<uint32_t> trigrams_count_;
+};
+
+} // namespace name_search
+} // namespace transport_catalogue
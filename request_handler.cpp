@@ -8,7 +8,13 @@ namespace request_handler
 
 using namespace domain;
 
-RequestHandler::RequestHandler(const TransportCatalogue &catalogue, renderer::MapRenderer &renderer)
+namespace
+{
+//number of stops considered to get on or off the route by foot
+const size_t ACCESS_STOPS_COUNT = 5;
+} // namespace
+
+RequestHandler::RequestHandler(const TransportCatalogue &catalogue, const renderer::MapRenderer &renderer)
     : catalogue_(catalogue), renderer_(renderer)
 {
 }
@@ -30,26 +36,49 @@ RequestHandler::GetBusStat(const std::string_view &bus_name) const
     return result;
 }
 
-const std::optional<std::set<std::string_view>>
+std::optional<StopBusesRange>
 RequestHandler::GetBusesNameByStop(const std::string_view &stop_name) const
 {
-    StopPtr stop = catalogue_.GetStop(stop_name);
-    if (stop == nullptr)
+    return catalogue_.GetBusesThroughStop(stop_name);
+}
+
+std::vector<RequestHandler::StopDistance>
+RequestHandler::GetNearestStops(geo::Coordinates point, std::optional<size_t> count, std::optional<double> radius) const
+{
+    const auto &stops_index = catalogue_.GetStopsIndex();
+    std::vector<spatial_index::NearestStop> nearest_stops;
+    if (count)
     {
-        return std::nullopt;
+        nearest_stops = stops_index.FindNearest(point, *count, radius);
+    }
+    else if (radius)
+    {
+        nearest_stops = stops_index.FindInRadius(point, *radius);
     }
-    const auto &stop_to_buses = catalogue_.GetAllStopToBuses();
-    auto iter = stop_to_buses.find(stop);
 
-    if (iter == stop_to_buses.end())
+    std::vector<StopDistance> result;
+    result.reserve(nearest_stops.size());
+    for (const auto &nearest_stop : nearest_stops)
     {
-        const static std::set<std::string_view> empty_set;
-        return empty_set;
+        result.push_back({catalogue_.GetStopById(nearest_stop.stop_id)->GetName(), nearest_stop.distance});
     }
-    return iter->second;
+    return result;
 }
 
-svg::Document &RequestHandler::RenderMap(svg::Document &doc)
+void RequestHandler::SearchStops(std::string_view query, size_t count,
+                                 std::vector<std::string_view> &stop_names) const
+{
+    thread_local std::vector<uint32_t> stop_ids;
+    catalogue_.GetStopNamesIndex().Search(query, count, stop_ids);
+
+    stop_names.clear();
+    for (uint32_t stop_id : stop_ids)
+    {
+        stop_names.push_back(catalogue_.GetStopById(stop_id)->GetName());
+    }
+}
+
+svg::Document &RequestHandler::RenderMap(svg::Document &doc) const
 {
     std::vector<domain::BusPtr> buses;
     buses.reserve(catalogue_.GetAllBusesNames().size());
@@ -59,13 +88,12 @@ svg::Document &RequestHandler::RenderMap(svg::Document &doc)
         buses.push_back(catalogue_.GetBus(bus_name));
     }
 
-    const auto &stops_to_buses = catalogue_.GetAllStopToBuses();
     std::vector<domain::StopPtr> stops;
-    stops.reserve(stops_to_buses.size());
+    stops.reserve(catalogue_.GetUsingStopsCount());
 
     for (const auto &stop : catalogue_.GetAllStops())
     {
-        if (stops_to_buses.count(stop.second))
+        if (!catalogue_.GetBusesThroughStop(stop.second).empty())
         {
             stops.push_back(stop.second);
         }
@@ -89,7 +117,7 @@ std::optional<transport_router::TransportRouter> &RequestHandler::GetRouter()
     return router_;
 }
 
-std::optional<transport_router::RouteInfo> RequestHandler::GetRouteInfo(const std::string &stop_from, const std::string &stop_to)
+std::optional<transport_router::RouteInfo> RequestHandler::GetRouteInfo(const std::string &stop_from, const std::string &stop_to) const
 {
     if (catalogue_.GetAllBusesNames().size() == 0)
     {
@@ -99,5 +127,49 @@ std::optional<transport_router::RouteInfo> RequestHandler::GetRouteInfo(const st
     return info;
 }
 
+std::optional<transport_router::RouteInfo> RequestHandler::GetRouteInfo(const RoutePoint &from, const RoutePoint &to) const
+{
+    if (std::holds_alternative<std::string>(from) && std::holds_alternative<std::string>(to))
+    {
+        return GetRouteInfo(std::get<std::string>(from), std::get<std::string>(to));
+    }
+    if (catalogue_.GetAllBusesNames().size() == 0)
+    {
+        return std::nullopt;
+    }
+
+    const std::vector<transport_router::WalkingStop> from_stops = GetWalkingStops(from);
+    const std::vector<transport_router::WalkingStop> to_stops = GetWalkingStops(to);
+    std::optional<double> direct_distance;
+    if (std::holds_alternative<geo::Coordinates>(from) && std::holds_alternative<geo::Coordinates>(to))
+    {
+        direct_distance = geo::ComputeClosestDistance(std::get<geo::Coordinates>(from), std::get<geo::Coordinates>(to));
+    }
+    return router_->BuildRoute(from_stops, to_stops, direct_distance);
+}
+
+std::vector<transport_router::WalkingStop> RequestHandler::GetWalkingStops(const RoutePoint &point) const
+{
+    std::vector<transport_router::WalkingStop> result;
+    if (const auto *stop_name = std::get_if<std::string>(&point))
+    {
+        if (router_->HasStop(*stop_name))
+        {
+            //items of the route point to the name, so it is taken from the catalogue and not from the request
+            result.push_back({catalogue_.GetStop(*stop_name)->GetName(), 0});
+        }
+        return result;
+    }
+
+    const auto nearest_stops = catalogue_.GetStopsIndex().FindNearest(
+        std::get<geo::Coordinates>(point), ACCESS_STOPS_COUNT, std::nullopt, [this](size_t stop_id)
+        { return router_->HasStop(catalogue_.GetStopById(stop_id)->GetName()); });
+    for (const auto &nearest_stop : nearest_stops)
+    {
+        result.push_back({catalogue_.GetStopById(nearest_stop.stop_id)->GetName(), nearest_stop.distance});
+    }
+    return result;
+}
+
 } // namespace request_handler
 } // namespace transport_catalogue
@@ -9,12 +9,16 @@
 #include <optional>
 #include <string>
 #include <string_view>
+#include <variant>
 #include <vector>
 
 namespace transport_catalogue
 {
 namespace request_handler
 {
+//route endpoint, either a stop name or an arbitrary point
+using RoutePoint = std::variant<std::string, geo::Coordinates>;
+
 class RequestHandler
 {
 
@@ -27,27 +31,46 @@ class RequestHandler
         double curvature = 0;
     };
 
+    struct StopDistance
+    {
+        std::string_view name;
+        double distance = 0;
+    };
+
 public:
-    RequestHandler(const TransportCatalogue &catalogue, renderer::MapRenderer &renderer);
+    RequestHandler(const TransportCatalogue &catalogue, const renderer::MapRenderer &renderer);
 
     std::optional<BusInfo> GetBusStat(const std::string_view &bus_name) const;
 
-    const std::optional<std::set<std::string_view>> GetBusesNameByStop(const std::string_view &stop_name) const;
+    std::optional<StopBusesRange> GetBusesNameByStop(const std::string_view &stop_name) const;
 
-    svg::Document &RenderMap(svg::Document &doc);
+    //nearest stops to the point, if count is not set returns all stops in the radius
+    std::vector<StopDistance> GetNearestStops(geo::Coordinates point, std::optional<size_t> count,
+                                              std::optional<double> radius) const;
+
+    //up to count stop names for autocomplete: names starting with query, then similar ones.
+    //stop_names is overwritten, a caller keeping it between queries does not allocate
+    void SearchStops(std::string_view query, size_t count, std::vector<std::string_view> &stop_names) const;
+
+    svg::Document &RenderMap(svg::Document &doc) const;
 
     void CreateRouter(transport_router::TransportRouterParams router_params);
 
-    std::optional<transport_router::RouteInfo> GetRouteInfo(const std::string &stop_from, const std::string &stop_to);
+    std::optional<transport_router::RouteInfo> GetRouteInfo(const std::string &stop_from, const std::string &stop_to) const;
+
+    //route between points walking to the nearest stops
+    std::optional<transport_router::RouteInfo> GetRouteInfo(const RoutePoint &from, const RoutePoint &to) const;
 
     const std::optional<transport_router::TransportRouter> &GetRouter() const;
 
     std::optional<transport_router::TransportRouter> &GetRouter();
 
 private:
+    std::vector<transport_router::WalkingStop> GetWalkingStops(const RoutePoint &point) const;
+
     const TransportCatalogue &catalogue_;
     std::optional<transport_router::TransportRouter> router_ = std::nullopt;
-    renderer::MapRenderer &renderer_;
+    const renderer::MapRenderer &renderer_;
 };
 } // namespace request_handler
 } // namespace transport_catalogue
\ No newline at end of file
@@ -6,6 +6,8 @@
 #include <cassert>
 #include <cstdint>
 #include <iterator>
+#include <limits>
+#include <memory>
 #include <optional>
 #include <stdexcept>
 #include <unordered_map>
@@ -22,26 +24,93 @@ private:
     using Graph = DirectedWeightedGraph<Weight>;
 
 public:
-    struct RouteInternalData
+    //weight of a route that does not exist
+    static constexpr Weight NO_ROUTE = std::numeric_limits<Weight>::infinity();
+    //last edge of an empty or absent route
+    static constexpr uint32_t NO_EDGE = std::numeric_limits<uint32_t>::max();
+
+    //best routes from one vertex to all vertices: weights and last edges of the routes
+    struct RoutesRow
     {
-        Weight weight;
-        std::optional<EdgeId> prev_edge;
+        const Weight *weights = nullptr;
+        const uint32_t *prev_edges = nullptr;
+        //keeps the row alive if the storage may release it
+        std::shared_ptr<const void> holder;
     };
 
-    using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+    //all pairs routes matrix, it may be computed, decoded or mapped from a file
+    class RoutesStorage
+    {
+    public:
+        virtual ~RoutesStorage() = default;
+
+        virtual size_t GetVertexCount() const = 0;
+
+        virtual RoutesRow GetRow(VertexId from) const = 0;
+
+        //bytes of the matrix held in memory
+        virtual size_t GetMemoryUsage() const = 0;
+    };
+
+    //matrix in two contiguous arrays, rows one after another
+    class FlatRoutesStorage : public RoutesStorage
+    {
+    public:
+        explicit FlatRoutesStorage(size_t vertex_count)
+            : vertex_count_(vertex_count), weights_(vertex_count * vertex_count, NO_ROUTE),
+              prev_edges_(vertex_count * vertex_count, NO_EDGE)
+        {
+        }
+
+        size_t GetVertexCount() const override
+        {
+            return vertex_count_;
+        }
+
+        RoutesRow GetRow(VertexId from) const override
+        {
+            return {weights_.data() + from * vertex_count_, prev_edges_.data() + from * vertex_count_, nullptr};
+        }
+
+        size_t GetMemoryUsage() const override
+        {
+            return weights_.capacity() * sizeof(Weight) + prev_edges_.capacity() * sizeof(uint32_t);
+        }
+
+        Weight *GetWeights(VertexId from)
+        {
+            return weights_.data() + from * vertex_count_;
+        }
+
+        uint32_t *GetPrevEdges(VertexId from)
+        {
+            return prev_edges_.data() + from * vertex_count_;
+        }
+
+    private:
+        size_t vertex_count_;
+        std::vector<Weight> weights_;
+        std::vector<uint32_t> prev_edges_;
+    };
 
     explicit Router(const Graph &graph);
 
-    explicit Router(const Graph &graph, RoutesInternalData routes_internal_data);
+    explicit Router(const Graph &graph, std::shared_ptr<const RoutesStorage> routes_storage);
 
     const Graph &GetGraph() const
     {
         return graph_;
     }
 
-    const RoutesInternalData &GetRoutesInternalData() const
+    const RoutesStorage &GetRoutesStorage() const
+    {
+        return *routes_storage_;
+    }
+
+    //for a storage built on top of this one
+    const std::shared_ptr<const RoutesStorage> &ShareRoutesStorage() const
     {
-        return routes_internal_data_;
+        return routes_storage_;
     }
 
     struct RouteInfo
@@ -52,13 +121,34 @@ public:
 
     std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
 
+    struct RouteEndpoint
+    {
+        VertexId vertex;
+        //cost to get to the source vertex or to get away from the target vertex
+        Weight weight;
+    };
+
+    struct EndpointsRouteInfo
+    {
+        VertexId from;
+        VertexId to;
+        //weight of the route includes weights of both endpoints
+        RouteInfo route;
+    };
+
+    //the best route from any of the sources to any of the targets
+    std::optional<EndpointsRouteInfo> BuildRoute(const std::vector<RouteEndpoint> &sources,
+                                                 const std::vector<RouteEndpoint> &targets) const;
+
 private:
-    void InitializeRoutesInternalData(const Graph &graph)
+    static void InitializeRoutes(const Graph &graph, FlatRoutesStorage &routes)
     {
         const size_t vertex_count = graph.GetVertexCount();
         for (VertexId vertex = 0; vertex < vertex_count; ++vertex)
         {
-            routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
+            Weight *weights = routes.GetWeights(vertex);
+            uint32_t *prev_edges = routes.GetPrevEdges(vertex);
+            weights[vertex] = ZERO_WEIGHT;
             for (const EdgeId edge_id : graph.GetIncidentEdges(vertex))
             {
                 const auto &edge = graph.GetEdge(edge_id);
@@ -66,39 +156,38 @@ private:
                 {
                     throw std::domain_error("Edges' weights should be non-negative");
                 }
-                auto &route_internal_data = routes_internal_data_[vertex][edge.to];
-                if (!route_internal_data || route_internal_data->weight > edge.weight)
+                if (weights[edge.to] > edge.weight)
                 {
-                    route_internal_data = RouteInternalData{edge.weight, edge_id};
+                    weights[edge.to] = edge.weight;
+                    prev_edges[edge.to] = static_cast<uint32_t>(edge_id);
                 }
             }
         }
     }
 
-    void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData &route_from,
-                    const RouteInternalData &route_to)
-    {
-        auto &route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-        const Weight candidate_weight = route_from.weight + route_to.weight;
-        if (!route_relaxing || candidate_weight < route_relaxing->weight)
-        {
-            route_relaxing = {candidate_weight,
-                              route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge};
-        }
-    }
-
-    void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through)
+    static void RelaxRoutesThroughVertex(size_t vertex_count, VertexId vertex_through, FlatRoutesStorage &routes)
     {
+        const Weight *weights_through = routes.GetWeights(vertex_through);
+        const uint32_t *prev_edges_through = routes.GetPrevEdges(vertex_through);
         for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from)
         {
-            if (const auto &route_from = routes_internal_data_[vertex_from][vertex_through])
+            Weight *weights = routes.GetWeights(vertex_from);
+            uint32_t *prev_edges = routes.GetPrevEdges(vertex_from);
+            const Weight weight_from = weights[vertex_through];
+            if (weight_from == NO_ROUTE)
             {
-                for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to)
+                continue;
+            }
+            const uint32_t prev_edge_from = prev_edges[vertex_through];
+            for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to)
+            {
+                //a sum with NO_ROUTE is NO_ROUTE and never wins
+                const Weight candidate_weight = weight_from + weights_through[vertex_to];
+                if (candidate_weight < weights[vertex_to])
                 {
-                    if (const auto &route_to = routes_internal_data_[vertex_through][vertex_to])
-                    {
-                        RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
-                    }
+                    weights[vertex_to] = candidate_weight;
+                    prev_edges[vertex_to] = prev_edges_through[vertex_to] != NO_EDGE ? prev_edges_through[vertex_to]
+                                                                                      : prev_edge_from;
                 }
             }
         }
@@ -106,26 +195,26 @@ private:
 
     static constexpr Weight ZERO_WEIGHT{};
     const Graph &graph_;
-    RoutesInternalData routes_internal_data_;
+    std::shared_ptr<const RoutesStorage> routes_storage_;
 };
 
 template <typename Weight>
 Router<Weight>::Router(const Graph &graph)
-    : graph_(graph), routes_internal_data_(graph.GetVertexCount(),
-                                           std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
+    : graph_(graph)
 {
-    InitializeRoutesInternalData(graph);
-
     const size_t vertex_count = graph.GetVertexCount();
+    auto routes = std::make_shared<FlatRoutesStorage>(vertex_count);
+    InitializeRoutes(graph, *routes);
     for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through)
     {
-        RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+        RelaxRoutesThroughVertex(vertex_count, vertex_through, *routes);
     }
+    routes_storage_ = std::move(routes);
 }
 
 template <typename Weight>
-Router<Weight>::Router(const Graph &graph, RoutesInternalData routes_internal_data)
-    : graph_(graph), routes_internal_data_(std::move(routes_internal_data))
+Router<Weight>::Router(const Graph &graph, std::shared_ptr<const RoutesStorage> routes_storage)
+    : graph_(graph), routes_storage_(std::move(routes_storage))
 {
 }
 
@@ -133,22 +222,68 @@ template <typename Weight>
 std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
                                                                              VertexId to) const
 {
-    const auto &route_internal_data = routes_internal_data_.at(from).at(to);
-    if (!route_internal_data)
+    if (from >= routes_storage_->GetVertexCount() || to >= routes_storage_->GetVertexCount())
+    {
+        throw std::out_of_range("Unknown vertex");
+    }
+    //the whole route is restored from the row of its start
+    const RoutesRow row = routes_storage_->GetRow(from);
+    const Weight weight = row.weights[to];
+    if (weight == NO_ROUTE)
     {
         return std::nullopt;
     }
-    const Weight weight = route_internal_data->weight;
     std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
-         edge_id;
-         edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+    for (uint32_t edge_id = row.prev_edges[to]; edge_id != NO_EDGE; edge_id = row.prev_edges[graph_.GetEdge(edge_id).from])
     {
-        edges.push_back(*edge_id);
+        edges.push_back(edge_id);
     }
     std::reverse(edges.begin(), edges.end());
 
     return RouteInfo{weight, std::move(edges)};
 }
 
+template <typename Weight>
+std::optional<typename Router<Weight>::EndpointsRouteInfo>
+Router<Weight>::BuildRoute(const std::vector<RouteEndpoint> &sources, const std::vector<RouteEndpoint> &targets) const
+{
+    std::optional<std::pair<const RouteEndpoint *, const RouteEndpoint *>> best_endpoints;
+    Weight best_weight{};
+    const size_t vertex_count = routes_storage_->GetVertexCount();
+    for (const RouteEndpoint &source : sources)
+    {
+        if (source.vertex >= vertex_count)
+        {
+            throw std::out_of_range("Unknown vertex");
+        }
+        const RoutesRow row = routes_storage_->GetRow(source.vertex);
+        for (const RouteEndpoint &target : targets)
+        {
+            if (target.vertex >= vertex_count)
+            {
+                throw std::out_of_range("Unknown vertex");
+            }
+            if (row.weights[target.vertex] == NO_ROUTE)
+            {
+                continue;
+            }
+            const Weight weight = source.weight + row.weights[target.vertex] + target.weight;
+            if (!best_endpoints || weight < best_weight)
+            {
+                best_endpoints = {&source, &target};
+                best_weight = weight;
+            }
+        }
+    }
+    if (!best_endpoints)
+    {
+        return std::nullopt;
+    }
+
+    const auto [source, target] = *best_endpoints;
+    EndpointsRouteInfo result{source->vertex, target->vertex, *BuildRoute(source->vertex, target->vertex)};
+    result.route.weight = best_weight;
+    return result;
+}
+
 } // namespace graph
\ No newline at end of file
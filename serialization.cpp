@@ -1,14 +1,26 @@
 #include "serialization.h"
-#include "JSONlib/json.h"
 #include "SvgLib/svg.h"
+#include "memory_usage.h"
 #include "transport_catalogue.h"
 #include "transport_router.h"
 
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <google/protobuf/arena.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <iterator>
+#include <limits>
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <transport_catalogue.pb.h>
 #include <unordered_map>
+#include <unordered_set>
+#include <variant>
 #include <vector>
 
 namespace transport_catalogue
@@ -18,515 +30,1104 @@ namespace serialization
 
 using namespace std::string_literals;
 
-Serializer::Serializer(const std::vector<json::Dict> &stops_request, const std::vector<json::Dict> &bus_requests,
-                       const json::Dict &render_settings, const transport_router::TransportRouter &router)
-    : stops_request_(stops_request), bus_requests_(bus_requests), render_settings_(render_settings), router_(router)
+namespace
 {
-}
-
-transport_catalogue_serialize::EdgeList Serializer::SerializeEdgeList() const
+//Calls body(first, last) for ranges of [0, count) on all cores and waits for them.
+//A range is at least min_range long, so small inputs stay on the calling thread.
+template <typename Body>
+void ParallelFor(size_t count, size_t min_range, const Body &body)
 {
-    const auto &graph = router_.GetGraph();
-    const std::vector<graph::Edge<double>> &edges = graph.GetEdges();
-    transport_catalogue_serialize::EdgeList serializing_edge_list;
-    size_t current_id = 0;
-    for (auto &edge : edges)
+    const size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    const size_t threads = std::clamp<size_t>(count / std::max<size_t>(1, min_range), 1, max_threads);
+    const size_t range = (count + threads - 1) / threads;
+    std::vector<std::future<void>> tasks;
+    for (size_t first = range; first < count; first += range)
     {
-        transport_catalogue_serialize::Edge serializing_edge;
-        serializing_edge.set_bus_id(bus_name_to_id_.at(edge.bus_name));
-        serializing_edge.set_stop_id(stop_name_to_id_.at(edge.stop_name));
-        serializing_edge.set_span_count(edge.span_count);
-        serializing_edge.set_wait_time(edge.wait_time);
-        serializing_edge.set_time_in_road(edge.time_in_road);
-        serializing_edge.set_from_id(edge.from);
-        serializing_edge.set_to_id(edge.to);
-        serializing_edge.set_weight(edge.weight);
-        serializing_edge_list.add_edge();
-        *serializing_edge_list.mutable_edge(current_id) = serializing_edge;
-        current_id++;
+        tasks.push_back(std::async(std::launch::async, [&body, first, last = std::min(first + range, count)]
+                                   { body(first, last); }));
+    }
+    body(0, std::min(range, count));
+    for (auto &task : tasks)
+    {
+        task.get();
     }
-    return serializing_edge_list;
 }
 
-transport_catalogue_serialize::IncidenceLists Serializer::SerializeIncidenceLists() const
+//fills every cell of the row
+void DecodeRoutesRow(const transport_catalogue_serialize::RouteInternalDataList &deser_data_list, size_t vertex_count,
+                     double *weights, uint32_t *prev_edges)
 {
-    transport_catalogue_serialize::IncidenceLists serializing_incidence_lists_;
-    const auto &graph = router_.GetGraph();
-    for (const auto &incidence_list : graph.GetIncedenceLists())
+    using Router = graph::Router<double>;
+    if (deser_data_list.route_internal_data_size() == 0)
     {
-        transport_catalogue_serialize::IncidenceList serializing_incidence_list;
-        for (size_t edge_id : incidence_list)
+        if (static_cast<size_t>(deser_data_list.weights_size()) != vertex_count ||
+            static_cast<size_t>(deser_data_list.prev_edges_size()) != vertex_count)
         {
-            serializing_incidence_list.add_edge_id(edge_id);
+            throw std::runtime_error("Broken routes internal data");
         }
-        size_t current_lists_pos = serializing_incidence_lists_.incidence_list_size();
-        serializing_incidence_lists_.add_incidence_list();
-        *serializing_incidence_lists_.mutable_incidence_list(current_lists_pos) = serializing_incidence_list;
+        std::copy(deser_data_list.weights().begin(), deser_data_list.weights().end(), weights);
+        for (size_t j = 0; j < vertex_count; j++)
+        {
+            prev_edges[j] = deser_data_list.prev_edges(j) - 1;
+        }
+        return;
+    }
+    //database of an old version with a message per cell
+    if (static_cast<size_t>(deser_data_list.route_internal_data_size()) != vertex_count)
+    {
+        throw std::runtime_error("Broken routes internal data");
+    }
+    for (size_t j = 0; j < vertex_count; j++)
+    {
+        const transport_catalogue_serialize::RouteInternalData &deser_current_data = deser_data_list.route_internal_data(j);
+        weights[j] = deser_current_data.is_exist() ? deser_current_data.weight() : Router::NO_ROUTE;
+        prev_edges[j] = deser_current_data.is_exist() && deser_current_data.has_prev_edge() ? deser_current_data.prev_edge().id()
+                                                                                            : Router::NO_EDGE;
     }
-    return std::move(serializing_incidence_lists_);
 }
 
-transport_catalogue_serialize::Graph Serializer::SerializeGraph() const
+//rows of the routes matrix decoded by one task
+const size_t MIN_ROWS_PER_TASK = 64;
+//edges decoded by one task
+const size_t MIN_EDGES_PER_TASK = 16384;
+bool IsSameEdge(const graph::Edge<double> &lhs, const graph::Edge<double> &rhs)
 {
-    transport_catalogue_serialize::Graph serializing_graph;
+    return lhs.type == rhs.type && lhs.bus_name == rhs.bus_name && lhs.stop_name == rhs.stop_name &&
+           lhs.stop_to_name == rhs.stop_to_name && lhs.span_count == rhs.span_count && lhs.wait_time == rhs.wait_time &&
+           lhs.time_in_road == rhs.time_in_road && lhs.from == rhs.from && lhs.to == rhs.to && lhs.weight == rhs.weight;
+}
 
-    transport_catalogue_serialize::EdgeList serializing_edge_list = SerializeEdgeList();
+//first block of the arena a chunk is parsed into, chunks of edges and incidence lists fit in it
+const size_t ARENA_BLOCK_SIZE = 2 << 20;
+} // namespace
 
-    transport_catalogue_serialize::IncidenceLists serializing_incidence_lists_ = SerializeIncidenceLists();
+Serializer::Serializer(const TransportCatalogue &catalogue, const renderer::RendererSettings &render_settings,
+                       const transport_router::TransportRouter &router, bool measure_memory)
+    : catalogue_(catalogue), render_settings_(render_settings), router_(router), measure_memory_(measure_memory)
+{
+    const std::deque<domain::Bus> &buses = catalogue_.GetAllBuses();
+    bus_name_to_id_.reserve(buses.size());
+    for (size_t bus_id = 0; bus_id < buses.size(); bus_id++)
+    {
+        bus_name_to_id_[buses[bus_id].GetName()] = bus_id;
+    }
 
-    *serializing_graph.mutable_edge_list() = serializing_edge_list;
-    *serializing_graph.mutable_incidence_lists() = serializing_incidence_lists_;
+    const std::unordered_map<std::string, size_t> &stop_name_to_vertex_id = router_.GetStopsToId();
+    vertex_to_stop_id_.resize(router_.GetGraph().GetVertexCount());
+    for (const auto &[stop_name, vertex_id] : stop_name_to_vertex_id)
+    {
+        const domain::StopPtr stop = catalogue_.GetStop(stop_name);
+        if (!stop)
+        {
+            throw std::logic_error("Unknown stop in the router: " + stop_name);
+        }
+        vertex_to_stop_id_[vertex_id] = stop->GetId();
+    }
+}
 
-    return std::move(serializing_graph);
+void Serializer::SerializeEdges(size_t first, size_t last, transport_catalogue_serialize::EdgeList &serializing_edge_list) const
+{
+    const std::vector<graph::Edge<double>> &edges = router_.GetGraph().GetEdges();
+    serializing_edge_list.mutable_edge()->Reserve(last - first);
+    for (size_t edge_id = first; edge_id < last; edge_id++)
+    {
+        SerializeEdge(edges[edge_id], *serializing_edge_list.add_edge());
+    }
 }
 
-transport_catalogue_serialize::RoutesInternalData Serializer::SerializeRoutesInternalData() const
+void Serializer::SerializeEdge(const graph::Edge<double> &edge, transport_catalogue_serialize::Edge &serializing_edge) const
 {
-    transport_catalogue_serialize::RoutesInternalData serializing_routes_internal_data;
-    const auto &routes_internal_data_ = router_.GetRoutesInternalData(); //std::vector<std::vector<std::optional<RouteInternalData>>>;
+    //an edge starts at the vertex of its stop, a walk ends at the vertex of the stop it goes to
+    if (edge.type == graph::EdgeType::WALK)
+    {
+        serializing_edge.set_is_walk(true);
+        serializing_edge.set_stop_to_id(vertex_to_stop_id_[edge.to]);
+    }
+    else
+    {
+        serializing_edge.set_bus_id(bus_name_to_id_.at(edge.bus_name));
+    }
+    serializing_edge.set_stop_id(vertex_to_stop_id_[edge.from]);
+    serializing_edge.set_span_count(edge.span_count);
+    serializing_edge.set_wait_time(edge.wait_time);
+    serializing_edge.set_time_in_road(edge.time_in_road);
+    serializing_edge.set_from_id(edge.from);
+    serializing_edge.set_to_id(edge.to);
+    serializing_edge.set_weight(edge.weight);
+}
 
-    for (const auto &route_internal_list_ : routes_internal_data_)
+void Serializer::SerializeIncidenceLists(size_t first, size_t last,
+                                         transport_catalogue_serialize::IncidenceLists &serializing_incidence_lists) const
+{
+    const auto &incidence_lists = router_.GetGraph().GetIncedenceLists();
+    serializing_incidence_lists.mutable_incidence_list()->Reserve(last - first);
+    for (size_t vertex_id = first; vertex_id < last; vertex_id++)
     {
-        transport_catalogue_serialize::RouteInternalDataList serializing_route_internal_data_list;
-        for (auto route_internal_data : route_internal_list_) // std::optional<RouteInternalData>
-        {
-            transport_catalogue_serialize::RouteInternalData current_route_data;
-            if (route_internal_data != std::nullopt)
-            {
-                current_route_data.set_is_exist(true);
-                current_route_data.set_weight(route_internal_data->weight);
-                if (route_internal_data->prev_edge != std::nullopt)
-                {
-                    transport_catalogue_serialize::EdgeId current_id;
-                    current_id.set_id(*route_internal_data->prev_edge);
-                    *current_route_data.mutable_prev_edge() = current_id;
-                }
-            }
-            else
-            {
-                current_route_data.set_is_exist(false);
-            }
-            const size_t current_list_pos = serializing_route_internal_data_list.route_internal_data_size();
-            serializing_route_internal_data_list.add_route_internal_data();
-            *serializing_route_internal_data_list.mutable_route_internal_data(current_list_pos) = current_route_data;
-        }
-        const size_t current_routes_pos = serializing_routes_internal_data.route_internal_data_list_size();
-        serializing_routes_internal_data.add_route_internal_data_list();
-        *serializing_routes_internal_data.mutable_route_internal_data_list(current_routes_pos) = serializing_route_internal_data_list;
+        const auto &incidence_list = incidence_lists[vertex_id];
+        serializing_incidence_lists.add_incidence_list()->mutable_edge_id()->Add(incidence_list.begin(), incidence_list.end());
     }
-    return std::move(serializing_routes_internal_data);
 }
 
-transport_catalogue_serialize::VertexInfoList Serializer::SerializeVertexList() const
+void Serializer::SerializeRoutesRow(size_t from, transport_catalogue_serialize::RouteInternalDataList &serializing_row) const
 {
-    const std::unordered_map<std::string, size_t> &stop_name_to_vertex_id_ = router_.GetStopsToId();
+    const auto &routes_storage = router_.GetRoutesStorage();
+    const size_t vertex_count = routes_storage.GetVertexCount();
+    const graph::Router<double>::RoutesRow row = routes_storage.GetRow(from);
+    serializing_row.mutable_weights()->Add(row.weights, row.weights + vertex_count);
+    auto &prev_edges = *serializing_row.mutable_prev_edges();
+    prev_edges.Reserve(vertex_count);
+    for (size_t to = 0; to < vertex_count; to++)
+    {
+        //NO_EDGE + 1 wraps to 0, the shortest varint
+        prev_edges.AddAlreadyReserved(row.prev_edges[to] + 1);
+    }
+}
 
-    transport_catalogue_serialize::VertexInfoList serializing_vertex_list;
-    for (const auto &[stop_name, vertex_id] : stop_name_to_vertex_id_)
+void Serializer::SerializeVertexList(transport_catalogue_serialize::VertexInfoList &serializing_vertex_list) const
+{
+    serializing_vertex_list.mutable_vertex_info()->Reserve(vertex_to_stop_id_.size());
+    for (size_t vertex_id = 0; vertex_id < vertex_to_stop_id_.size(); vertex_id++)
     {
-        transport_catalogue_serialize::VertexInfo curr_vertex_info;
-        curr_vertex_info.set_stop_id(stop_name_to_id_.at(stop_name));
+        transport_catalogue_serialize::VertexInfo &curr_vertex_info = *serializing_vertex_list.add_vertex_info();
+        curr_vertex_info.set_stop_id(vertex_to_stop_id_[vertex_id]);
         curr_vertex_info.set_vertex_id(vertex_id);
-        const size_t current_pos = serializing_vertex_list.vertex_info_size();
+    }
+}
 
-        serializing_vertex_list.add_vertex_info();
-        *serializing_vertex_list.mutable_vertex_info(current_pos) = curr_vertex_info;
+void Serializer::SerializeStops(transport_catalogue_serialize::StopList &result_list) const
+{
+    const size_t stops_count = catalogue_.GetAllStops().size();
+    result_list.mutable_stop()->Reserve(stops_count);
+    for (size_t i = 0; i < stops_count; i++)
+    {
+        const domain::StopPtr stop = catalogue_.GetStopById(i);
+        transport_catalogue_serialize::Stop &current_stop = *result_list.add_stop();
+        current_stop.set_name(stop->GetName());
+        current_stop.mutable_coordinate()->set_lat(stop->GetCoordinates().lat);
+        current_stop.mutable_coordinate()->set_lng(stop->GetCoordinates().lng);
+        current_stop.set_id(i);
     }
-    return std::move(serializing_vertex_list);
 }
 
-transport_catalogue_serialize::Router Serializer::SerializeRouter() const
+void Serializer::SerializeDistances(transport_catalogue_serialize::DistanceList &result_list) const
 {
-    transport_catalogue_serialize::Graph serializing_graph = SerializeGraph();
-    transport_catalogue_serialize::RoutesInternalData serializing_routes_internal_data = SerializeRoutesInternalData();
-    transport_catalogue_serialize::VertexInfoList serializing_vertex_list = SerializeVertexList();
+    catalogue_.ForEachDistance([&result_list](const domain::StopPtr from, const domain::StopPtr to, int distance)
+                               {
+                                   transport_catalogue_serialize::Distance &current_distance = *result_list.add_distance();
+                                   current_distance.set_stop_from_id(from->GetId());
+                                   current_distance.set_stop_to_id(to->GetId());
+                                   current_distance.set_value(distance);
+                               });
+}
 
-    transport_catalogue_serialize::Router serializing_router;
+void Serializer::SerializeStopsIndex(transport_catalogue_serialize::StopsIndex &result_index) const
+{
+    const spatial_index::GridData &grid = catalogue_.GetStopsIndex().GetData();
+    result_index.set_min_lat(grid.min_lat);
+    result_index.set_min_lng(grid.min_lng);
+    result_index.set_lat_step(grid.lat_step);
+    result_index.set_lng_step(grid.lng_step);
+    result_index.set_side(grid.side);
+    result_index.mutable_cell_offsets()->Add(grid.cell_offsets.begin(), grid.cell_offsets.end());
+    result_index.mutable_stop_ids()->Add(grid.stop_ids.begin(), grid.stop_ids.end());
+}
 
-    *serializing_router.mutable_graph() = serializing_graph;
-    *serializing_router.mutable_routes_internal_data() = serializing_routes_internal_data;
-    *serializing_router.mutable_vertex_info_list() = serializing_vertex_list;
-    return std::move(serializing_router);
+void Serializer::SerializeStopNamesIndex(transport_catalogue_serialize::StopNamesIndex &result_index) const
+{
+    const name_search::NamesIndexData &data = catalogue_.GetStopNamesIndex().GetData();
+    result_index.mutable_sorted_stop_ids()->Add(data.sorted_stop_ids.begin(), data.sorted_stop_ids.end());
+    result_index.mutable_trigrams()->Add(data.trigrams.begin(), data.trigrams.end());
+    result_index.mutable_trigram_offsets()->Add(data.trigram_offsets.begin(), data.trigram_offsets.end());
+    result_index.mutable_positions()->Add(data.positions.begin(), data.positions.end());
 }
 
-transport_catalogue_serialize::StopList Serializer::SerializeStops() 
+void Serializer::SerializeBuses(transport_catalogue_serialize::BusList &result_list) const
 {
-    transport_catalogue_serialize::StopList result_list;
-    for (size_t i = 0; i < stops_request_.size(); i++)
+    const std::deque<domain::Bus> &buses = catalogue_.GetAllBuses();
+    result_list.mutable_bus()->Reserve(buses.size());
+    for (size_t bus_id = 0; bus_id < buses.size(); bus_id++)
     {
-        transport_catalogue_serialize::Coordinate current_coord;
-        transport_catalogue_serialize::Stop current_stop;
-        const std::string &stop_name = stops_request_[i].at("name"s).AsString();
-        current_coord.set_lat(stops_request_[i].at("latitude"s).AsDouble());
-        current_coord.set_lng(stops_request_[i].at("longitude"s).AsDouble());
-        current_stop.set_name(stop_name);
-        *current_stop.mutable_coordinate() = current_coord;
-        current_stop.set_id(i);
-
-        result_list.add_stop();
-        *result_list.mutable_stop(i) = current_stop;
-        if (stops_request_[i].count("road_distances"s))
+        const domain::Bus &bus = buses[bus_id];
+        transport_catalogue_serialize::Bus &current_bus = *result_list.add_bus();
+        current_bus.set_name(bus.GetName());
+        current_bus.set_id(bus_id);
+        current_bus.set_is_roundtrip(bus.IsCircle());
+
+        //the way back of a linear bus is restored on loading
+        const std::vector<domain::StopPtr> &stops = bus.GetStops();
+        const size_t forward_stops = bus.IsCircle() ? stops.size() : (stops.size() + 1) / 2;
+        current_bus.mutable_stop_id()->Reserve(forward_stops);
+        for (size_t i = 0; i < forward_stops; i++)
         {
-            std::unordered_map<std::string, size_t> name_to_dist;
-            const json::Dict &road_distances = stops_request_[i].at("road_distances"s).AsDict();
-            for (const auto &[name, distance] : road_distances)
-            {
-                name_to_dist[name] = distance.AsInt();
-            }
-            stops_name_to_stop_to_distance_[stop_name] = name_to_dist;
+            current_bus.add_stop_id(stops[i]->GetId());
         }
-        stop_name_to_id_[stop_name] = i;
     }
-    return result_list;
 }
 
-transport_catalogue_serialize::DistanceList Serializer::SerializeDistances()
+void Serializer::SerializeColor(const svg::Color &color, transport_catalogue_serialize::Color &serialize_color) const
+{
+    if (const auto *rgb = std::get_if<svg::Rgb>(&color))
+    {
+        transport_catalogue_serialize::Rgb &serialize_rgb = *serialize_color.mutable_rgb();
+        serialize_rgb.set_red(rgb->red);
+        serialize_rgb.set_green(rgb->green);
+        serialize_rgb.set_blue(rgb->blue);
+    }
+    else if (const auto *rgba = std::get_if<svg::Rgba>(&color))
+    {
+        transport_catalogue_serialize::Rgba &serialize_rgba = *serialize_color.mutable_rgba();
+        serialize_rgba.set_red(rgba->red);
+        serialize_rgba.set_green(rgba->green);
+        serialize_rgba.set_blue(rgba->blue);
+        serialize_rgba.set_opacity(rgba->opacity);
+    }
+    else if (const auto *str = std::get_if<std::string>(&color))
+    {
+        serialize_color.set_str(*str);
+    }
+    else
+    {
+        throw std::logic_error("Failed to serialize empty color"s);
+    }
+}
+
+void Serializer::SerializeRenderSettings(const renderer::RendererSettings &render_settings,
+                                         transport_catalogue_serialize::RenderSettings &result_settings) const
+{
+    result_settings.set_width(render_settings.width);
+    result_settings.set_height(render_settings.height);
+    result_settings.set_padding(render_settings.padding);
+    result_settings.set_line_width(render_settings.line_width);
+    result_settings.set_stop_radius(render_settings.stop_radius);
+    result_settings.set_bus_label_font_size(render_settings.bus_label_font_size);
+    result_settings.set_bus_label_offset_dx(render_settings.bus_label_offset.x);
+    result_settings.set_bus_label_offset_dy(render_settings.bus_label_offset.y);
+    result_settings.set_stop_label_font_size(render_settings.stop_label_font_size);
+    result_settings.set_stop_label_offset_dx(render_settings.stop_label_offset.x);
+    result_settings.set_stop_label_offset_dy(render_settings.stop_label_offset.y);
+    result_settings.set_underlayer_width(render_settings.underlayer_width);
+
+    SerializeColor(render_settings.underlayer_color, *result_settings.mutable_underlayer_color());
+
+    transport_catalogue_serialize::ColorPalette &color_palette = *result_settings.mutable_color_palette();
+    for (const svg::Color &color : render_settings.color_palette)
+    {
+        SerializeColor(color, *color_palette.add_color());
+    }
+}
+
+void Serializer::SerializeTransportCatalogue(transport_catalogue_serialize::TransportCatalogue &serialize_catalogue) const
+{
+    SerializeStops(*serialize_catalogue.mutable_stops());
+    SerializeDistances(*serialize_catalogue.mutable_distances());
+    SerializeBuses(*serialize_catalogue.mutable_buses());
+    SerializeStopsIndex(*serialize_catalogue.mutable_stops_index());
+    SerializeStopNamesIndex(*serialize_catalogue.mutable_stop_names_index());
+}
+
+void Serializer::WriteChunk(google::protobuf::io::CodedOutputStream &output, const transport_catalogue_serialize::DatabaseChunk &chunk)
+{
+    //ByteSizeLong caches sizes of submessages for SerializeWithCachedSizes
+    const size_t size = chunk.ByteSizeLong();
+    if (size > static_cast<size_t>(std::numeric_limits<int>::max()))
+    {
+        throw std::logic_error("Database chunk is too big");
+    }
+    output.WriteVarint32(static_cast<uint32_t>(size));
+    chunk.SerializeWithCachedSizes(&output);
+    if (measure_memory_)
+    {
+        database_memory_usage_ = std::max(database_memory_usage_, chunk.SpaceUsedLong());
+    }
+}
+
+void Serializer::SerializeToOstream(std::ostream &output)
 {
+    google::protobuf::io::OstreamOutputStream raw_output(&output);
+    google::protobuf::io::CodedOutputStream coded_output(&raw_output);
+    coded_output.WriteRaw(STREAM_MAGIC, sizeof(STREAM_MAGIC));
+    database_memory_usage_ = 0;
+
+    //the chunk is reused: cleared messages keep their memory, so the next chunk of the same kind is built without allocations
+    google::protobuf::Arena arena;
+    auto &chunk = *google::protobuf::Arena::CreateMessage<transport_catalogue_serialize::DatabaseChunk>(&arena);
+    SerializeTransportCatalogue(*chunk.mutable_catalogue());
+    WriteChunk(coded_output, chunk);
+    SerializeRenderSettings(render_settings_, *chunk.mutable_render_settings());
+    WriteChunk(coded_output, chunk);
 
-    transport_catalogue_serialize::DistanceList result_list;
-    for (const auto &[stop_name_from, stop_to_dist] : stops_name_to_stop_to_distance_)
+    const auto &graph = router_.GetGraph();
+    const size_t vertex_count = graph.GetVertexCount();
+    const size_t edge_count = graph.GetEdgeCount();
+    transport_catalogue_serialize::RouterHeader &router_header = *chunk.mutable_router_header();
+    SerializeVertexList(*router_header.mutable_vertex_info_list());
+    router_header.set_walk_velocity(router_.GetWalkVelocity());
+    router_header.set_vertex_count(vertex_count);
+    router_header.set_edge_count(edge_count);
+    WriteChunk(coded_output, chunk);
+
+    for (size_t first = 0; first < edge_count; first += STREAM_CHUNK_ITEMS)
+    {
+        transport_catalogue_serialize::EdgeList &edges = *chunk.mutable_edges();
+        edges.Clear();
+        SerializeEdges(first, std::min(first + STREAM_CHUNK_ITEMS, edge_count), edges);
+        WriteChunk(coded_output, chunk);
+    }
+    for (size_t first = 0; first < vertex_count; first += STREAM_CHUNK_ITEMS)
     {
+        transport_catalogue_serialize::IncidenceLists &incidence_lists = *chunk.mutable_incidence_lists();
+        incidence_lists.Clear();
+        SerializeIncidenceLists(first, std::min(first + STREAM_CHUNK_ITEMS, vertex_count), incidence_lists);
+        WriteChunk(coded_output, chunk);
+    }
 
-        for (const auto &[stop_name_to, distance] : stop_to_dist)
+    //a cell takes up to 8 bytes of weight and 5 bytes of edge id
+    const size_t rows_per_block = std::max<size_t>(1, STREAM_CHUNK_BYTES / (vertex_count * 13 + 1));
+    auto &serializing_row = *google::protobuf::Arena::CreateMessage<transport_catalogue_serialize::RouteInternalDataList>(&arena);
+    for (size_t first = 0; first < vertex_count; first += rows_per_block)
+    {
+        //the chunk is reused, rows of the previous block must not stay in it
+        transport_catalogue_serialize::EncodedRoutesRows &block = *chunk.mutable_encoded_routes_rows();
+        block.Clear();
+        block.set_first_row(first);
+        //rows are encoded separately, so the reader can decode only the rows it needs
+        std::string &rows = *block.mutable_rows();
+        for (size_t from = first; from < std::min(first + rows_per_block, vertex_count); from++)
         {
-            transport_catalogue_serialize::Distance current_distance;
-            current_distance.set_stop_from_id(stop_name_to_id_.at(stop_name_from));
-            current_distance.set_stop_to_id(stop_name_to_id_.at(stop_name_to));
-            current_distance.set_value(distance);
-            const size_t current_pos = result_list.distance_size();
-
-            result_list.add_distance();
-            *result_list.mutable_distance(current_pos) = current_distance;
+            serializing_row.Clear();
+            SerializeRoutesRow(from, serializing_row);
+            serializing_row.AppendToString(&rows);
+            block.add_row_ends(rows.size());
         }
+        WriteChunk(coded_output, chunk);
+    }
+
+    coded_output.Trim();
+    if (coded_output.HadError())
+    {
+        throw std::runtime_error("Failed to write database");
     }
-    return result_list;
 }
 
-transport_catalogue_serialize::BusList Serializer::SerializeBuses()
+void Serializer::SerializeToFlatOstream(std::ostream &output, flat_snapshot::Compression compression)
 {
-    transport_catalogue_serialize::BusList result_list;
-    size_t current_id = 0;
-    for (const json::Dict &request : bus_requests_)
+    //records are made straight from the catalogue and the graph, the matrix rows are written from the router's storage
+    flat_snapshot::SnapshotData data;
+    auto add_string = [&data](const std::string &value)
     {
+        const uint32_t offset = data.strings.size();
+        data.strings += value;
+        return offset;
+    };
+
+    const size_t stops_count = catalogue_.GetAllStops().size();
+    data.stops.reserve(stops_count);
+    for (size_t i = 0; i < stops_count; i++)
+    {
+        const domain::StopPtr stop = catalogue_.GetStopById(i);
+        data.stops.push_back({stop->GetCoordinates().lat, stop->GetCoordinates().lng, add_string(stop->GetName()),
+                              static_cast<uint32_t>(stop->GetName().size())});
+    }
 
-        transport_catalogue_serialize::Bus current_bus;
-        const std::string bus_name = request.at("name"s).AsString();
-        current_bus.set_name(bus_name);
-        current_bus.set_id(current_id);
-        current_bus.set_is_roundtrip(request.at("is_roundtrip"s).AsBool());
-
-        for (const auto &stop : request.at("stops"s).AsArray())
+    const std::deque<domain::Bus> &buses = catalogue_.GetAllBuses();
+    data.buses.reserve(buses.size());
+    for (const domain::Bus &bus : buses)
+    {
+        //the way back of a linear bus is restored on loading
+        const std::vector<domain::StopPtr> &stops = bus.GetStops();
+        const size_t forward_stops = bus.IsCircle() ? stops.size() : (stops.size() + 1) / 2;
+        data.buses.push_back({add_string(bus.GetName()), static_cast<uint32_t>(bus.GetName().size()),
+                              static_cast<uint32_t>(data.bus_stops.size()), static_cast<uint32_t>(forward_stops),
+                              bus.IsCircle(), 0});
+        for (size_t i = 0; i < forward_stops; i++)
         {
-            current_bus.add_stop_id(stop_name_to_id_.at(stop.AsString()));
+            data.bus_stops.push_back(stops[i]->GetId());
         }
-        const size_t current_pos = result_list.bus_size();
+    }
 
-        result_list.add_bus();
-        *result_list.mutable_bus(current_pos) = current_bus;
+    catalogue_.ForEachDistance([&data](const domain::StopPtr from, const domain::StopPtr to, int distance)
+                               { data.distances.push_back({static_cast<uint32_t>(from->GetId()), static_cast<uint32_t>(to->GetId()), distance}); });
+    data.grid = catalogue_.GetStopsIndex().GetData();
+    data.names_index = catalogue_.GetStopNamesIndex().GetData();
+
+    google::protobuf::Arena arena;
+    auto &render_settings = *google::protobuf::Arena::CreateMessage<transport_catalogue_serialize::RenderSettings>(&arena);
+    SerializeRenderSettings(render_settings_, render_settings);
+    data.render_settings = render_settings.SerializeAsString();
+    //the render settings are the only protobuf message of the flat format
+    if (measure_memory_)
+    {
+        database_memory_usage_ = render_settings.SpaceUsedLong();
+    }
 
-        bus_name_to_id_[std::move(bus_name)] = current_id;
-        current_id++;
+    const auto &graph = router_.GetGraph();
+    const size_t vertex_count = graph.GetVertexCount();
+    data.router_settings = {router_.GetWalkVelocity(), vertex_count};
+    data.vertices = vertex_to_stop_id_;
+    data.edges.reserve(graph.GetEdgeCount());
+    for (const graph::Edge<double> &edge : graph.GetEdges())
+    {
+        //an edge starts at the vertex of its stop, a walk ends at the vertex of the stop it goes to
+        const bool is_walk = edge.type == graph::EdgeType::WALK;
+        data.edges.push_back({edge.time_in_road, edge.weight, is_walk,
+                              is_walk ? flat_snapshot::NO_ID : static_cast<uint32_t>(bus_name_to_id_.at(edge.bus_name)),
+                              vertex_to_stop_id_[edge.from], is_walk ? vertex_to_stop_id_[edge.to] : flat_snapshot::NO_ID,
+                              edge.span_count, edge.wait_time, static_cast<uint32_t>(edge.from), static_cast<uint32_t>(edge.to)});
+    }
+    const auto &incidence_lists = graph.GetIncedenceLists();
+    data.incidence_offsets.reserve(vertex_count + 1);
+    data.incidence_offsets.push_back(0);
+    for (const auto &incidence_list : incidence_lists)
+    {
+        data.incidence_edges.insert(data.incidence_edges.end(), incidence_list.begin(), incidence_list.end());
+        data.incidence_offsets.push_back(data.incidence_edges.size());
     }
+    data.routes = &router_.GetRoutesStorage();
 
-    return result_list;
+    flat_snapshot::Write(std::move(data), output, compression);
 }
 
-transport_catalogue_serialize::Color Serializer::SerializeColor(const json::Node &node) const
+void Serializer::CheckDeltaOrder(const TransportCatalogue &base_catalogue) const
 {
-    if (node.IsArray())
+    const size_t base_stops_count = base_catalogue.GetAllStops().size();
+    if (catalogue_.GetAllStops().size() < base_stops_count)
+    {
+        throw std::logic_error("A delta can't remove stops");
+    }
+    for (size_t stop_id = 0; stop_id < base_stops_count; stop_id++)
     {
-        auto color = node.AsArray();
-        if (color.size() == 3)
+        if (catalogue_.GetStopById(stop_id)->GetName() != base_catalogue.GetStopById(stop_id)->GetName())
         {
-            transport_catalogue_serialize::Rgb serialize_rgb;
-            serialize_rgb.set_red(color[0].AsInt());
-            serialize_rgb.set_green(color[1].AsInt());
-            serialize_rgb.set_blue(color[2].AsInt());
-            transport_catalogue_serialize::Color serialize_color;
-            *serialize_color.mutable_rgb() = serialize_rgb;
-            return std::move(serialize_color);
+            throw std::logic_error("Stops of the base must keep their ids in a delta");
         }
-        else if (color.size() == 4)
+    }
+
+    //buses left from the base go first in their order
+    const std::deque<domain::Bus> &buses = catalogue_.GetAllBuses();
+    size_t bus_id = 0;
+    for (const domain::Bus &base_bus : base_catalogue.GetAllBuses())
+    {
+        if (bus_id < buses.size() && buses[bus_id].GetName() == base_bus.GetName())
         {
-            transport_catalogue_serialize::Rgba serialize_rgba;
-            serialize_rgba.set_red(color[0].AsInt());
-            serialize_rgba.set_green(color[1].AsInt());
-            serialize_rgba.set_blue(color[2].AsInt());
-            serialize_rgba.set_opacity(color[3].AsDouble());
-            transport_catalogue_serialize::Color serialize_color;
-            *serialize_color.mutable_rgba() = serialize_rgba;
-            return std::move(serialize_color);
+            bus_id++;
         }
     }
-    else if (node.IsString())
+    for (; bus_id < buses.size(); bus_id++)
     {
-        transport_catalogue_serialize::Color serialize_color;
-        serialize_color.set_str(node.AsString());
-        return std::move(serialize_color);
+        if (base_catalogue.GetBus(buses[bus_id].GetName()))
+        {
+            throw std::logic_error("Buses of the base must keep their order in a delta");
+        }
     }
-    throw std::runtime_error("Failed to get color from JSON"s);
 }
 
-transport_catalogue_serialize::ColorPalette Serializer::SerializeColorPalette()
+void Serializer::SerializeCatalogueDelta(const TransportCatalogue &base_catalogue,
+                                         transport_catalogue_serialize::CatalogueDelta &delta) const
 {
-    const auto &color_array = render_settings_.at("color_palette"s).AsArray();
-    transport_catalogue_serialize::ColorPalette color_palette;
-    size_t current_id = 0;
-    for (const json::Node &color : color_array)
+    const CatalogueData base = base_catalogue.GetData();
+    const CatalogueData data = catalogue_.GetData();
+
+    for (size_t stop_id = 0; stop_id < data.stops.size(); stop_id++)
+    {
+        const geo::Coordinates &coordinates = data.stops[stop_id].coordinates;
+        if (stop_id < base.stops.size() && coordinates.lat == base.stops[stop_id].coordinates.lat &&
+            coordinates.lng == base.stops[stop_id].coordinates.lng)
+        {
+            continue;
+        }
+        transport_catalogue_serialize::Stop &stop = *delta.mutable_stops()->add_stop();
+        stop.set_name(data.stops[stop_id].name);
+        stop.mutable_coordinate()->set_lat(coordinates.lat);
+        stop.mutable_coordinate()->set_lng(coordinates.lng);
+        stop.set_id(stop_id);
+    }
+    if (delta.stops().stop_size() > 0)
+    {
+        SerializeStopsIndex(*delta.mutable_stops_index());
+        SerializeStopNamesIndex(*delta.mutable_stop_names_index());
+    }
+
+    std::unordered_map<std::string_view, const CatalogueData::BusData *> base_buses;
+    for (const CatalogueData::BusData &bus : base.buses)
+    {
+        base_buses[bus.name] = &bus;
+    }
+    for (size_t bus_id = 0; bus_id < data.buses.size(); bus_id++)
+    {
+        const CatalogueData::BusData &bus_data = data.buses[bus_id];
+        const auto iter = base_buses.find(bus_data.name);
+        if (iter != base_buses.end())
+        {
+            const bool is_same = iter->second->is_circle == bus_data.is_circle && iter->second->stop_ids == bus_data.stop_ids;
+            base_buses.erase(iter);
+            if (is_same)
+            {
+                continue;
+            }
+        }
+        transport_catalogue_serialize::Bus &bus = *delta.mutable_buses()->add_bus();
+        bus.set_name(bus_data.name);
+        bus.set_id(bus_id);
+        bus.set_is_roundtrip(bus_data.is_circle);
+        bus.mutable_stop_id()->Add(bus_data.stop_ids.begin(), bus_data.stop_ids.end());
+    }
+    //buses of the base that are left are removed, they go in the order of the base
+    for (const CatalogueData::BusData &bus : base.buses)
     {
-        color_palette.add_color();
-        *color_palette.mutable_color(current_id) = SerializeColor(color);
-        current_id++;
+        if (base_buses.count(bus.name) > 0)
+        {
+            delta.add_removed_buses(bus.name);
+        }
+    }
+
+    auto get_key = [](const CatalogueData::DistanceData &distance)
+    {
+        return static_cast<uint64_t>(distance.from_stop_id) << 32 | distance.to_stop_id;
+    };
+    auto add_distance = [](const CatalogueData::DistanceData &distance, transport_catalogue_serialize::DistanceList &list)
+    {
+        transport_catalogue_serialize::Distance &result = *list.add_distance();
+        result.set_stop_from_id(distance.from_stop_id);
+        result.set_stop_to_id(distance.to_stop_id);
+        result.set_value(distance.distance);
+    };
+    std::unordered_map<uint64_t, int> base_distances;
+    base_distances.reserve(base.distances.size());
+    for (const CatalogueData::DistanceData &distance : base.distances)
+    {
+        base_distances[get_key(distance)] = distance.distance;
+    }
+    for (const CatalogueData::DistanceData &distance : data.distances)
+    {
+        const auto iter = base_distances.find(get_key(distance));
+        if (iter == base_distances.end() || iter->second != distance.distance)
+        {
+            add_distance(distance, *delta.mutable_distances());
+        }
+        if (iter != base_distances.end())
+        {
+            base_distances.erase(iter);
+        }
+    }
+    for (const CatalogueData::DistanceData &distance : base.distances)
+    {
+        if (base_distances.count(get_key(distance)) > 0)
+        {
+            add_distance(distance, *delta.mutable_removed_distances());
+        }
     }
-    return std::move(color_palette);
 }
 
-transport_catalogue_serialize::RenderSettings Serializer::SerializeRenderSettings()
+void Serializer::SerializeDeltaToOstream(std::ostream &output, const TransportCatalogue &base_catalogue,
+                                         const renderer::RendererSettings &base_render_settings,
+                                         const transport_router::TransportRouter &base_router)
 {
-    transport_catalogue_serialize::RenderSettings result_settings;
-
-    result_settings.set_width(render_settings_.at("width"s).AsDouble());
-    result_settings.set_height(render_settings_.at("height"s).AsDouble());
-    result_settings.set_padding(render_settings_.at("padding"s).AsDouble());
-    result_settings.set_line_width(render_settings_.at("line_width"s).AsDouble());
-    result_settings.set_stop_radius(render_settings_.at("stop_radius"s).AsDouble());
-    result_settings.set_bus_label_font_size(render_settings_.at("bus_label_font_size"s).AsInt());
+    CheckDeltaOrder(base_catalogue);
 
-    const auto bus_label_offset_arr = render_settings_.at("bus_label_offset"s).AsArray();
-    result_settings.set_bus_label_offset_dx(bus_label_offset_arr[0].AsDouble());
-    result_settings.set_bus_label_offset_dy(bus_label_offset_arr[1].AsDouble());
-    result_settings.set_stop_label_font_size(render_settings_.at("stop_label_font_size"s).AsInt());
+    google::protobuf::io::OstreamOutputStream raw_output(&output);
+    google::protobuf::io::CodedOutputStream coded_output(&raw_output);
+    coded_output.WriteRaw(DELTA_MAGIC, sizeof(DELTA_MAGIC));
+    database_memory_usage_ = 0;
 
-    const auto stop_label_offset_arr = render_settings_.at("stop_label_offset"s).AsArray();
-    result_settings.set_stop_label_offset_dx(stop_label_offset_arr[0].AsDouble());
-    result_settings.set_stop_label_offset_dy(stop_label_offset_arr[1].AsDouble());
-    result_settings.set_underlayer_width(render_settings_.at("underlayer_width"s).AsDouble());
+    const auto &graph = router_.GetGraph();
+    const auto &base_graph = base_router.GetGraph();
+    const size_t vertex_count = graph.GetVertexCount();
+    const size_t edge_count = graph.GetEdgeCount();
 
-    *result_settings.mutable_underlayer_color() = SerializeColor(render_settings_.at("underlayer_color"s));
+    //stop ids of the base are the same, so vertices are compared by them
+    std::vector<uint32_t> base_vertex_to_stop_id(base_graph.GetVertexCount());
+    for (const auto &[stop_name, vertex_id] : base_router.GetStopsToId())
+    {
+        base_vertex_to_stop_id[vertex_id] = base_catalogue.GetStop(stop_name)->GetId();
+    }
+    const bool are_vertices_changed = base_vertex_to_stop_id != vertex_to_stop_id_;
+
+    google::protobuf::Arena arena;
+    auto &chunk = *google::protobuf::Arena::CreateMessage<transport_catalogue_serialize::DatabaseChunk>(&arena);
+    transport_catalogue_serialize::DeltaHeader &header = *chunk.mutable_delta_header();
+    header.set_base_stop_count(base_catalogue.GetAllStops().size());
+    header.set_base_bus_count(base_catalogue.GetAllBuses().size());
+    header.set_base_vertex_count(base_graph.GetVertexCount());
+    header.set_base_edge_count(base_graph.GetEdgeCount());
+    header.set_vertex_count(vertex_count);
+    header.set_edge_count(edge_count);
+    header.set_walk_velocity(router_.GetWalkVelocity());
+    if (are_vertices_changed)
+    {
+        SerializeVertexList(*header.mutable_vertex_info_list());
+    }
+    WriteChunk(coded_output, chunk);
 
-    *result_settings.mutable_color_palette() = SerializeColorPalette();
+    SerializeCatalogueDelta(base_catalogue, *chunk.mutable_catalogue_delta());
+    WriteChunk(coded_output, chunk);
 
-    return result_settings;
-}
+    transport_catalogue_serialize::RenderSettings &render_settings = *chunk.mutable_render_settings();
+    SerializeRenderSettings(render_settings_, render_settings);
+    transport_catalogue_serialize::RenderSettings base_settings;
+    SerializeRenderSettings(base_render_settings, base_settings);
+    if (render_settings.SerializeAsString() != base_settings.SerializeAsString())
+    {
+        WriteChunk(coded_output, chunk);
+    }
 
-transport_catalogue_serialize::TransportCatalogue Serializer::SerializeTransportCatalogue()
-{
-    transport_catalogue_serialize::StopList stop_list = SerializeStops();
-    transport_catalogue_serialize::DistanceList distance_list = SerializeDistances();
-    transport_catalogue_serialize::BusList bus_list = SerializeBuses();
+    const std::vector<graph::Edge<double>> &edges = graph.GetEdges();
+    const std::vector<graph::Edge<double>> &base_edges = base_graph.GetEdges();
+    for (size_t edge_id = 0; edge_id < edge_count;)
+    {
+        transport_catalogue_serialize::EdgesDelta &edges_delta = *chunk.mutable_edges_delta();
+        edges_delta.Clear();
+        for (; edge_id < edge_count && static_cast<size_t>(edges_delta.edge_ids_size()) < STREAM_CHUNK_ITEMS; edge_id++)
+        {
+            if (edge_id < base_edges.size() && IsSameEdge(edges[edge_id], base_edges[edge_id]))
+            {
+                continue;
+            }
+            edges_delta.add_edge_ids(edge_id);
+            SerializeEdge(edges[edge_id], *edges_delta.mutable_edges()->add_edge());
+        }
+        if (edges_delta.edge_ids_size() > 0)
+        {
+            WriteChunk(coded_output, chunk);
+        }
+    }
 
-    transport_catalogue_serialize::TransportCatalogue serialize_catalogue;
+    const auto &incidence_lists = graph.GetIncedenceLists();
+    const auto &base_incidence_lists = base_graph.GetIncedenceLists();
+    for (size_t vertex_id = 0; vertex_id < vertex_count;)
+    {
+        transport_catalogue_serialize::IncidenceListsDelta &lists_delta = *chunk.mutable_incidence_lists_delta();
+        lists_delta.Clear();
+        for (; vertex_id < vertex_count && static_cast<size_t>(lists_delta.vertex_ids_size()) < STREAM_CHUNK_ITEMS; vertex_id++)
+        {
+            const auto &incidence_list = incidence_lists[vertex_id];
+            if (vertex_id < base_incidence_lists.size() && incidence_list == base_incidence_lists[vertex_id])
+            {
+                continue;
+            }
+            lists_delta.add_vertex_ids(vertex_id);
+            lists_delta.mutable_incidence_lists()->add_incidence_list()->mutable_edge_id()->Add(incidence_list.begin(),
+                                                                                                 incidence_list.end());
+        }
+        if (lists_delta.vertex_ids_size() > 0)
+        {
+            WriteChunk(coded_output, chunk);
+        }
+    }
 
-    *serialize_catalogue.mutable_stops() = stop_list;
-    *serialize_catalogue.mutable_distances() = distance_list;
-    *serialize_catalogue.mutable_buses() = bus_list;
+    const auto &routes_storage = router_.GetRoutesStorage();
+    const auto &base_routes_storage = base_router.GetRoutesStorage();
+    //a cell takes up to 8 bytes of weight and 5 bytes of edge id
+    const size_t rows_per_block = std::max<size_t>(1, STREAM_CHUNK_BYTES / (vertex_count * 13 + 1));
+    auto &serializing_row = *google::protobuf::Arena::CreateMessage<transport_catalogue_serialize::RouteInternalDataList>(&arena);
+    for (size_t from = 0; from < vertex_count;)
+    {
+        transport_catalogue_serialize::RoutesRowsDelta &rows_delta = *chunk.mutable_routes_rows_delta();
+        rows_delta.Clear();
+        std::string &rows = *rows_delta.mutable_rows();
+        for (; from < vertex_count && static_cast<size_t>(rows_delta.row_ids_size()) < rows_per_block; from++)
+        {
+            if (!are_vertices_changed)
+            {
+                const graph::Router<double>::RoutesRow row = routes_storage.GetRow(from);
+                const graph::Router<double>::RoutesRow base_row = base_routes_storage.GetRow(from);
+                if (std::equal(row.weights, row.weights + vertex_count, base_row.weights) &&
+                    std::equal(row.prev_edges, row.prev_edges + vertex_count, base_row.prev_edges))
+                {
+                    continue;
+                }
+            }
+            serializing_row.Clear();
+            SerializeRoutesRow(from, serializing_row);
+            serializing_row.AppendToString(&rows);
+            rows_delta.add_row_ids(from);
+            rows_delta.add_row_ends(rows.size());
+        }
+        if (rows_delta.row_ids_size() > 0)
+        {
+            WriteChunk(coded_output, chunk);
+        }
+    }
 
-    return std::move(serialize_catalogue);
+    coded_output.Trim();
+    if (coded_output.HadError())
+    {
+        throw std::runtime_error("Failed to write database");
+    }
 }
 
-transport_catalogue_serialize::TransportDatabase Serializer::SerializeTransportDatabase()
-{    
-    transport_catalogue_serialize::TransportCatalogue serialize_catalogue = SerializeTransportCatalogue();
-    transport_catalogue_serialize::RenderSettings render_settings = SerializeRenderSettings();
-    transport_catalogue_serialize::Router serializing_router = SerializeRouter();
-    transport_catalogue_serialize::TransportDatabase serialize_database;
-
-    *serialize_database.mutable_catalogue() = serialize_catalogue;
-    *serialize_database.mutable_render_settings() = render_settings;
-    *serialize_database.mutable_router() = serializing_router;
+//////////////////////////////////////////////////////////////////////////////////////////////
 
-    return std::move(serialize_database);
+LazyRoutesStorage::LazyRoutesStorage(size_t vertex_count)
+    : rows_(vertex_count)
+{
 }
 
-void Serializer::SerializeToOstream(std::ostream &output)
+void LazyRoutesStorage::AddRows(transport_catalogue_serialize::EncodedRoutesRows rows)
 {
-    transport_catalogue_serialize::TransportDatabase serialize_database = SerializeTransportDatabase();
-
-    serialize_database.SerializeToOstream(&output);
+    const size_t first_row = rows.first_row();
+    if (first_row > rows_.size() || static_cast<size_t>(rows.row_ends_size()) > rows_.size() - first_row)
+    {
+        throw std::runtime_error("Broken routes internal data");
+    }
+    uint32_t begin = 0;
+    for (int i = 0; i < rows.row_ends_size(); i++)
+    {
+        Row &row = rows_[first_row + i];
+        const uint32_t end = rows.row_ends(i);
+        if (row.end != 0 || end <= begin || end > rows.rows().size())
+        {
+            throw std::runtime_error("Broken routes internal data");
+        }
+        row.block = blocks_.size();
+        row.begin = begin;
+        row.end = end;
+        begin = end;
+    }
+    added_rows_ += rows.row_ends_size();
+    encoded_bytes_ += rows.rows().size();
+    blocks_.push_back(std::move(rows));
 }
 
-//////////////////////////////////////////////////////////////////////////////////////////////
-
-Deserializer::Deserializer(TransportCatalogue &catalogue, renderer::MapRenderer &renderer,
-                           std::optional<transport_router::TransportRouter> &router)
-    : catalogue_(catalogue), renderer_(renderer), router_(router)
+graph::Router<double>::RoutesRow LazyRoutesStorage::GetRow(graph::VertexId from) const
 {
+    Row &row = rows_[from];
+    std::call_once(row.decoded, [this, &row]
+                   {
+                       const std::string &encoded = blocks_[row.block].rows();
+                       transport_catalogue_serialize::RouteInternalDataList decoded_row;
+                       if (!decoded_row.ParseFromArray(encoded.data() + row.begin, static_cast<int>(row.end - row.begin)))
+                       {
+                           throw std::runtime_error("Broken routes internal data");
+                       }
+                       auto weights = std::make_unique<double[]>(rows_.size());
+                       auto prev_edges = std::make_unique<uint32_t[]>(rows_.size());
+                       DecodeRoutesRow(decoded_row, rows_.size(), weights.get(), prev_edges.get());
+                       row.weights = std::move(weights);
+                       row.prev_edges = std::move(prev_edges);
+                       ++decoded_rows_;
+                   });
+    //rows live as long as the storage
+    return {row.weights.get(), row.prev_edges.get(), nullptr};
 }
 
-void Deserializer::DeserializeStops(transport_catalogue_serialize::StopList stop_list)
+size_t LazyRoutesStorage::GetMemoryUsage() const
 {
-    for (size_t i = 0; i < stop_list.stop_size(); i++)
-    {
-        catalogue_.AddStop(stop_list.stop(i).name(), {stop_list.stop(i).coordinate().lat(), stop_list.stop(i).coordinate().lng()});
-        id_to_stop_name_[stop_list.stop(i).id()] = stop_list.stop(i).name();
-    }
+    return encoded_bytes_ + memory_usage::OfVector(rows_) + memory_usage::OfDeque(blocks_) +
+           decoded_rows_ * rows_.size() * (sizeof(double) + sizeof(uint32_t));
 }
 
-void Deserializer::DeserializeDistances(transport_catalogue_serialize::DistanceList distance_list)
+DeltaRoutesStorage::DeltaRoutesStorage(size_t vertex_count, std::shared_ptr<const graph::Router<double>::RoutesStorage> base)
+    : base_(std::move(base)), row_slots_(vertex_count, NO_SLOT)
 {
-    size_t distance_size = distance_list.distance_size();
-    for (size_t i = 0; i < distance_size; i++)
+    if (base_ && base_->GetVertexCount() != vertex_count)
     {
-        const std::string stop_from_name = id_to_stop_name_.at(distance_list.distance(i).stop_from_id());
-        const std::string stop_to_name = id_to_stop_name_.at(distance_list.distance(i).stop_to_id());
-        const size_t distance = distance_list.distance(i).value();
-        catalogue_.AddStopsDistance(stop_from_name, stop_to_name, distance);
+        throw std::runtime_error("Routes internal data of the delta doesn't match the database");
     }
 }
 
-void Deserializer::DeserializeBuses(transport_catalogue_serialize::BusList bus_list)
+void DeltaRoutesStorage::AddRows(const transport_catalogue_serialize::RoutesRowsDelta &rows)
 {
-    for (size_t i = 0; i < bus_list.bus_size(); i++)
+    if (rows.row_ids_size() != rows.row_ends_size())
+    {
+        throw std::runtime_error("Broken routes internal data");
+    }
+    const size_t vertex_count = row_slots_.size();
+    transport_catalogue_serialize::RouteInternalDataList decoded_row;
+    uint32_t begin = 0;
+    for (int i = 0; i < rows.row_ids_size(); i++)
     {
-        bool is_roadtrip = bus_list.bus(i).is_roundtrip();
-        const std::string bus_name = bus_list.bus(i).name();
-        std::vector<std::string> stop_names;
-        size_t stops_size = bus_list.bus(i).stop_id_size();
-        for (size_t j = 0; j < stops_size; j++)
+        const uint32_t row_id = rows.row_ids(i);
+        const uint32_t end = rows.row_ends(i);
+        if (row_id >= vertex_count || row_slots_[row_id] != NO_SLOT || end <= begin || end > rows.rows().size() ||
+            !decoded_row.ParseFromArray(rows.rows().data() + begin, static_cast<int>(end - begin)))
         {
-            const size_t stop_id = bus_list.bus(i).stop_id(j);
-            const std::string stop_name = id_to_stop_name_.at(stop_id);
-            stop_names.push_back(std::move(stop_name));
+            throw std::runtime_error("Broken routes internal data");
         }
-        id_to_bus_name_[bus_list.bus(i).id()] = bus_list.bus(i).name();
-        catalogue_.AddBus(std::move(bus_name), std::move(stop_names), is_roadtrip);
+        const size_t slot = added_rows_++;
+        weights_.resize(added_rows_ * vertex_count);
+        prev_edges_.resize(added_rows_ * vertex_count);
+        DecodeRoutesRow(decoded_row, vertex_count, weights_.data() + slot * vertex_count, prev_edges_.data() + slot * vertex_count);
+        row_slots_[row_id] = static_cast<uint32_t>(slot);
+        begin = end;
     }
 }
 
-std::vector<graph::Edge<double>> Deserializer::DeserializeEdgeList(transport_catalogue_serialize::EdgeList deserialized_edge_list) const
+graph::Router<double>::RoutesRow DeltaRoutesStorage::GetRow(graph::VertexId from) const
 {
-    std::vector<graph::Edge<double>> edge_list;
-    const size_t edge_list_size = deserialized_edge_list.edge_size();
-    for (size_t i = 0; i < edge_list_size; i++)
+    const uint32_t slot = row_slots_[from];
+    if (slot == NO_SLOT)
     {
-        graph::Edge<double> current_edge;
-        current_edge.bus_name = id_to_bus_name_.at(deserialized_edge_list.edge(i).bus_id());
-        current_edge.stop_name = id_to_stop_name_.at(deserialized_edge_list.edge(i).stop_id());
-        current_edge.span_count = deserialized_edge_list.edge(i).span_count();
-        current_edge.wait_time = deserialized_edge_list.edge(i).wait_time();
-        current_edge.time_in_road = deserialized_edge_list.edge(i).time_in_road();
-        current_edge.from = deserialized_edge_list.edge(i).from_id();
-        current_edge.to = deserialized_edge_list.edge(i).to_id();
-        current_edge.weight = deserialized_edge_list.edge(i).weight();
-        edge_list.push_back(std::move(current_edge));
+        return base_->GetRow(from);
     }
-    return std::move(edge_list);
+    const size_t offset = static_cast<size_t>(slot) * row_slots_.size();
+    return {weights_.data() + offset, prev_edges_.data() + offset, nullptr};
 }
 
-std::vector<std::vector<size_t>> Deserializer::DeserializeIncidenceLists(transport_catalogue_serialize::IncidenceLists deserialized_incidence_lists) const
+size_t DeltaRoutesStorage::GetMemoryUsage() const
 {
-    std::vector<std::vector<size_t>> incidence_lists;
-    incidence_lists.reserve(deserialized_incidence_lists.incidence_list_size());
+    return memory_usage::OfVector(row_slots_) + memory_usage::OfVector(weights_) + memory_usage::OfVector(prev_edges_) +
+           (base_ ? base_->GetMemoryUsage() : 0);
+}
 
-    for (size_t i = 0; i < deserialized_incidence_lists.incidence_list_size(); i++)
+namespace
+{
+//skips the magic, otherwise restores the position of the stream
+bool SkipMagic(std::istream &input, const char (&expected_magic)[8])
+{
+    const auto position = input.tellg();
+    char magic[sizeof(expected_magic)];
+    input.read(magic, sizeof(magic));
+    if (input.gcount() == sizeof(magic) && std::equal(magic, magic + sizeof(magic), expected_magic))
     {
-        std::vector<size_t> incidence_list;
-        incidence_list.reserve(deserialized_incidence_lists.incidence_list(i).edge_id_size());
-
-        for (size_t j = 0; j < deserialized_incidence_lists.incidence_list(i).edge_id_size(); j++)
-        {
-            const size_t current_edge_id = deserialized_incidence_lists.incidence_list(i).edge_id(j);
-            incidence_list.push_back(current_edge_id);
-        }
-        incidence_lists.push_back(std::move(incidence_list));
+        return true;
     }
-    return std::move(incidence_lists);
+    input.clear();
+    input.seekg(position);
+    return false;
 }
+} // namespace
 
-graph::DirectedWeightedGraph<double> Deserializer::DeserializeGraph(transport_catalogue_serialize::Graph graph_settings) const
+bool IsDatabaseStream(std::istream &input)
 {
-    std::vector<graph::Edge<double>> edge_list = DeserializeEdgeList(graph_settings.edge_list());
-
-    std::vector<std::vector<size_t>> incidence_lists = DeserializeIncidenceLists(graph_settings.incidence_lists());
-
-    graph::DirectedWeightedGraph<double> result_graph;
-
-    result_graph.SetIncidenceLists(std::move(incidence_lists));
-    result_graph.SetEdges(std::move(edge_list));
+    return SkipMagic(input, STREAM_MAGIC);
+}
 
-    return std::move(result_graph);
+Deserializer::Deserializer(TransportCatalogue &catalogue, renderer::MapRenderer &renderer,
+                           std::optional<transport_router::TransportRouter> &router)
+    : catalogue_(catalogue), renderer_(renderer), router_(router)
+{
 }
 
-//std::vector<std::vector<std::optional<graph::Router<double>::RouteInternalData>>>
-graph::Router<double>::RoutesInternalData Deserializer::DeserializeRoutesInternalData(transport_catalogue_serialize::RoutesInternalData
-                                                                                          deserialized_routes_internal_data) const
+void Deserializer::DeserializeStops(const transport_catalogue_serialize::StopList &stop_list, CatalogueData &data)
 {
-    graph::Router<double>::RoutesInternalData routes_internal_data;
-    for (size_t i = 0; i < deserialized_routes_internal_data.route_internal_data_list_size(); i++)
+    const size_t stops_size = stop_list.stop_size();
+    data.stops.reserve(stops_size);
+    stops_coordinates_.reserve(stops_size);
+    id_to_stop_name_.reserve(stops_size);
+    stop_id_to_position_.reserve(stops_size);
+    for (size_t i = 0; i < stops_size; i++)
     {
-        std::vector<std::optional<graph::Router<double>::RouteInternalData>> route_internal_data_list;
-        transport_catalogue_serialize::RouteInternalDataList deser_data_list = deserialized_routes_internal_data.route_internal_data_list(i);
-        for (int j = 0; j < deser_data_list.route_internal_data_size(); j++)
-        {
-            transport_catalogue_serialize::RouteInternalData deser_current_data = deser_data_list.route_internal_data(j);
-            std::optional<graph::Router<double>::RouteInternalData> curr_data;
-            if (deser_current_data.is_exist())
-            {
-                std::optional<size_t> prev_edge;
-                if (deser_current_data.has_prev_edge())
-                {
-                    prev_edge = deser_current_data.prev_edge().id();
-                }
-                else
-                {
-                    prev_edge = std::nullopt;
-                }
-                double weight = deser_current_data.weight();
-                curr_data = {weight, prev_edge};
-            }
-            else
-            {
-                curr_data == std::nullopt;
-            }
-            route_internal_data_list.push_back(curr_data);
-        }
-        routes_internal_data.push_back(std::move(route_internal_data_list));
+        const auto &stop = stop_list.stop(i);
+        const geo::Coordinates coordinates{stop.coordinate().lat(), stop.coordinate().lng()};
+        data.stops.push_back({stop.name(), coordinates});
+        id_to_stop_name_[stop.id()] = stop.name();
+        stop_id_to_position_[stop.id()] = static_cast<uint32_t>(i);
+        stops_coordinates_.push_back(coordinates);
     }
-    return std::move(routes_internal_data);
 }
 
-void Deserializer::DeserializeTransportRouter(transport_catalogue_serialize::Router router_settings,
-                                              std::optional<transport_router::TransportRouter> &router)
+uint32_t Deserializer::GetStopPosition(size_t stop_id) const
 {
-    graph::DirectedWeightedGraph<double> result_graph = DeserializeGraph(router_settings.graph());
-
-    graph::Router<double>::RoutesInternalData routes_internal_data = DeserializeRoutesInternalData(router_settings.routes_internal_data());
-
-    transport_catalogue_serialize::VertexInfoList deserialized_vertex_list = router_settings.vertex_info_list();
-    std::unordered_map<std::string, size_t> stop_name_to_vertex_id;
-    for (size_t i = 0; i < deserialized_vertex_list.vertex_info_size(); i++)
+    const auto iter = stop_id_to_position_.find(stop_id);
+    if (iter == stop_id_to_position_.end())
     {
-        transport_catalogue_serialize::VertexInfo current_info = deserialized_vertex_list.vertex_info(i);
-        stop_name_to_vertex_id[id_to_stop_name_.at(current_info.stop_id())] = current_info.vertex_id();
+        throw std::logic_error("Unknown stop id " + std::to_string(stop_id));
     }
-
-    router.emplace(std::move(result_graph), std::move(routes_internal_data), std::move(stop_name_to_vertex_id));
+    return iter->second;
 }
 
-svg::Color Deserializer::DeserializeColor(transport_catalogue_serialize::Color color)
+void Deserializer::DeserializeStopsIndex(const transport_catalogue_serialize::StopsIndex &stops_index)
 {
-    if (color.has_rgb())
+    if (stops_index.side() == 0)
     {
-        transport_catalogue_serialize::Rgb deserialized_rgb = color.rgb();
-        return svg::Color(svg::Rgb(deserialized_rgb.red(), deserialized_rgb.green(), deserialized_rgb.blue()));
+        //database was made without the index
+        catalogue_.SetStopsIndex(spatial_index::StopsSpatialIndex(stops_coordinates_));
+        return;
     }
-    else if (color.has_rgba())
+    spatial_index::GridData grid;
+    grid.min_lat = stops_index.min_lat();
+    grid.min_lng = stops_index.min_lng();
+    grid.lat_step = stops_index.lat_step();
+    grid.lng_step = stops_index.lng_step();
+    grid.side = stops_index.side();
+    grid.cell_offsets.assign(stops_index.cell_offsets().begin(), stops_index.cell_offsets().end());
+    grid.stop_ids.assign(stops_index.stop_ids().begin(), stops_index.stop_ids().end());
+    catalogue_.SetStopsIndex(spatial_index::StopsSpatialIndex(std::move(grid), stops_coordinates_));
+}
+
+std::vector<std::string_view> Deserializer::GetStopNames() const
+{
+    std::vector<std::string_view> stop_names;
+    stop_names.reserve(stops_coordinates_.size());
+    for (size_t stop_id = 0; stop_id < stops_coordinates_.size(); stop_id++)
     {
-        transport_catalogue_serialize::Rgba deserialized_rgba = color.rgba();
-        return svg::Color(svg::Rgba(deserialized_rgba.red(), deserialized_rgba.green(),
-                                    deserialized_rgba.blue(), deserialized_rgba.opacity()));
+        stop_names.push_back(catalogue_.GetStopById(stop_id)->GetName());
     }
-    else if (color.str() != ""s)
+    return stop_names;
+}
+
+void Deserializer::DeserializeStopNamesIndex(const transport_catalogue_serialize::StopNamesIndex &stop_names_index)
+{
+    const std::vector<std::string_view> stop_names = GetStopNames();
+    if (stop_names_index.trigram_offsets().empty())
     {
-        return svg::Color(color.str());
+        //database was made without the index
+        catalogue_.SetStopNamesIndex(name_search::StopNamesIndex(stop_names));
+        return;
     }
-    throw std::runtime_error("Failed to get deserialized color");
+    name_search::NamesIndexData data;
+    data.sorted_stop_ids.assign(stop_names_index.sorted_stop_ids().begin(), stop_names_index.sorted_stop_ids().end());
+    data.trigrams.assign(stop_names_index.trigrams().begin(), stop_names_index.trigrams().end());
+    data.trigram_offsets.assign(stop_names_index.trigram_offsets().begin(), stop_names_index.trigram_offsets().end());
+    data.positions.assign(stop_names_index.positions().begin(), stop_names_index.positions().end());
+    catalogue_.SetStopNamesIndex(name_search::StopNamesIndex(std::move(data), stop_names));
 }
 
-void Deserializer::DeserializeMapRenderer(transport_catalogue_serialize::RenderSettings deserialized_settings,
-                                          renderer::MapRenderer &renderer)
+void Deserializer::DeserializeDistances(const transport_catalogue_serialize::DistanceList &distance_list,
+                                        CatalogueData &data) const
 {
-    renderer::RendererSettings renderer_settings;
+    const size_t distance_size = distance_list.distance_size();
+    data.distances.reserve(distance_size);
+    for (size_t i = 0; i < distance_size; i++)
+    {
+        const auto &distance = distance_list.distance(i);
+        data.distances.push_back({GetStopPosition(distance.stop_from_id()), GetStopPosition(distance.stop_to_id()),
+                                  static_cast<int>(distance.value())});
+    }
+}
+
+void Deserializer::DeserializeBuses(const transport_catalogue_serialize::BusList &bus_list, CatalogueData &data)
+{
+    const size_t buses_size = bus_list.bus_size();
+    data.buses.reserve(buses_size);
+    id_to_bus_name_.reserve(buses_size);
+    for (size_t i = 0; i < buses_size; i++)
+    {
+        const auto &bus = bus_list.bus(i);
+        CatalogueData::BusData bus_data;
+        bus_data.name = bus.name();
+        bus_data.is_circle = bus.is_roundtrip();
+        bus_data.stop_ids.reserve(bus.stop_id_size());
+        for (size_t stop_id : bus.stop_id())
+        {
+            bus_data.stop_ids.push_back(GetStopPosition(stop_id));
+        }
+        id_to_bus_name_[bus.id()] = bus.name();
+        data.buses.push_back(std::move(bus_data));
+    }
+}
+
+std::vector<graph::Edge<double>> Deserializer::DeserializeEdgeList(const transport_catalogue_serialize::EdgeList &deserialized_edge_list) const
+{
+    std::vector<graph::Edge<double>> edge_list;
+    edge_list.reserve(deserialized_edge_list.edge_size());
+    for (const transport_catalogue_serialize::Edge &edge : deserialized_edge_list.edge())
+    {
+        graph::Edge<double> &current_edge = edge_list.emplace_back();
+        if (edge.is_walk())
+        {
+            current_edge.type = graph::EdgeType::WALK;
+            current_edge.stop_to_name = id_to_stop_name_.at(edge.stop_to_id());
+        }
+        else
+        {
+            current_edge.bus_name = id_to_bus_name_.at(edge.bus_id());
+        }
+        current_edge.stop_name = id_to_stop_name_.at(edge.stop_id());
+        current_edge.span_count = edge.span_count();
+        current_edge.wait_time = edge.wait_time();
+        current_edge.time_in_road = edge.time_in_road();
+        current_edge.from = edge.from_id();
+        current_edge.to = edge.to_id();
+        current_edge.weight = edge.weight();
+    }
+    return edge_list;
+}
+
+std::vector<std::vector<size_t>>
+Deserializer::DeserializeIncidenceLists(const transport_catalogue_serialize::IncidenceLists &deserialized_incidence_lists) const
+{
+    std::vector<std::vector<size_t>> incidence_lists;
+    incidence_lists.reserve(deserialized_incidence_lists.incidence_list_size());
+    for (const transport_catalogue_serialize::IncidenceList &incidence_list : deserialized_incidence_lists.incidence_list())
+    {
+        incidence_lists.emplace_back(incidence_list.edge_id().begin(), incidence_list.edge_id().end());
+    }
+    return incidence_lists;
+}
+
+graph::DirectedWeightedGraph<double> Deserializer::DeserializeGraph(const transport_catalogue_serialize::Graph &graph_settings) const
+{
+    graph::DirectedWeightedGraph<double> result_graph;
+    result_graph.SetIncidenceLists(DeserializeIncidenceLists(graph_settings.incidence_lists()));
+    result_graph.SetEdges(DeserializeEdgeList(graph_settings.edge_list()));
+    return result_graph;
+}
+
+void Deserializer::DeserializeRoutesRow(const transport_catalogue_serialize::RouteInternalDataList &deser_data_list, size_t row,
+                                        graph::Router<double>::FlatRoutesStorage &routes_storage) const
+{
+    DecodeRoutesRow(deser_data_list, routes_storage.GetVertexCount(), routes_storage.GetWeights(row), routes_storage.GetPrevEdges(row));
+}
+
+std::shared_ptr<const graph::Router<double>::RoutesStorage>
+Deserializer::DeserializeRoutesInternalData(const transport_catalogue_serialize::RoutesInternalData &deserialized_routes_internal_data) const
+{
+    const size_t vertex_count = deserialized_routes_internal_data.route_internal_data_list_size();
+    auto routes_storage = std::make_shared<graph::Router<double>::FlatRoutesStorage>(vertex_count);
+    //rows go to disjoint parts of the storage
+    ParallelFor(vertex_count, MIN_ROWS_PER_TASK, [&](size_t first, size_t last)
+                {
+                    for (size_t i = first; i < last; i++)
+                    {
+                        DeserializeRoutesRow(deserialized_routes_internal_data.route_internal_data_list(i), i, *routes_storage);
+                    }
+                });
+    return routes_storage;
+}
+
+std::unordered_map<std::string, size_t>
+Deserializer::DeserializeVertexList(const transport_catalogue_serialize::VertexInfoList &deserialized_vertex_list) const
+{
+    std::unordered_map<std::string, size_t> stop_name_to_vertex_id;
+    stop_name_to_vertex_id.reserve(deserialized_vertex_list.vertex_info_size());
+    for (const auto &current_info : deserialized_vertex_list.vertex_info())
+    {
+        stop_name_to_vertex_id[id_to_stop_name_.at(current_info.stop_id())] = current_info.vertex_id();
+    }
+    return stop_name_to_vertex_id;
+}
+
+void Deserializer::DeserializeTransportRouter(const transport_catalogue_serialize::Router &router_settings,
+                                              std::optional<transport_router::TransportRouter> &router)
+{
+    //the matrix doesn't depend on the graph
+    auto routes_storage_task = std::async(std::launch::async, [this, &router_settings]
+                                          { return DeserializeRoutesInternalData(router_settings.routes_internal_data()); });
+    graph::DirectedWeightedGraph<double> result_graph = DeserializeGraph(router_settings.graph());
+    auto routes_storage = routes_storage_task.get();
+
+    std::unordered_map<std::string, size_t> stop_name_to_vertex_id = DeserializeVertexList(router_settings.vertex_info_list());
+
+    const double walk_velocity = router_settings.walk_velocity() > 0 ? router_settings.walk_velocity()
+                                                                      : transport_router::DEFAULT_WALK_VELOCITY;
+    router.emplace(std::move(result_graph), std::move(routes_storage), std::move(stop_name_to_vertex_id), walk_velocity);
+}
+
+svg::Color Deserializer::DeserializeColor(const transport_catalogue_serialize::Color &color) const
+{
+    if (color.has_rgb())
+    {
+        const transport_catalogue_serialize::Rgb &deserialized_rgb = color.rgb();
+        return svg::Color(svg::Rgb(deserialized_rgb.red(), deserialized_rgb.green(), deserialized_rgb.blue()));
+    }
+    else if (color.has_rgba())
+    {
+        const transport_catalogue_serialize::Rgba &deserialized_rgba = color.rgba();
+        return svg::Color(svg::Rgba(deserialized_rgba.red(), deserialized_rgba.green(),
+                                    deserialized_rgba.blue(), deserialized_rgba.opacity()));
+    }
+    else if (!color.str().empty())
+    {
+        return svg::Color(color.str());
+    }
+    throw std::runtime_error("Failed to get deserialized color");
+}
+
+void Deserializer::DeserializeMapRenderer(const transport_catalogue_serialize::RenderSettings &deserialized_settings,
+                                          renderer::MapRenderer &renderer) const
+{
+    renderer::RendererSettings renderer_settings;
     renderer_settings.width = deserialized_settings.width();
     renderer_settings.height = deserialized_settings.height();
     renderer_settings.padding = deserialized_settings.padding();
@@ -537,41 +1138,780 @@ void Deserializer::DeserializeMapRenderer(transport_catalogue_serialize::RenderS
     renderer_settings.stop_label_font_size = deserialized_settings.stop_label_font_size();
     renderer_settings.stop_label_offset = {deserialized_settings.stop_label_offset_dx(), deserialized_settings.stop_label_offset_dy()};
     renderer_settings.underlayer_width = deserialized_settings.underlayer_width();
-    
+
     renderer_settings.underlayer_color = DeserializeColor(deserialized_settings.underlayer_color());
-    transport_catalogue_serialize::ColorPalette deserialized_color_palette = deserialized_settings.color_palette();
-    for (size_t i = 0; i < deserialized_color_palette.color_size(); i++)
+    for (const transport_catalogue_serialize::Color &color : deserialized_settings.color_palette().color())
     {
-        renderer_settings.AddColor(DeserializeColor(deserialized_color_palette.color(i)));
+        renderer_settings.AddColor(DeserializeColor(color));
     }
     renderer.SetSettings(std::move(renderer_settings));
 }
 
-void Deserializer::DeserializeCatalogue(transport_catalogue_serialize::TransportCatalogue catalogue)
+std::future<void> Deserializer::DeserializeCatalogue(const transport_catalogue_serialize::TransportCatalogue &catalogue)
 {
-    DeserializeStops(catalogue.stops());
-    DeserializeDistances(catalogue.distances());
-    DeserializeBuses(catalogue.buses());
+    //names of stops and buses are ready when this returns, the router needs only them
+    CatalogueData data;
+    DeserializeStops(catalogue.stops(), data);
+    DeserializeDistances(catalogue.distances(), data);
+    DeserializeBuses(catalogue.buses(), data);
+    return std::async(std::launch::async, [this, data = std::move(data), &catalogue]() mutable
+                      {
+                          catalogue_.BulkLoad(std::move(data));
+                          DeserializeStopsIndex(catalogue.stops_index());
+                          DeserializeStopNamesIndex(catalogue.stop_names_index());
+                      });
 }
 
-void Deserializer::DeserializeTransportDatabase(transport_catalogue_serialize::TransportDatabase database)
+void Deserializer::DeserializeTransportDatabase(const transport_catalogue_serialize::TransportDatabase &database)
 {
-    DeserializeCatalogue(database.catalogue());
+    std::future<void> catalogue_loaded = DeserializeCatalogue(database.catalogue());
     DeserializeMapRenderer(database.render_settings(), renderer_);
     DeserializeTransportRouter(database.router(), router_);
+    catalogue_loaded.get();
+}
+
+std::string_view Deserializer::GetSnapshotString(std::string_view strings, uint32_t offset, uint32_t size)
+{
+    if (offset > strings.size() || size > strings.size() - offset)
+    {
+        throw std::runtime_error("Broken strings of snapshot");
+    }
+    return strings.substr(offset, size);
+}
+
+std::future<void> Deserializer::DeserializeSnapshotCatalogue(const flat_snapshot::SnapshotView &snapshot)
+{
+    const std::string_view strings = snapshot.GetBytes(flat_snapshot::SectionId::STRINGS);
+    const auto stops = snapshot.GetArray<flat_snapshot::StopRecord>(flat_snapshot::SectionId::STOPS);
+    const auto buses = snapshot.GetArray<flat_snapshot::BusRecord>(flat_snapshot::SectionId::BUSES);
+    const auto bus_stops = snapshot.GetArray<uint32_t>(flat_snapshot::SectionId::BUS_STOPS);
+    const auto distances = snapshot.GetArray<flat_snapshot::DistanceRecord>(flat_snapshot::SectionId::DISTANCES);
+
+    //stops and buses are referenced by position in the snapshot, so positions serve as ids
+    CatalogueData data;
+    data.stops.reserve(stops.size());
+    stops_coordinates_.reserve(stops.size());
+    id_to_stop_name_.reserve(stops.size());
+    for (uint32_t i = 0; i < stops.size(); i++)
+    {
+        const geo::Coordinates coordinates{stops[i].lat, stops[i].lng};
+        std::string name(GetSnapshotString(strings, stops[i].name_offset, stops[i].name_size));
+        id_to_stop_name_[i] = name;
+        data.stops.push_back({std::move(name), coordinates});
+        stops_coordinates_.push_back(coordinates);
+    }
+
+    data.distances.reserve(distances.size());
+    for (const auto &distance : distances)
+    {
+        data.distances.push_back({distance.from_stop, distance.to_stop, distance.distance});
+    }
+
+    data.buses.reserve(buses.size());
+    id_to_bus_name_.reserve(buses.size());
+    for (uint32_t i = 0; i < buses.size(); i++)
+    {
+        const auto &bus = buses[i];
+        if (bus.stops_offset > bus_stops.size() || bus.stops_count > bus_stops.size() - bus.stops_offset)
+        {
+            throw std::runtime_error("Broken buses of snapshot");
+        }
+        CatalogueData::BusData bus_data;
+        bus_data.name = GetSnapshotString(strings, bus.name_offset, bus.name_size);
+        bus_data.is_circle = bus.is_roundtrip != 0;
+        bus_data.stop_ids.assign(bus_stops.begin() + bus.stops_offset, bus_stops.begin() + bus.stops_offset + bus.stops_count);
+        id_to_bus_name_[i] = bus_data.name;
+        data.buses.push_back(std::move(bus_data));
+    }
+    return std::async(std::launch::async, [this, &snapshot, data = std::move(data)]() mutable
+                      { LoadSnapshotCatalogue(snapshot, std::move(data)); });
+}
+
+void Deserializer::LoadSnapshotCatalogue(const flat_snapshot::SnapshotView &snapshot, CatalogueData data)
+{
+    catalogue_.BulkLoad(std::move(data));
+
+    const auto &grid_record = snapshot.GetRecord<flat_snapshot::GridRecord>(flat_snapshot::SectionId::STOPS_GRID);
+    const auto cell_offsets = snapshot.GetArray<uint32_t>(flat_snapshot::SectionId::STOPS_GRID_CELL_OFFSETS);
+    const auto grid_stop_ids = snapshot.GetArray<uint32_t>(flat_snapshot::SectionId::STOPS_GRID_STOP_IDS);
+    spatial_index::GridData grid{grid_record.min_lat, grid_record.min_lng, grid_record.lat_step, grid_record.lng_step, grid_record.side,
+                                 {cell_offsets.begin(), cell_offsets.end()}, {grid_stop_ids.begin(), grid_stop_ids.end()}};
+    catalogue_.SetStopsIndex(spatial_index::StopsSpatialIndex(std::move(grid), stops_coordinates_));
+
+    const auto sorted_stop_ids = snapshot.GetArray<uint32_t>(flat_snapshot::SectionId::NAMES_INDEX_SORTED_STOP_IDS);
+    const auto trigrams = snapshot.GetArray<uint32_t>(flat_snapshot::SectionId::NAMES_INDEX_TRIGRAMS);
+    const auto trigram_offsets = snapshot.GetArray<uint32_t>(flat_snapshot::SectionId::NAMES_INDEX_TRIGRAM_OFFSETS);
+    const auto positions = snapshot.GetArray<uint32_t>(flat_snapshot::SectionId::NAMES_INDEX_POSITIONS);
+    name_search::NamesIndexData names_index{{sorted_stop_ids.begin(), sorted_stop_ids.end()},
+                                            {trigrams.begin(), trigrams.end()},
+                                            {trigram_offsets.begin(), trigram_offsets.end()},
+                                            {positions.begin(), positions.end()}};
+    catalogue_.SetStopNamesIndex(name_search::StopNamesIndex(std::move(names_index), GetStopNames()));
+}
+
+void Deserializer::DeserializeSnapshotRouter(std::shared_ptr<const MappedFile> file, const flat_snapshot::SnapshotView &snapshot)
+{
+    const auto &settings = snapshot.GetRecord<flat_snapshot::RouterSettingsRecord>(flat_snapshot::SectionId::ROUTER_SETTINGS);
+    const auto vertices = snapshot.GetArray<uint32_t>(flat_snapshot::SectionId::VERTICES);
+    //compressed edges are decompressed once, they become graph::Edge anyway
+    std::vector<flat_snapshot::EdgeRecord> decompressed_edges;
+    flat_snapshot::ArrayView<flat_snapshot::EdgeRecord> edges;
+    if (snapshot.HasSection(flat_snapshot::SectionId::EDGES_BLOCKS))
+    {
+        decompressed_edges = flat_snapshot::CompressedBlocks(snapshot, flat_snapshot::SectionId::EDGES_BLOCKS_SETTINGS,
+                                                             flat_snapshot::SectionId::EDGES_BLOCK_INDEX, flat_snapshot::SectionId::EDGES_BLOCKS,
+                                                             sizeof(flat_snapshot::EdgeRecord))
+                                 .DecompressAll<flat_snapshot::EdgeRecord>();
+        edges = {decompressed_edges.data(), decompressed_edges.size()};
+    }
+    else
+    {
+        edges = snapshot.GetArray<flat_snapshot::EdgeRecord>(flat_snapshot::SectionId::EDGES);
+    }
+    const auto incidence_offsets = snapshot.GetArray<uint32_t>(flat_snapshot::SectionId::INCIDENCE_OFFSETS);
+    const auto incidence_edges = snapshot.GetArray<uint32_t>(flat_snapshot::SectionId::INCIDENCE_EDGES);
+    const size_t vertex_count = settings.vertex_count;
+    if (vertices.size() != vertex_count || incidence_offsets.size() != vertex_count + 1 ||
+        incidence_offsets[vertex_count] != incidence_edges.size())
+    {
+        throw std::runtime_error("Broken graph of snapshot");
+    }
+
+    std::vector<graph::Edge<double>> edge_list(edges.size());
+    ParallelFor(edges.size(), MIN_EDGES_PER_TASK, [&](size_t first, size_t last)
+                {
+                    for (size_t i = first; i < last; i++)
+                    {
+                        const flat_snapshot::EdgeRecord &edge = edges[i];
+                        graph::Edge<double> &current_edge = edge_list[i];
+                        if (edge.is_walk)
+                        {
+                            current_edge.type = graph::EdgeType::WALK;
+                            current_edge.stop_to_name = id_to_stop_name_.at(edge.stop_to);
+                        }
+                        else
+                        {
+                            current_edge.bus_name = id_to_bus_name_.at(edge.bus);
+                        }
+                        current_edge.stop_name = id_to_stop_name_.at(edge.stop);
+                        current_edge.span_count = edge.span_count;
+                        current_edge.wait_time = edge.wait_time;
+                        current_edge.time_in_road = edge.time_in_road;
+                        current_edge.from = edge.from;
+                        current_edge.to = edge.to;
+                        current_edge.weight = edge.weight;
+                    }
+                });
+
+    std::vector<std::vector<size_t>> incidence_lists(vertex_count);
+    for (size_t i = 0; i < vertex_count; i++)
+    {
+        if (incidence_offsets[i] > incidence_offsets[i + 1])
+        {
+            throw std::runtime_error("Broken graph of snapshot");
+        }
+        incidence_lists[i].assign(incidence_edges.begin() + incidence_offsets[i], incidence_edges.begin() + incidence_offsets[i + 1]);
+    }
+
+    graph::DirectedWeightedGraph<double> result_graph;
+    result_graph.SetIncidenceLists(std::move(incidence_lists));
+    result_graph.SetEdges(std::move(edge_list));
+
+    std::unordered_map<std::string, size_t> stop_name_to_vertex_id;
+    stop_name_to_vertex_id.reserve(vertex_count);
+    for (size_t i = 0; i < vertex_count; i++)
+    {
+        stop_name_to_vertex_id[id_to_stop_name_.at(vertices[i])] = i;
+    }
+
+    //the matrix is checked on its own thread from now on, queries check the rows they read before it gets to them
+    std::shared_ptr<const graph::Router<double>::RoutesStorage> routes_storage;
+    if (snapshot.HasSection(flat_snapshot::SectionId::ROUTES_BLOCKS))
+    {
+        auto compressed_storage = std::make_shared<flat_snapshot::CompressedRoutesStorage>(std::move(file), snapshot, vertex_count);
+        background_verification_ = std::make_shared<flat_snapshot::BackgroundVerification>(compressed_storage,
+                                                                                           compressed_storage->GetLazyChecksums());
+        routes_storage = std::move(compressed_storage);
+    }
+    else
+    {
+        auto mapped_storage = std::make_shared<flat_snapshot::MappedRoutesStorage>(std::move(file), snapshot, vertex_count);
+        background_verification_ = std::make_shared<flat_snapshot::BackgroundVerification>(mapped_storage,
+                                                                                           mapped_storage->GetLazyChecksums());
+        routes_storage = std::move(mapped_storage);
+    }
+    const double walk_velocity = settings.walk_velocity > 0 ? settings.walk_velocity : transport_router::DEFAULT_WALK_VELOCITY;
+    router_.emplace(std::move(result_graph), std::move(routes_storage), std::move(stop_name_to_vertex_id), walk_velocity);
+}
+
+bool Deserializer::DeserializeFromFlatSnapshot(std::shared_ptr<const MappedFile> file)
+{
+    const flat_snapshot::SnapshotView snapshot(file->GetData());
+    //small sections are checked while they are loaded, the routes matrix when its rows are read
+    //and by a background check that goes on after loading
+    std::future<void> checksums_verified = std::async(std::launch::async, [&snapshot]
+                                                      { snapshot.VerifyChecksums(); });
+
+    std::future<void> catalogue_loaded = DeserializeSnapshotCatalogue(snapshot);
+
+    transport_catalogue_serialize::RenderSettings render_settings;
+    const std::string_view render_settings_bytes = snapshot.GetBytes(flat_snapshot::SectionId::RENDER_SETTINGS);
+    if (!render_settings.ParseFromArray(render_settings_bytes.data(), static_cast<int>(render_settings_bytes.size())))
+    {
+        return false;
+    }
+    DeserializeMapRenderer(render_settings, renderer_);
+
+    DeserializeSnapshotRouter(std::move(file), snapshot);
+    catalogue_loaded.get();
+    checksums_verified.get();
+    //nothing is parsed into protobuf messages, the routes matrix stays in the mapping
+    database_memory_usage_ = 0;
+    return true;
+}
+
+Deserializer::ChunkStatus Deserializer::ReadChunk(google::protobuf::io::ZeroCopyInputStream &input, std::string &chunk_bytes)
+{
+    //a coded stream per chunk, so its byte limit applies to one chunk and not to the whole database
+    google::protobuf::io::CodedInputStream coded_input(&input);
+    uint32_t size = 0;
+    if (!coded_input.ReadVarint32(&size))
+    {
+        return ChunkStatus::END;
+    }
+    if (size > static_cast<uint32_t>(std::numeric_limits<int>::max()) || !coded_input.ReadString(&chunk_bytes, static_cast<int>(size)))
+    {
+        return ChunkStatus::BROKEN;
+    }
+    return ChunkStatus::OK;
+}
+
+int Deserializer::GetChunkField(const std::string &chunk_bytes)
+{
+    //a chunk has one field of the oneof, it goes first
+    google::protobuf::io::CodedInputStream coded_input(reinterpret_cast<const uint8_t *>(chunk_bytes.data()),
+                                                       static_cast<int>(chunk_bytes.size()));
+    return google::protobuf::internal::WireFormatLite::GetTagFieldNumber(coded_input.ReadTag());
+}
+
+Deserializer::RowsBlockInfo Deserializer::DeserializeRoutesRowsChunk(const std::string &chunk_bytes,
+                                                                    graph::Router<double>::FlatRoutesStorage &routes_storage) const
+{
+    //an old block has a message per cell, they are freed at once with the arena
+    google::protobuf::Arena arena;
+    auto &chunk = *google::protobuf::Arena::CreateMessage<transport_catalogue_serialize::DatabaseChunk>(&arena);
+    if (!chunk.ParseFromString(chunk_bytes))
+    {
+        throw std::runtime_error("Broken routes internal data");
+    }
+    const auto &block = chunk.routes_rows();
+    const size_t vertex_count = routes_storage.GetVertexCount();
+    if (block.first_row() > vertex_count || static_cast<size_t>(block.rows_size()) > vertex_count - block.first_row())
+    {
+        throw std::runtime_error("Broken routes internal data");
+    }
+    for (int i = 0; i < block.rows_size(); i++)
+    {
+        DeserializeRoutesRow(block.rows(i), block.first_row() + i, routes_storage);
+    }
+    return {block.first_row(), static_cast<size_t>(block.rows_size()), chunk.SpaceUsedLong()};
+}
+
+bool Deserializer::DeserializeFromStream(std::istream &input)
+{
+    google::protobuf::io::IstreamInputStream raw_input(&input);
+    std::string chunk_bytes;
+    //encoded rows are moved into the storage, so they are parsed into a message on the heap
+    transport_catalogue_serialize::DatabaseChunk rows_chunk;
+    //the catalogue and the router header are used until the end, other chunks are dropped after decoding
+    google::protobuf::Arena database_arena;
+    //left uninitialized, the arena writes before it reads
+    const std::unique_ptr<char[]> chunk_arena_block(new char[ARENA_BLOCK_SIZE]);
+    bool has_render_settings = false;
+    const transport_catalogue_serialize::RouterHeader *router_header = nullptr;
+    std::vector<graph::Edge<double>> edges;
+    std::vector<std::vector<size_t>> incidence_lists;
+    //matrix of old versions is decoded at once, the current one stays encoded
+    std::shared_ptr<graph::Router<double>::FlatRoutesStorage> routes_storage;
+    std::shared_ptr<LazyRoutesStorage> lazy_routes_storage;
+    std::vector<RowsBlockInfo> rows_blocks;
+    //tasks are declared after everything they use, so they are waited for first on return
+    std::optional<std::future<void>> catalogue_loaded;
+    std::deque<std::future<RowsBlockInfo>> rows_tasks;
+    const size_t max_rows_tasks = std::max(1u, std::thread::hardware_concurrency());
+
+    ChunkStatus status;
+    while ((status = ReadChunk(raw_input, chunk_bytes)) == ChunkStatus::OK)
+    {
+        const int chunk_field = GetChunkField(chunk_bytes);
+        //blocks of the matrix are parsed and decoded while the next chunks are read
+        if (chunk_field == transport_catalogue_serialize::DatabaseChunk::kRoutesRowsFieldNumber)
+        {
+            if (!router_header || lazy_routes_storage)
+            {
+                return false;
+            }
+            if (!routes_storage)
+            {
+                routes_storage = std::make_shared<graph::Router<double>::FlatRoutesStorage>(router_header->vertex_count());
+            }
+            if (rows_tasks.size() == max_rows_tasks)
+            {
+                rows_blocks.push_back(rows_tasks.front().get());
+                rows_tasks.pop_front();
+            }
+            rows_tasks.push_back(std::async(std::launch::async, [this, bytes = std::move(chunk_bytes), &routes_storage]
+                                            { return DeserializeRoutesRowsChunk(bytes, *routes_storage); }));
+            chunk_bytes.clear();
+            continue;
+        }
+
+        if (chunk_field == transport_catalogue_serialize::DatabaseChunk::kEncodedRoutesRowsFieldNumber)
+        {
+            if (!router_header || routes_storage || !rows_chunk.ParseFromString(chunk_bytes))
+            {
+                return false;
+            }
+            database_memory_usage_ = std::max(database_memory_usage_, rows_chunk.SpaceUsedLong());
+            if (!lazy_routes_storage)
+            {
+                lazy_routes_storage = std::make_shared<LazyRoutesStorage>(router_header->vertex_count());
+            }
+            lazy_routes_storage->AddRows(std::move(*rows_chunk.mutable_encoded_routes_rows()));
+            continue;
+        }
+
+        //the arena starts in the reused block, so a small chunk is parsed without allocations
+        google::protobuf::Arena chunk_arena(chunk_arena_block.get(), ARENA_BLOCK_SIZE);
+        const bool is_kept = chunk_field == transport_catalogue_serialize::DatabaseChunk::kCatalogueFieldNumber ||
+                             chunk_field == transport_catalogue_serialize::DatabaseChunk::kRouterHeaderFieldNumber;
+        auto &chunk = *google::protobuf::Arena::CreateMessage<transport_catalogue_serialize::DatabaseChunk>(
+            is_kept ? &database_arena : &chunk_arena);
+        if (!chunk.ParseFromString(chunk_bytes))
+        {
+            return false;
+        }
+        database_memory_usage_ = std::max(database_memory_usage_, chunk.SpaceUsedLong());
+        switch (chunk.chunk_case())
+        {
+        case transport_catalogue_serialize::DatabaseChunk::kCatalogue:
+            if (catalogue_loaded)
+            {
+                return false;
+            }
+            catalogue_loaded = DeserializeCatalogue(chunk.catalogue());
+            break;
+        case transport_catalogue_serialize::DatabaseChunk::kRenderSettings:
+            DeserializeMapRenderer(chunk.render_settings(), renderer_);
+            has_render_settings = true;
+            break;
+        case transport_catalogue_serialize::DatabaseChunk::kRouterHeader:
+            if (!catalogue_loaded || router_header)
+            {
+                return false;
+            }
+            router_header = &chunk.router_header();
+            edges.reserve(router_header->edge_count());
+            incidence_lists.reserve(router_header->vertex_count());
+            break;
+        case transport_catalogue_serialize::DatabaseChunk::kEdges:
+        {
+            if (!router_header)
+            {
+                return false;
+            }
+            std::vector<graph::Edge<double>> edges_chunk = DeserializeEdgeList(chunk.edges());
+            std::move(edges_chunk.begin(), edges_chunk.end(), std::back_inserter(edges));
+            break;
+        }
+        case transport_catalogue_serialize::DatabaseChunk::kIncidenceLists:
+        {
+            if (!router_header)
+            {
+                return false;
+            }
+            std::vector<std::vector<size_t>> lists_chunk = DeserializeIncidenceLists(chunk.incidence_lists());
+            std::move(lists_chunk.begin(), lists_chunk.end(), std::back_inserter(incidence_lists));
+            break;
+        }
+        default:
+            //chunks of newer versions
+            break;
+        }
+    }
+    for (auto &task : rows_tasks)
+    {
+        rows_blocks.push_back(task.get());
+    }
+    if (catalogue_loaded)
+    {
+        catalogue_loaded->get();
+    }
+
+    //blocks must cover every row exactly once
+    std::sort(rows_blocks.begin(), rows_blocks.end(), [](const RowsBlockInfo &lhs, const RowsBlockInfo &rhs)
+              { return lhs.first_row < rhs.first_row; });
+    size_t rows_count = 0;
+    for (const RowsBlockInfo &block : rows_blocks)
+    {
+        if (block.first_row != rows_count)
+        {
+            return false;
+        }
+        rows_count += block.rows_count;
+        database_memory_usage_ = std::max(database_memory_usage_, block.memory_usage);
+    }
+
+    if (status == ChunkStatus::BROKEN || !catalogue_loaded || !has_render_settings || !router_header ||
+        edges.size() != router_header->edge_count() || incidence_lists.size() != router_header->vertex_count())
+    {
+        return false;
+    }
+    std::shared_ptr<const graph::Router<double>::RoutesStorage> result_routes_storage;
+    if (lazy_routes_storage && lazy_routes_storage->HasAllRows())
+    {
+        result_routes_storage = std::move(lazy_routes_storage);
+    }
+    else if (!lazy_routes_storage && rows_count == router_header->vertex_count())
+    {
+        if (!routes_storage)
+        {
+            //graph without vertices
+            routes_storage = std::make_shared<graph::Router<double>::FlatRoutesStorage>(0);
+        }
+        result_routes_storage = std::move(routes_storage);
+    }
+    else
+    {
+        return false;
+    }
+
+    graph::DirectedWeightedGraph<double> result_graph;
+    result_graph.SetIncidenceLists(std::move(incidence_lists));
+    result_graph.SetEdges(std::move(edges));
+    const double walk_velocity = router_header->walk_velocity() > 0 ? router_header->walk_velocity()
+                                                                    : transport_router::DEFAULT_WALK_VELOCITY;
+    router_.emplace(std::move(result_graph), std::move(result_routes_storage),
+                    DeserializeVertexList(router_header->vertex_info_list()), walk_velocity);
+    return true;
+}
+
+void Deserializer::ApplyCatalogueDelta(const transport_catalogue_serialize::CatalogueDelta &delta)
+{
+    CatalogueData data = catalogue_.GetData();
+    spatial_index::GridData grid = catalogue_.GetStopsIndex().GetData();
+    name_search::NamesIndexData names_data = catalogue_.GetStopNamesIndex().GetData();
+
+    //stops are never removed, a changed stop keeps its id and a new one gets the next id
+    for (const transport_catalogue_serialize::Stop &stop : delta.stops().stop())
+    {
+        const geo::Coordinates coordinates{stop.coordinate().lat(), stop.coordinate().lng()};
+        if (stop.id() < data.stops.size() && data.stops[stop.id()].name == stop.name())
+        {
+            data.stops[stop.id()].coordinates = coordinates;
+        }
+        else if (stop.id() == data.stops.size())
+        {
+            data.stops.push_back({stop.name(), coordinates});
+        }
+        else
+        {
+            throw std::runtime_error("Unexpected stop in the delta: " + stop.name());
+        }
+    }
+    auto check_stop_id = [stops_count = data.stops.size()](uint32_t stop_id)
+    {
+        if (stop_id >= stops_count)
+        {
+            throw std::runtime_error("Unknown stop id " + std::to_string(stop_id));
+        }
+        return stop_id;
+    };
+
+    //buses left from the base keep their order, new buses go after them
+    std::unordered_set<std::string_view> removed_buses(delta.removed_buses().begin(), delta.removed_buses().end());
+    std::vector<CatalogueData::BusData> buses;
+    buses.reserve(data.buses.size() + delta.buses().bus_size());
+    for (CatalogueData::BusData &bus : data.buses)
+    {
+        if (removed_buses.count(bus.name) == 0)
+        {
+            buses.push_back(std::move(bus));
+        }
+    }
+    std::unordered_map<std::string_view, size_t> bus_positions;
+    bus_positions.reserve(buses.size());
+    for (size_t position = 0; position < buses.size(); position++)
+    {
+        bus_positions[buses[position].name] = position;
+    }
+    for (const transport_catalogue_serialize::Bus &bus : delta.buses().bus())
+    {
+        const auto iter = bus_positions.find(bus.name());
+        const size_t position = iter != bus_positions.end() ? iter->second : buses.size();
+        if (position != bus.id())
+        {
+            throw std::runtime_error("Unexpected bus in the delta: " + bus.name());
+        }
+        CatalogueData::BusData bus_data;
+        bus_data.name = bus.name();
+        bus_data.is_circle = bus.is_roundtrip();
+        bus_data.stop_ids.reserve(bus.stop_id_size());
+        for (uint32_t stop_id : bus.stop_id())
+        {
+            bus_data.stop_ids.push_back(check_stop_id(stop_id));
+        }
+        if (position == buses.size())
+        {
+            buses.push_back(std::move(bus_data));
+        }
+        else
+        {
+            buses[position] = std::move(bus_data);
+        }
+    }
+    data.buses = std::move(buses);
+
+    auto get_key = [](uint32_t from, uint32_t to)
+    {
+        return static_cast<uint64_t>(from) << 32 | to;
+    };
+    std::unordered_map<uint64_t, size_t> distance_positions;
+    distance_positions.reserve(data.distances.size());
+    for (size_t position = 0; position < data.distances.size(); position++)
+    {
+        distance_positions[get_key(data.distances[position].from_stop_id, data.distances[position].to_stop_id)] = position;
+    }
+    std::vector<bool> is_removed(data.distances.size());
+    for (const transport_catalogue_serialize::Distance &distance : delta.removed_distances().distance())
+    {
+        const auto iter = distance_positions.find(get_key(distance.stop_from_id(), distance.stop_to_id()));
+        if (iter != distance_positions.end())
+        {
+            is_removed[iter->second] = true;
+        }
+    }
+    for (const transport_catalogue_serialize::Distance &distance : delta.distances().distance())
+    {
+        const uint32_t from = check_stop_id(distance.stop_from_id());
+        const uint32_t to = check_stop_id(distance.stop_to_id());
+        const auto iter = distance_positions.find(get_key(from, to));
+        if (iter != distance_positions.end())
+        {
+            data.distances[iter->second].distance = static_cast<int>(distance.value());
+            is_removed[iter->second] = false;
+        }
+        else
+        {
+            data.distances.push_back({from, to, static_cast<int>(distance.value())});
+            is_removed.push_back(false);
+        }
+    }
+    size_t kept_distances = 0;
+    for (size_t position = 0; position < data.distances.size(); position++)
+    {
+        if (!is_removed[position])
+        {
+            data.distances[kept_distances++] = data.distances[position];
+        }
+    }
+    data.distances.resize(kept_distances);
+
+    //ids of the delta are positions in the catalogue
+    id_to_stop_name_.clear();
+    stop_id_to_position_.clear();
+    stops_coordinates_.clear();
+    for (size_t stop_id = 0; stop_id < data.stops.size(); stop_id++)
+    {
+        id_to_stop_name_[stop_id] = data.stops[stop_id].name;
+        stop_id_to_position_[stop_id] = static_cast<uint32_t>(stop_id);
+        stops_coordinates_.push_back(data.stops[stop_id].coordinates);
+    }
+    id_to_bus_name_.clear();
+    for (size_t bus_id = 0; bus_id < data.buses.size(); bus_id++)
+    {
+        id_to_bus_name_[bus_id] = data.buses[bus_id].name;
+    }
+
+    catalogue_ = TransportCatalogue();
+    catalogue_.BulkLoad(std::move(data));
+    //indexes of the base are kept if no stop changed
+    if (delta.has_stops_index())
+    {
+        DeserializeStopsIndex(delta.stops_index());
+    }
+    else
+    {
+        catalogue_.SetStopsIndex(spatial_index::StopsSpatialIndex(std::move(grid), stops_coordinates_));
+    }
+    if (delta.has_stop_names_index())
+    {
+        DeserializeStopNamesIndex(delta.stop_names_index());
+    }
+    else
+    {
+        catalogue_.SetStopNamesIndex(name_search::StopNamesIndex(std::move(names_data), GetStopNames()));
+    }
+}
+
+bool Deserializer::ApplyDeltaFromIstream(std::istream &input)
+{
+    if (!router_ || !SkipMagic(input, DELTA_MAGIC))
+    {
+        return false;
+    }
+    google::protobuf::io::IstreamInputStream raw_input(&input);
+    std::string chunk_bytes;
+    google::protobuf::Arena header_arena;
+    const std::unique_ptr<char[]> chunk_arena_block(new char[ARENA_BLOCK_SIZE]);
+    const transport_catalogue_serialize::DeltaHeader *header = nullptr;
+    bool has_catalogue = false;
+    std::vector<graph::Edge<double>> edges;
+    std::vector<std::vector<size_t>> incidence_lists;
+    //edges and vertices past the base must all be in the delta
+    size_t new_edges = 0;
+    size_t new_vertices = 0;
+    std::shared_ptr<DeltaRoutesStorage> routes_storage;
+
+    ChunkStatus status;
+    while ((status = ReadChunk(raw_input, chunk_bytes)) == ChunkStatus::OK)
+    {
+        const bool is_header = GetChunkField(chunk_bytes) == transport_catalogue_serialize::DatabaseChunk::kDeltaHeaderFieldNumber;
+        google::protobuf::Arena chunk_arena(chunk_arena_block.get(), ARENA_BLOCK_SIZE);
+        auto &chunk = *google::protobuf::Arena::CreateMessage<transport_catalogue_serialize::DatabaseChunk>(
+            is_header ? &header_arena : &chunk_arena);
+        if (!chunk.ParseFromString(chunk_bytes))
+        {
+            return false;
+        }
+        database_memory_usage_ = std::max(database_memory_usage_, chunk.SpaceUsedLong());
+        if (!is_header && !header)
+        {
+            return false;
+        }
+        switch (chunk.chunk_case())
+        {
+        case transport_catalogue_serialize::DatabaseChunk::kDeltaHeader:
+        {
+            if (header)
+            {
+                return false;
+            }
+            header = &chunk.delta_header();
+            const auto &graph = router_->GetGraph();
+            if (header->base_stop_count() != catalogue_.GetAllStops().size() ||
+                header->base_bus_count() != catalogue_.GetAllBuses().size() ||
+                header->base_vertex_count() != graph.GetVertexCount() || header->base_edge_count() != graph.GetEdgeCount())
+            {
+                throw std::runtime_error("Delta doesn't match the database");
+            }
+            edges = graph.GetEdges();
+            edges.resize(header->edge_count());
+            incidence_lists = graph.GetIncedenceLists();
+            incidence_lists.resize(header->vertex_count());
+            //with other vertices every row of the matrix is in the delta
+            routes_storage = std::make_shared<DeltaRoutesStorage>(
+                header->vertex_count(), header->has_vertex_info_list() ? nullptr : router_->ShareRoutesStorage());
+            break;
+        }
+        case transport_catalogue_serialize::DatabaseChunk::kCatalogueDelta:
+            if (has_catalogue)
+            {
+                return false;
+            }
+            ApplyCatalogueDelta(chunk.catalogue_delta());
+            has_catalogue = true;
+            break;
+        case transport_catalogue_serialize::DatabaseChunk::kRenderSettings:
+            DeserializeMapRenderer(chunk.render_settings(), renderer_);
+            break;
+        case transport_catalogue_serialize::DatabaseChunk::kEdgesDelta:
+        {
+            //edges refer to ids of the changed catalogue
+            const auto &edges_delta = chunk.edges_delta();
+            if (!has_catalogue || edges_delta.edge_ids_size() != edges_delta.edges().edge_size())
+            {
+                return false;
+            }
+            std::vector<graph::Edge<double>> edges_chunk = DeserializeEdgeList(edges_delta.edges());
+            for (int i = 0; i < edges_delta.edge_ids_size(); i++)
+            {
+                const size_t edge_id = edges_delta.edge_ids(i);
+                if (edge_id >= edges.size())
+                {
+                    return false;
+                }
+                new_edges += edge_id >= header->base_edge_count() ? 1 : 0;
+                edges[edge_id] = std::move(edges_chunk[i]);
+            }
+            break;
+        }
+        case transport_catalogue_serialize::DatabaseChunk::kIncidenceListsDelta:
+        {
+            const auto &lists_delta = chunk.incidence_lists_delta();
+            if (lists_delta.vertex_ids_size() != lists_delta.incidence_lists().incidence_list_size())
+            {
+                return false;
+            }
+            for (int i = 0; i < lists_delta.vertex_ids_size(); i++)
+            {
+                const size_t vertex_id = lists_delta.vertex_ids(i);
+                if (vertex_id >= incidence_lists.size())
+                {
+                    return false;
+                }
+                new_vertices += vertex_id >= header->base_vertex_count() ? 1 : 0;
+                const auto &edge_ids = lists_delta.incidence_lists().incidence_list(i).edge_id();
+                incidence_lists[vertex_id].assign(edge_ids.begin(), edge_ids.end());
+            }
+            break;
+        }
+        case transport_catalogue_serialize::DatabaseChunk::kRoutesRowsDelta:
+            routes_storage->AddRows(chunk.routes_rows_delta());
+            break;
+        default:
+            //chunks of newer versions
+            break;
+        }
+    }
+
+    if (status == ChunkStatus::BROKEN || !header || !has_catalogue || !routes_storage->HasAllRows() ||
+        new_edges != edges.size() - std::min<size_t>(edges.size(), header->base_edge_count()) ||
+        new_vertices != incidence_lists.size() - std::min<size_t>(incidence_lists.size(), header->base_vertex_count()))
+    {
+        return false;
+    }
+
+    graph::DirectedWeightedGraph<double> result_graph;
+    result_graph.SetIncidenceLists(std::move(incidence_lists));
+    result_graph.SetEdges(std::move(edges));
+    //the loaded router is replaced, so its vertices are copied first
+    std::unordered_map<std::string, size_t> stop_name_to_vertex_id = header->has_vertex_info_list()
+                                                                         ? DeserializeVertexList(header->vertex_info_list())
+                                                                         : router_->GetStopsToId();
+    const double walk_velocity = header->walk_velocity() > 0 ? header->walk_velocity() : transport_router::DEFAULT_WALK_VELOCITY;
+    router_.emplace(std::move(result_graph), std::move(routes_storage), std::move(stop_name_to_vertex_id), walk_velocity);
+    return true;
 }
 
 bool Deserializer::DeserializeFromIstream(std::istream &input)
 {
-    transport_catalogue_serialize::TransportDatabase deserialized_database;
+    if (IsDatabaseStream(input))
+    {
+        return DeserializeFromStream(input);
+    }
+
+    google::protobuf::Arena arena;
+    auto &deserialized_database = *google::protobuf::Arena::CreateMessage<transport_catalogue_serialize::TransportDatabase>(&arena);
 
     bool is_database_correct = deserialized_database.ParseFromIstream(&input);
     if (!is_database_correct)
     {
         return false;
     }
+    database_memory_usage_ = deserialized_database.SpaceUsedLong();
 
-    DeserializeTransportDatabase(std::move(deserialized_database));
+    DeserializeTransportDatabase(deserialized_database);
 
     return true;
 }
@@ -1,12 +1,21 @@
 #pragma once
 
-#include "JSONlib/json.h"
+#include "flat_snapshot.h"
 #include "map_renderer.h"
+#include "mapped_file.h"
 #include "transport_catalogue.h"
 #include "transport_router.h"
 
+#include <atomic>
+#include <deque>
+#include <future>
+#include <google/protobuf/io/coded_stream.h>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <transport_catalogue.pb.h>
 #include <unordered_map>
 #include <vector>
@@ -16,94 +25,292 @@ namespace transport_catalogue
 namespace serialization
 {
 
+//the streamed database starts with these bytes, a database without them is one TransportDatabase message
+inline const char STREAM_MAGIC[8] = {'T', 'C', 'S', 'T', 'R', 'M', '0', '1'};
+//a delta database starts with these bytes, it is a stream of chunks applied on top of a database
+inline const char DELTA_MAGIC[8] = {'T', 'C', 'D', 'E', 'L', 'T', '0', '1'};
+//edges and incidence lists in one chunk of the stream
+inline const size_t STREAM_CHUNK_ITEMS = 16384;
+//approximate size of a block of routes matrix rows in the stream
+inline const size_t STREAM_CHUNK_BYTES = 1 << 20;
+
 class Serializer
 {
 public:
-    explicit Serializer(const std::vector<json::Dict> &stops_request, const std::vector<json::Dict> &bus_requests,
-                        const json::Dict &renderer_settings, const transport_router::TransportRouter &router);
+    //stops and buses are written with their positions in the catalogue as ids;
+    //measure_memory enables GetDatabaseMemoryUsage, it walks every written message, so it is off by default
+    explicit Serializer(const TransportCatalogue &catalogue, const renderer::RendererSettings &render_settings,
+                        const transport_router::TransportRouter &router, bool measure_memory = false);
 
+    //writes the database as a stream of chunks, so no message holds the whole database
     void SerializeToOstream(std::ostream &output);
 
+    //writes the database in the flat_snapshot format
+    void SerializeToFlatOstream(std::ostream &output, flat_snapshot::Compression compression = flat_snapshot::Compression::NONE);
+
+    //writes only what differs from the base database, the catalogue must keep ids of the base:
+    //its stops start with the stops of the base, its buses start with the buses left from the base in their order;
+    //throws std::logic_error otherwise
+    void SerializeDeltaToOstream(std::ostream &output, const TransportCatalogue &base_catalogue,
+                                 const renderer::RendererSettings &base_render_settings,
+                                 const transport_router::TransportRouter &base_router);
+
+    //heap bytes of the biggest written protobuf message, 0 unless measure_memory is set
+    size_t GetDatabaseMemoryUsage() const
+    {
+        return database_memory_usage_;
+    }
+
 private:
-    transport_catalogue_serialize::TransportCatalogue SerializeTransportCatalogue();
+    //messages are filled in place, so nested messages are never built aside and copied into their parents
+    void SerializeTransportCatalogue(transport_catalogue_serialize::TransportCatalogue &serialize_catalogue) const;
 
-    transport_catalogue_serialize::TransportDatabase SerializeTransportDatabase();
+    void SerializeEdges(size_t first, size_t last, transport_catalogue_serialize::EdgeList &serializing_edge_list) const;
 
-    transport_catalogue_serialize::EdgeList SerializeEdgeList() const ;
+    void SerializeEdge(const graph::Edge<double> &edge, transport_catalogue_serialize::Edge &serializing_edge) const;
 
-    transport_catalogue_serialize::IncidenceLists SerializeIncidenceLists() const;
+    void SerializeIncidenceLists(size_t first, size_t last, transport_catalogue_serialize::IncidenceLists &serializing_incidence_lists) const;
 
-    transport_catalogue_serialize::Graph SerializeGraph() const;
+    void SerializeRoutesRow(size_t from, transport_catalogue_serialize::RouteInternalDataList &serializing_row) const;
 
-    transport_catalogue_serialize::RoutesInternalData SerializeRoutesInternalData() const;
+    void WriteChunk(google::protobuf::io::CodedOutputStream &output, const transport_catalogue_serialize::DatabaseChunk &chunk);
 
-    transport_catalogue_serialize::VertexInfoList SerializeVertexList() const;
+    void SerializeVertexList(transport_catalogue_serialize::VertexInfoList &serializing_vertex_list) const;
 
-    transport_catalogue_serialize::Router SerializeRouter() const;
+    void SerializeStops(transport_catalogue_serialize::StopList &result_list) const;
 
-    transport_catalogue_serialize::StopList SerializeStops();
+    void SerializeBuses(transport_catalogue_serialize::BusList &result_list) const;
 
-    transport_catalogue_serialize::BusList SerializeBuses();
+    void SerializeDistances(transport_catalogue_serialize::DistanceList &result_list) const;
 
-    transport_catalogue_serialize::DistanceList SerializeDistances();
+    void SerializeStopsIndex(transport_catalogue_serialize::StopsIndex &result_index) const;
 
-    transport_catalogue_serialize::ColorPalette SerializeColorPalette();
+    void SerializeStopNamesIndex(transport_catalogue_serialize::StopNamesIndex &result_index) const;
 
-    transport_catalogue_serialize::Color SerializeColor(const json::Node &node) const;
+    void SerializeColor(const svg::Color &color, transport_catalogue_serialize::Color &serialize_color) const;
 
-    transport_catalogue_serialize::RenderSettings SerializeRenderSettings();
+    void SerializeRenderSettings(const renderer::RendererSettings &render_settings,
+                                 transport_catalogue_serialize::RenderSettings &result_settings) const;
 
-    std::vector<json::Dict> stops_request_;
-    std::vector<json::Dict> bus_requests_;
-    json::Dict render_settings_;
+    void CheckDeltaOrder(const TransportCatalogue &base_catalogue) const;
+
+    void SerializeCatalogueDelta(const TransportCatalogue &base_catalogue, transport_catalogue_serialize::CatalogueDelta &delta) const;
+
+    const TransportCatalogue &catalogue_;
+    const renderer::RendererSettings &render_settings_;
     const transport_router::TransportRouter &router_;
-    std::unordered_map<std::string, size_t> bus_name_to_id_;
-    std::unordered_map<std::string, size_t> stop_name_to_id_;
-    std::unordered_map<std::string, std::unordered_map<std::string, size_t>> stops_name_to_stop_to_distance_;
+    std::unordered_map<std::string_view, size_t> bus_name_to_id_;
+    //stop id of every vertex of the graph
+    std::vector<uint32_t> vertex_to_stop_id_;
+    bool measure_memory_;
+    size_t database_memory_usage_ = 0;
+};
+
+//Routes matrix kept as encoded rows, a row is decoded on its first use and then served from memory.
+//Rows may be requested from many threads, each row is decoded once.
+class LazyRoutesStorage : public graph::Router<double>::RoutesStorage
+{
+public:
+    explicit LazyRoutesStorage(size_t vertex_count);
+
+    //all rows must be added before the storage is used;
+    //throws std::runtime_error if rows of the block are broken or already added
+    void AddRows(transport_catalogue_serialize::EncodedRoutesRows rows);
+
+    bool HasAllRows() const
+    {
+        return added_rows_ == rows_.size();
+    }
+
+    size_t GetVertexCount() const override
+    {
+        return rows_.size();
+    }
+
+    //throws std::runtime_error if the row can't be decoded
+    graph::Router<double>::RoutesRow GetRow(graph::VertexId from) const override;
+
+    //encoded rows and the decoded ones
+    size_t GetMemoryUsage() const override;
+
+private:
+    struct Row
+    {
+        std::once_flag decoded;
+        std::unique_ptr<double[]> weights;
+        std::unique_ptr<uint32_t[]> prev_edges;
+        size_t block = 0;
+        uint32_t begin = 0;
+        uint32_t end = 0;
+    };
+
+    //blocks don't move when new ones are added
+    std::deque<transport_catalogue_serialize::EncodedRoutesRows> blocks_;
+    mutable std::vector<Row> rows_;
+    size_t added_rows_ = 0;
+    size_t encoded_bytes_ = 0;
+    mutable std::atomic<size_t> decoded_rows_ = 0;
+};
+
+//Rows of the routes matrix changed by a delta over the matrix of the base, other rows are read from the base
+class DeltaRoutesStorage : public graph::Router<double>::RoutesStorage
+{
+public:
+    //base is nullptr if the delta has every row;
+    //throws std::runtime_error if the base has another number of vertices
+    DeltaRoutesStorage(size_t vertex_count, std::shared_ptr<const graph::Router<double>::RoutesStorage> base);
+
+    //throws std::runtime_error if rows of the block are broken or already added
+    void AddRows(const transport_catalogue_serialize::RoutesRowsDelta &rows);
+
+    //without the base every row must be added
+    bool HasAllRows() const
+    {
+        return base_ || added_rows_ == row_slots_.size();
+    }
+
+    size_t GetVertexCount() const override
+    {
+        return row_slots_.size();
+    }
+
+    graph::Router<double>::RoutesRow GetRow(graph::VertexId from) const override;
+
+    //changed rows and the base
+    size_t GetMemoryUsage() const override;
+
+private:
+    static constexpr uint32_t NO_SLOT = std::numeric_limits<uint32_t>::max();
+
+    std::shared_ptr<const graph::Router<double>::RoutesStorage> base_;
+    //position of a changed row in weights_ and prev_edges_
+    std::vector<uint32_t> row_slots_;
+    std::vector<double> weights_;
+    std::vector<uint32_t> prev_edges_;
+    size_t added_rows_ = 0;
 };
 
+//skips the magic of a streamed database, otherwise restores the position of the stream
+bool IsDatabaseStream(std::istream &input);
+
 class Deserializer
 {
 public:
     explicit Deserializer(TransportCatalogue &catalogue_, renderer::MapRenderer &renderer_,
                           std::optional<transport_router::TransportRouter> &router);
 
+    //reads both the stream of chunks and the single message of old versions
     bool DeserializeFromIstream(std::istream &input);
 
+    //the routes matrix is read from the mapping in place, so the storage keeps the file alive
+    bool DeserializeFromFlatSnapshot(std::shared_ptr<const MappedFile> file);
+
+    //applies a delta database on top of the loaded one, the catalogue is rebuilt,
+    //the graph is copied and changed rows of the matrix are laid over the loaded matrix
+    bool ApplyDeltaFromIstream(std::istream &input);
+
+    //heap bytes of the biggest parsed protobuf message, it is released after deserialization
+    size_t GetDatabaseMemoryUsage() const
+    {
+        return database_memory_usage_;
+    }
+
+    //check of the routes matrix of a flat snapshot that goes on after loading, nullptr for other formats
+    std::shared_ptr<const flat_snapshot::BackgroundVerification> GetBackgroundVerification() const
+    {
+        return background_verification_;
+    }
+
 private:
-    void DeserializeTransportDatabase(transport_catalogue_serialize::TransportDatabase database);
+    enum class ChunkStatus
+    {
+        OK,
+        END,
+        BROKEN
+    };
+
+    //rows of the matrix decoded from one chunk
+    struct RowsBlockInfo
+    {
+        size_t first_row;
+        size_t rows_count;
+        size_t memory_usage;
+    };
+
+    static ChunkStatus ReadChunk(google::protobuf::io::ZeroCopyInputStream &input, std::string &chunk_bytes);
+
+    //number of the oneof field the chunk holds
+    static int GetChunkField(const std::string &chunk_bytes);
+
+    //throws std::runtime_error if the block is broken
+    RowsBlockInfo DeserializeRoutesRowsChunk(const std::string &chunk_bytes, graph::Router<double>::FlatRoutesStorage &routes_storage) const;
+
+    bool DeserializeFromStream(std::istream &input);
+
+    void DeserializeTransportDatabase(const transport_catalogue_serialize::TransportDatabase &database);
+
+    void ApplyCatalogueDelta(const transport_catalogue_serialize::CatalogueDelta &delta);
+
+    //the catalogue is loaded by the returned task, the message must live until it is done
+    std::future<void> DeserializeCatalogue(const transport_catalogue_serialize::TransportCatalogue &catalogue);
+
+    void DeserializeStops(const transport_catalogue_serialize::StopList &stop_list, CatalogueData &data);
+
+    void DeserializeDistances(const transport_catalogue_serialize::DistanceList &distance_list, CatalogueData &data) const;
+
+    void DeserializeBuses(const transport_catalogue_serialize::BusList &bus_list, CatalogueData &data);
+
+    //position of the stop in CatalogueData::stops by its id in the database
+    uint32_t GetStopPosition(size_t stop_id) const;
+
+    void DeserializeStopsIndex(const transport_catalogue_serialize::StopsIndex &stops_index);
+
+    void DeserializeStopNamesIndex(const transport_catalogue_serialize::StopNamesIndex &stop_names_index);
+
+    std::vector<std::string_view> GetStopNames() const;
+
+    static std::string_view GetSnapshotString(std::string_view strings, uint32_t offset, uint32_t size);
+
+    //the catalogue is loaded by the returned task
+    std::future<void> DeserializeSnapshotCatalogue(const flat_snapshot::SnapshotView &snapshot);
 
-    void DeserializeCatalogue(transport_catalogue_serialize::TransportCatalogue catalogue);
+    void LoadSnapshotCatalogue(const flat_snapshot::SnapshotView &snapshot, CatalogueData data);
 
-    void DeserializeStops(transport_catalogue_serialize::StopList stop_list);
+    void DeserializeSnapshotRouter(std::shared_ptr<const MappedFile> file, const flat_snapshot::SnapshotView &snapshot);
 
-    void DeserializeDistances(transport_catalogue_serialize::DistanceList distance_list);
+    svg::Color DeserializeColor(const transport_catalogue_serialize::Color &color) const;
 
-    void DeserializeBuses(transport_catalogue_serialize::BusList bus_list);
+    std::vector<graph::Edge<double>> DeserializeEdgeList(const transport_catalogue_serialize::EdgeList &deserialized_edge_list) const;
 
-    svg::Color DeserializeColor(transport_catalogue_serialize::Color color);
+    std::vector<std::vector<size_t>>
+    DeserializeIncidenceLists(const transport_catalogue_serialize::IncidenceLists &deserialized_incidence_lists) const;
 
-    std::vector<graph::Edge<double>> DeserializeEdgeList(transport_catalogue_serialize::EdgeList deserialized_edge_list) const;
+    graph::DirectedWeightedGraph<double> DeserializeGraph(const transport_catalogue_serialize::Graph &graph_settings) const;
 
-    std::vector<std::vector<size_t>> DeserializeIncidenceLists(transport_catalogue_serialize::IncidenceLists deserialized_incidence_lists) const;
+    std::shared_ptr<const graph::Router<double>::RoutesStorage>
+    DeserializeRoutesInternalData(const transport_catalogue_serialize::RoutesInternalData &deserialized_routes_internal_data) const;
 
-    graph::DirectedWeightedGraph<double> DeserializeGraph(transport_catalogue_serialize::Graph graph_settings) const;
+    void DeserializeRoutesRow(const transport_catalogue_serialize::RouteInternalDataList &deser_data_list, size_t row,
+                              graph::Router<double>::FlatRoutesStorage &routes_storage) const;
 
-    //std::vector<std::vector<std::optional<graph::Router<double>::RouteInternalData>>>
-    graph::Router<double>::RoutesInternalData DeserializeRoutesInternalData(transport_catalogue_serialize::RoutesInternalData
-                                                                                deserialized_routes_internal_data) const;
+    std::unordered_map<std::string, size_t>
+    DeserializeVertexList(const transport_catalogue_serialize::VertexInfoList &deserialized_vertex_list) const;
 
-    void DeserializeTransportRouter(transport_catalogue_serialize::Router router_settings,
+    void DeserializeTransportRouter(const transport_catalogue_serialize::Router &router_settings,
                                     std::optional<transport_router::TransportRouter> &router);
 
-    void DeserializeMapRenderer(transport_catalogue_serialize::RenderSettings deserialized_settings,
-                                renderer::MapRenderer &renderer);
+    void DeserializeMapRenderer(const transport_catalogue_serialize::RenderSettings &deserialized_settings,
+                                renderer::MapRenderer &renderer) const;
 
     TransportCatalogue &catalogue_;
     renderer::MapRenderer &renderer_;
     std::optional<transport_router::TransportRouter> &router_;
     std::unordered_map<size_t, std::string> id_to_stop_name_;
     std::unordered_map<size_t, std::string> id_to_bus_name_;
+    std::unordered_map<size_t, uint32_t> stop_id_to_position_;
+    std::vector<geo::Coordinates> stops_coordinates_;
+    size_t database_memory_usage_ = 0;
+    std::shared_ptr<const flat_snapshot::BackgroundVerification> background_verification_;
 };
 } // namespace serialization
 } //namespace transport_catalogue
\ No newline at end of file
@@ -0,0 +1,311 @@
+#include "spatial_index.h"
+#include "geo.h"
+#include "memory_usage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace transport_catalogue
+{
+namespace spatial_index
+{
+
+namespace
+{
+const uint32_t MAX_GRID_SIDE = 1u << 12;
+const double MIN_STEP = 1e-7;
+
+//position of the cell (x, y) on the Hilbert curve filling side * side grid
+uint32_t HilbertIndex(uint32_t side, uint32_t x, uint32_t y)
+{
+    uint32_t index = 0;
+    for (uint32_t s = side / 2; s > 0; s /= 2)
+    {
+        const uint32_t rx = (x & s) > 0;
+        const uint32_t ry = (y & s) > 0;
+        index += s * s * ((3 * rx) ^ ry);
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                x = side - 1 - x;
+                y = side - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return index;
+}
+
+uint32_t ChooseGridSide(size_t stops_count)
+{
+    uint32_t side = 1;
+    //about two stops per cell
+    while (side < MAX_GRID_SIDE && static_cast<size_t>(side) * side * 2 < stops_count)
+    {
+        side *= 2;
+    }
+    return side;
+}
+
+uint32_t ToCell(double value, double min_value, double step, uint32_t side)
+{
+    const double cell = std::floor((value - min_value) / step);
+    if (cell < 0)
+    {
+        return 0;
+    }
+    if (cell >= side)
+    {
+        return side - 1;
+    }
+    return static_cast<uint32_t>(cell);
+}
+
+void SortByDistance(std::vector<NearestStop> &stops, size_t count)
+{
+    auto compare = [](const NearestStop &lhs, const NearestStop &rhs)
+    {
+        return lhs.distance < rhs.distance || (lhs.distance == rhs.distance && lhs.stop_id < rhs.stop_id);
+    };
+    if (count < stops.size())
+    {
+        std::partial_sort(stops.begin(), stops.begin() + count, stops.end(), compare);
+        stops.resize(count);
+    }
+    else
+    {
+        std::sort(stops.begin(), stops.end(), compare);
+    }
+}
+} // namespace
+
+StopsSpatialIndex::StopsSpatialIndex(const std::vector<geo::Coordinates> &stops_coordinates)
+{
+    data_.side = ChooseGridSide(stops_coordinates.size());
+    if (!stops_coordinates.empty())
+    {
+        const auto [bottom_it, top_it] = std::minmax_element(stops_coordinates.begin(), stops_coordinates.end(),
+                                                             [](auto lhs, auto rhs)
+                                                             { return lhs.lat < rhs.lat; });
+        const auto [left_it, right_it] = std::minmax_element(stops_coordinates.begin(), stops_coordinates.end(),
+                                                             [](auto lhs, auto rhs)
+                                                             { return lhs.lng < rhs.lng; });
+        data_.min_lat = bottom_it->lat;
+        data_.min_lng = left_it->lng;
+        data_.lat_step = std::max((top_it->lat - bottom_it->lat) / data_.side, MIN_STEP);
+        data_.lng_step = std::max((right_it->lng - left_it->lng) / data_.side, MIN_STEP);
+    }
+
+    const size_t cells_count = static_cast<size_t>(data_.side) * data_.side;
+    std::vector<uint32_t> stop_cells;
+    stop_cells.reserve(stops_coordinates.size());
+    data_.cell_offsets.assign(cells_count + 1, 0);
+    for (const auto &coordinates : stops_coordinates)
+    {
+        const auto [x, y] = GetCell(coordinates);
+        const uint32_t cell = GetCellIndex(x, y);
+        stop_cells.push_back(cell);
+        ++data_.cell_offsets[cell + 1];
+    }
+    for (size_t cell = 0; cell < cells_count; ++cell)
+    {
+        data_.cell_offsets[cell + 1] += data_.cell_offsets[cell];
+    }
+
+    std::vector<uint32_t> positions(data_.cell_offsets.begin(), data_.cell_offsets.end() - 1);
+    data_.stop_ids.resize(stops_coordinates.size());
+    coordinates_.Resize(stops_coordinates.size());
+    for (size_t stop_id = 0; stop_id < stops_coordinates.size(); ++stop_id)
+    {
+        const uint32_t position = positions[stop_cells[stop_id]]++;
+        data_.stop_ids[position] = static_cast<uint32_t>(stop_id);
+        coordinates_.Set(position, geo::PrecomputeTrig(stops_coordinates[stop_id]));
+    }
+    CalculateCellSizes();
+}
+
+StopsSpatialIndex::StopsSpatialIndex(GridData data, const std::vector<geo::Coordinates> &stops_coordinates)
+    : data_(std::move(data))
+{
+    if (data_.side == 0 || data_.cell_offsets.size() != static_cast<size_t>(data_.side) * data_.side + 1)
+    {
+        throw std::runtime_error("Broken stops spatial index");
+    }
+    //cells must cover stop_ids exactly, the database may be damaged
+    if (data_.cell_offsets.front() != 0 || data_.cell_offsets.back() != data_.stop_ids.size() ||
+        !std::is_sorted(data_.cell_offsets.begin(), data_.cell_offsets.end()))
+    {
+        throw std::runtime_error("Broken cells of stops spatial index");
+    }
+    coordinates_.Reserve(data_.stop_ids.size());
+    for (uint32_t stop_id : data_.stop_ids)
+    {
+        if (stop_id >= stops_coordinates.size())
+        {
+            throw std::runtime_error("Unknown stop in stops spatial index");
+        }
+        coordinates_.PushBack(geo::PrecomputeTrig(stops_coordinates[stop_id]));
+    }
+    CalculateCellSizes();
+}
+
+void StopsSpatialIndex::CalculateCellSizes()
+{
+    const double meters_in_degree = geo::DEGREES_TO_RADIANS * geo::EARTH_RADIUS;
+    const double max_lat = data_.min_lat + data_.lat_step * data_.side;
+    const double min_cos = std::min(std::cos(data_.min_lat * geo::DEGREES_TO_RADIANS),
+                                    std::cos(max_lat * geo::DEGREES_TO_RADIANS));
+    min_cell_size_ = std::min(data_.lat_step * meters_in_degree,
+                              data_.lng_step * meters_in_degree * std::max(min_cos, 0.));
+}
+
+size_t StopsSpatialIndex::GetMemoryUsage() const
+{
+    return memory_usage::OfVector(data_.cell_offsets) + memory_usage::OfVector(data_.stop_ids) +
+           coordinates_.GetCapacityBytes();
+}
+
+std::pair<uint32_t, uint32_t> StopsSpatialIndex::GetCell(geo::Coordinates point) const
+{
+    return {ToCell(point.lng, data_.min_lng, data_.lng_step, data_.side),
+            ToCell(point.lat, data_.min_lat, data_.lat_step, data_.side)};
+}
+
+uint32_t StopsSpatialIndex::GetCellIndex(uint32_t x, uint32_t y) const
+{
+    return HilbertIndex(data_.side, x, y);
+}
+
+void StopsSpatialIndex::ScanCell(uint32_t x, uint32_t y, const geo::CoordinatesTrig &point, std::vector<NearestStop> &result,
+                                 const StopFilter &filter) const
+{
+    const uint32_t cell = GetCellIndex(x, y);
+    const uint32_t begin = data_.cell_offsets[cell];
+    const uint32_t end = data_.cell_offsets[cell + 1];
+    //distances to all stops of the cell at once, the filter is usually cheaper than a distance
+    thread_local std::vector<double> distances;
+    distances.resize(end - begin);
+    geo::ComputeClosestDistances(point, coordinates_.From(begin), end - begin, distances.data());
+    for (uint32_t position = begin; position < end; ++position)
+    {
+        if (filter && !filter(data_.stop_ids[position]))
+        {
+            continue;
+        }
+        result.push_back({data_.stop_ids[position], distances[position - begin]});
+    }
+}
+
+std::vector<NearestStop> StopsSpatialIndex::FindNearest(geo::Coordinates point, size_t count,
+                                                        std::optional<double> max_distance,
+                                                        const StopFilter &filter) const
+{
+    std::vector<NearestStop> result;
+    if (count == 0 || IsEmpty())
+    {
+        return result;
+    }
+
+    const geo::CoordinatesTrig point_trig = geo::PrecomputeTrig(point);
+    const auto [center_x, center_y] = GetCell(point);
+    const int64_t side = data_.side;
+    const int64_t max_ring = std::max({static_cast<int64_t>(center_x), side - 1 - center_x,
+                                       static_cast<int64_t>(center_y), side - 1 - center_y});
+    for (int64_t ring = 0; ring <= max_ring; ++ring)
+    {
+        const int64_t left = center_x - ring;
+        const int64_t right = center_x + ring;
+        const int64_t bottom = center_y - ring;
+        const int64_t top = center_y + ring;
+        for (int64_t x = std::max<int64_t>(left, 0); x <= std::min(right, side - 1); ++x)
+        {
+            if (bottom >= 0)
+            {
+                ScanCell(x, bottom, point_trig, result, filter);
+            }
+            if (top != bottom && top < side)
+            {
+                ScanCell(x, top, point_trig, result, filter);
+            }
+        }
+        for (int64_t y = std::max<int64_t>(bottom + 1, 0); y <= std::min(top - 1, side - 1); ++y)
+        {
+            if (left >= 0)
+            {
+                ScanCell(left, y, point_trig, result, filter);
+            }
+            if (right != left && right < side)
+            {
+                ScanCell(right, y, point_trig, result, filter);
+            }
+        }
+
+        //every stop in the next rings is at least this far from the point
+        const double unseen_distance = ring * min_cell_size_;
+        if (max_distance && unseen_distance > *max_distance)
+        {
+            break;
+        }
+        if (result.size() >= count)
+        {
+            std::nth_element(result.begin(), result.begin() + (count - 1), result.end(),
+                             [](const NearestStop &lhs, const NearestStop &rhs)
+                             { return lhs.distance < rhs.distance; });
+            if (result[count - 1].distance <= unseen_distance)
+            {
+                break;
+            }
+        }
+    }
+
+    if (max_distance)
+    {
+        result.erase(std::remove_if(result.begin(), result.end(), [max_distance](const NearestStop &stop)
+                                    { return stop.distance > *max_distance; }),
+                     result.end());
+    }
+    SortByDistance(result, count);
+    return result;
+}
+
+std::vector<NearestStop> StopsSpatialIndex::FindInRadius(geo::Coordinates point, double radius) const
+{
+    std::vector<NearestStop> result;
+    if (IsEmpty() || radius < 0)
+    {
+        return result;
+    }
+
+    const double meters_in_degree = geo::DEGREES_TO_RADIANS * geo::EARTH_RADIUS;
+    const double lat_delta = radius / meters_in_degree;
+    const double cos_lat = std::cos(point.lat * geo::DEGREES_TO_RADIANS);
+    const double lng_delta = cos_lat > 1e-6 ? radius / (meters_in_degree * cos_lat)
+                                            : std::numeric_limits<double>::infinity();
+
+    const geo::CoordinatesTrig point_trig = geo::PrecomputeTrig(point);
+    const uint32_t left = ToCell(point.lng - lng_delta, data_.min_lng, data_.lng_step, data_.side);
+    const uint32_t right = ToCell(point.lng + lng_delta, data_.min_lng, data_.lng_step, data_.side);
+    const uint32_t bottom = ToCell(point.lat - lat_delta, data_.min_lat, data_.lat_step, data_.side);
+    const uint32_t top = ToCell(point.lat + lat_delta, data_.min_lat, data_.lat_step, data_.side);
+    for (uint32_t x = left; x <= right; ++x)
+    {
+        for (uint32_t y = bottom; y <= top; ++y)
+        {
+            ScanCell(x, y, point_trig, result);
+        }
+    }
+
+    result.erase(std::remove_if(result.begin(), result.end(), [radius](const NearestStop &stop)
+                                { return stop.distance > radius; }),
+                 result.end());
+    SortByDistance(result, result.size());
+    return result;
+}
+
+} // namespace spatial_index
+} // namespace transport_catalogue
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "geo.h"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace transport_catalogue
+{
+namespace spatial_index
+{
+
+struct NearestStop
+{
+    size_t stop_id;
+    double distance;
+};
+
+//packed data of the index, exactly what is stored in the database
+struct GridData
+{
+    double min_lat = 0;
+    double min_lng = 0;
+    double lat_step = 1;
+    double lng_step = 1;
+    uint32_t side = 1;
+    std::vector<uint32_t> cell_offsets;
+    std::vector<uint32_t> stop_ids;
+};
+
+//Static grid over stop coordinates. Cells are laid out along the Hilbert curve,
+//so stops of neighbouring cells are stored close to each other.
+class StopsSpatialIndex
+{
+public:
+    StopsSpatialIndex() = default;
+
+    //build index, stop_id is a position in stops_coordinates
+    explicit StopsSpatialIndex(const std::vector<geo::Coordinates> &stops_coordinates);
+
+    //restore serialized index, stops_coordinates are indexed by stop_id
+    StopsSpatialIndex(GridData data, const std::vector<geo::Coordinates> &stops_coordinates);
+
+    using StopFilter = std::function<bool(size_t stop_id)>;
+
+    //up to count nearest stops sorted by distance, optionally not further than max_distance
+    //and only among stops accepted by filter
+    std::vector<NearestStop> FindNearest(geo::Coordinates point, size_t count,
+                                         std::optional<double> max_distance = std::nullopt,
+                                         const StopFilter &filter = nullptr) const;
+
+    //all stops not further than radius sorted by distance
+    std::vector<NearestStop> FindInRadius(geo::Coordinates point, double radius) const;
+
+    const GridData &GetData() const
+    {
+        return data_;
+    }
+
+    bool IsEmpty() const
+    {
+        return data_.stop_ids.empty();
+    }
+
+    size_t GetMemoryUsage() const;
+
+private:
+    std::pair<uint32_t, uint32_t> GetCell(geo::Coordinates point) const;
+
+    uint32_t GetCellIndex(uint32_t x, uint32_t y) const;
+
+    void ScanCell(uint32_t x, uint32_t y, const geo::CoordinatesTrig &point, std::vector<NearestStop> &result,
+                  const StopFilter &filter = nullptr) const;
+
+    void CalculateCellSizes();
+
+    GridData data_;
+    //coordinates in the order of data_.stop_ids
+    geo::CoordinatesTrigArrays coordinates_;
+    double min_cell_size_ = 0;
+};
+
+} // namespace spatial_index
+} // namespace transport_catalogue
@@ -0,0 +1,251 @@
+#include "flat_snapshot.h"
+#include "frozen_catalogue.h"
+#include "json_reader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+//Queries one FrozenCatalogue from many threads at once and compares every answer
+//with the answer of another copy of the database queried from one thread.
+//Matrix rows and sections are decoded lazily, so the threads race to decode them first.
+//A flat database with a broken routes matrix must be found broken by the background check.
+
+using namespace std::literals;
+using namespace transport_catalogue;
+
+namespace
+{
+const size_t ROUNDS = 3;
+
+struct Format
+{
+    std::string_view name;
+    json::Dict settings;
+};
+
+json::Document ReadDocument(const std::string &file_name)
+{
+    std::ifstream input(file_name, std::ios::binary);
+    if (!input.is_open())
+    {
+        throw std::logic_error("Failed to open file " + file_name);
+    }
+    return json::Load(input);
+}
+
+//the make_base requests with other serialization settings
+std::string MakeBaseRequests(const json::Dict &make_base, const json::Dict &settings)
+{
+    json::Dict requests{{"serialization_settings"s, settings}};
+    for (const auto &[key, value] : make_base)
+    {
+        requests.emplace(key, value);
+    }
+    std::ostringstream output;
+    json::Print(json::Document{requests}, output);
+    return output.str();
+}
+
+json::Dict MakeRoutePoint(const json::Dict &stop)
+{
+    return {{"latitude"s, stop.at("latitude"sv).AsDouble() + 0.001},
+            {"longitude"s, stop.at("longitude"sv).AsDouble() - 0.001}};
+}
+
+//every kind of request for every bus and stop, routes between all pairs of stops
+std::vector<json::Dict> MakeStatRequests(const json::Array &base_requests)
+{
+    std::vector<json::Dict> requests;
+    auto add_request = [&requests](json::Dict request)
+    {
+        request.emplace("id"s, static_cast<int>(requests.size()));
+        requests.push_back(std::move(request));
+    };
+    std::vector<const json::Dict *> stops;
+    for (const json::Node &node : base_requests)
+    {
+        const json::Dict &request = node.AsDict();
+        const std::string name(request.at("name"sv).AsString());
+        if (request.at("type"sv).AsString() == "Bus"sv)
+        {
+            add_request({{"type"s, "Bus"s}, {"name"s, name}});
+            continue;
+        }
+        stops.push_back(&request);
+        add_request({{"type"s, "Stop"s}, {"name"s, name}});
+        add_request({{"type"s, "NearestStops"s},
+                     {"latitude"s, request.at("latitude"sv).AsDouble()},
+                     {"longitude"s, request.at("longitude"sv).AsDouble()},
+                     {"count"s, 3},
+                     {"radius"s, 2000}});
+        add_request({{"type"s, "StopSearch"s}, {"query"s, name.substr(0, 3)}});
+    }
+    add_request({{"type"s, "Bus"s}, {"name"s, "unknown bus"s}});
+    add_request({{"type"s, "Stop"s}, {"name"s, "unknown stop"s}});
+    add_request({{"type"s, "Map"s}});
+    for (const json::Dict *from : stops)
+    {
+        for (const json::Dict *to : stops)
+        {
+            add_request({{"type"s, "Route"s},
+                         {"from"s, std::string(from->at("name"sv).AsString())},
+                         {"to"s, std::string(to->at("name"sv).AsString())}});
+        }
+        add_request({{"type"s, "Route"s},
+                     {"from_point"s, MakeRoutePoint(*from)},
+                     {"to"s, std::string(stops.front()->at("name"sv).AsString())}});
+    }
+    return requests;
+}
+
+std::string Answer(const json_reader::JsonReader &reader, const FrozenCatalogue &database, const json::Dict &request)
+{
+    std::string answer;
+    json::Writer writer(answer);
+    reader.OutputRequest(database, request, writer);
+    return answer;
+}
+
+//false if an answer differs from the single threaded one
+bool CheckFormat(const Format &format, const json::Dict &make_base, const std::vector<json::Dict> &requests)
+{
+    json_reader::JsonReader reader;
+    std::istringstream input(MakeBaseRequests(make_base, format.settings));
+    reader.ReadMakeBaseRequest(input);
+    reader.SerializeCatalogue();
+
+    const std::string file_name(format.settings.at("file"sv).AsString());
+    const auto reference = FrozenCatalogue::Load(file_name);
+    std::vector<std::string> expected;
+    expected.reserve(requests.size());
+    for (const json::Dict &request : requests)
+    {
+        expected.push_back(Answer(reader, *reference, request));
+    }
+
+    //a fresh copy so that nothing is decoded before the threads start
+    const auto database = FrozenCatalogue::Load(file_name);
+    const size_t thread_count = std::clamp<size_t>(std::thread::hardware_concurrency(), 4, 16);
+    std::atomic<size_t> mismatch_count = 0;
+    std::atomic<size_t> error_count = 0;
+    std::vector<std::thread> threads;
+    for (size_t thread_index = 0; thread_index < thread_count; ++thread_index)
+    {
+        threads.emplace_back([&, thread_index]
+        {
+            //every thread starts from its own request, so different rows are decoded at once
+            const size_t first = thread_index * requests.size() / thread_count;
+            try
+            {
+                for (size_t i = 0; i < ROUNDS * requests.size(); ++i)
+                {
+                    const size_t index = (first + i) % requests.size();
+                    if (Answer(reader, *database, requests[index]) != expected[index])
+                    {
+                        ++mismatch_count;
+                    }
+                }
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << format.name << ": "sv << e.what() << std::endl;
+                ++error_count;
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    try
+    {
+        database->WaitVerified();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << format.name << ": "sv << e.what() << std::endl;
+        ++error_count;
+    }
+    std::remove(file_name.c_str());
+
+    std::cerr << format.name << ": "sv << requests.size() << " requests, "sv << thread_count << " threads, "sv
+              << mismatch_count << " mismatches, "sv << error_count << " errors"sv << std::endl;
+    return mismatch_count == 0 && error_count == 0;
+}
+
+//false if a byte flipped in the routes matrix isn't found without a query reading it
+bool CheckBrokenMatrix(const Format &format, const json::Dict &make_base)
+{
+    json_reader::JsonReader reader;
+    std::istringstream input(MakeBaseRequests(make_base, format.settings));
+    reader.ReadMakeBaseRequest(input);
+    reader.SerializeCatalogue();
+
+    const std::string file_name(format.settings.at("file"sv).AsString());
+    std::string data;
+    {
+        std::ifstream file(file_name, std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    const flat_snapshot::SnapshotView snapshot(data);
+    const flat_snapshot::SectionId matrix_id = snapshot.HasSection(flat_snapshot::SectionId::ROUTES_BLOCKS)
+                                                   ? flat_snapshot::SectionId::ROUTES_BLOCKS
+                                                   : flat_snapshot::SectionId::ROUTES_WEIGHTS;
+    const std::string_view matrix = snapshot.GetBytes(matrix_id);
+    data[matrix.data() - data.data() + matrix.size() / 2] ^= 0x55;
+    std::ofstream(file_name, std::ios::binary).write(data.data(), static_cast<std::streamsize>(data.size()));
+
+    bool is_found = false;
+    try
+    {
+        FrozenCatalogue::Load(file_name)->WaitVerified();
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << format.name << ", broken matrix: "sv << e.what() << std::endl;
+        is_found = true;
+    }
+    std::remove(file_name.c_str());
+    if (!is_found)
+    {
+        std::cerr << format.name << ", broken matrix: not found"sv << std::endl;
+    }
+    return is_found;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: frozen_catalogue_test <make_base_file>\n"sv;
+        return 1;
+    }
+    const json::Document make_base = ReadDocument(argv[1]);
+    const json::Dict &make_base_requests = make_base.GetRoot().AsDict();
+    const std::vector<json::Dict> requests = MakeStatRequests(make_base_requests.at("base_requests"sv).AsArray());
+
+    const std::vector<Format> formats{
+        {"protobuf"sv, {{"file"s, "frozen_catalogue_test.db"s}}},
+        {"flat"sv, {{"file"s, "frozen_catalogue_test_flat.db"s}, {"format"s, "flat"s}}},
+        {"flat zlib"sv, {{"file"s, "frozen_catalogue_test_z.db"s}, {"format"s, "flat"s}, {"compression"s, "zlib"s}}}};
+    bool is_ok = true;
+    for (const Format &format : formats)
+    {
+        is_ok = CheckFormat(format, make_base_requests, requests) && is_ok;
+    }
+    for (const Format &format : {formats[1], formats[2]})
+    {
+        is_ok = CheckBrokenMatrix(format, make_base_requests) && is_ok;
+    }
+    return is_ok ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+#include "geo.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string_view>
+#include <vector>
+
+//Compares both ComputeClosestDistances kernels with geo::ComputeClosestDistance over degrees and the libm functions.
+//acos turns one rounding error of a cosine near 1 or -1 into about 1e-8 rad, that is 0.1 m on the Earth,
+//so distances must agree within TOLERANCE meters; far from 0 and pi they differ by micrometers.
+
+using namespace std::literals;
+
+namespace
+{
+const double TOLERANCE = 0.25;
+const size_t RANDOM_PAIRS_COUNT = 100000;
+//the kernel from one point is checked from the first point of every block of pairs to the rest of them
+const size_t BLOCK_SIZE = 13;
+
+const double HALF_CIRCLE = std::acos(-1.) * geo::EARTH_RADIUS;
+
+struct PointsPair
+{
+    geo::Coordinates from;
+    geo::Coordinates to;
+    //known distance or a negative number if only the scalar function is the reference
+    double distance = -1;
+};
+
+std::vector<PointsPair> MakeEdgeCases()
+{
+    std::vector<PointsPair> pairs{
+        {{90, 10}, {90, -70}, 0},
+        {{-90, 0}, {-90, 180}, 0},
+        {{90, 0}, {-90, 0}, HALF_CIRCLE},
+        {{90, 45}, {0, -120}, HALF_CIRCLE / 2},
+        {{0, 0}, {0, 180}, HALF_CIRCLE},
+        {{0, 179.99}, {0, -179.99}},
+        {{43.587795, 39.716901}, {43.581969, 39.719848}},
+        {{55.611087, 37.20829}, {55.611087, 37.208291}}};
+    std::mt19937 generator(34);
+    std::uniform_real_distribution<double> latitude(-90, 90);
+    std::uniform_real_distribution<double> longitude(-180, 180);
+    //identical and antipodal points are where rounding used to give NaN
+    for (int i = 0; i < 1000; ++i)
+    {
+        const geo::Coordinates point{latitude(generator), longitude(generator)};
+        pairs.push_back({point, point, 0});
+        pairs.push_back({point, {-point.lat, point.lng > 0 ? point.lng - 180 : point.lng + 180}, HALF_CIRCLE});
+    }
+    return pairs;
+}
+
+std::vector<PointsPair> MakeRandomPairs()
+{
+    std::mt19937 generator(43);
+    std::uniform_real_distribution<double> latitude(-90, 90);
+    std::uniform_real_distribution<double> longitude(-180, 180);
+    std::uniform_real_distribution<double> shift(-0.01, 0.01);
+    std::vector<PointsPair> pairs;
+    for (size_t i = 0; i < RANDOM_PAIRS_COUNT; ++i)
+    {
+        const geo::Coordinates from{latitude(generator), longitude(generator)};
+        //half of the pairs are as close as neighbouring stops
+        const geo::Coordinates to = i % 2 == 0 ? geo::Coordinates{latitude(generator), longitude(generator)}
+                                               : geo::Coordinates{std::clamp(from.lat + shift(generator), -90., 90.),
+                                                                  from.lng + shift(generator)};
+        pairs.push_back({from, to});
+    }
+    return pairs;
+}
+
+//false if the distance doesn't match
+bool CheckDistance(std::string_view name, const PointsPair &pair, double distance, double &max_error)
+{
+    const double expected = geo::ComputeClosestDistance(pair.from, pair.to);
+    double error = std::abs(distance - expected);
+    if (pair.distance >= 0)
+    {
+        error = std::max({error, std::abs(distance - pair.distance), std::abs(expected - pair.distance)});
+    }
+    //NaN fails every comparison
+    if (!(error <= TOLERANCE))
+    {
+        std::cerr << name << ": ("sv << pair.from.lat << ", "sv << pair.from.lng << ") - ("sv << pair.to.lat << ", "sv
+                  << pair.to.lng << "): "sv << distance << " instead of "sv << expected << std::endl;
+        return false;
+    }
+    max_error = std::max(max_error, error);
+    return true;
+}
+
+//returns the number of failed pairs
+size_t Check(std::string_view name, const std::vector<PointsPair> &pairs)
+{
+    geo::CoordinatesTrigArrays from;
+    geo::CoordinatesTrigArrays to;
+    for (const PointsPair &pair : pairs)
+    {
+        from.PushBack(geo::PrecomputeTrig(pair.from));
+        to.PushBack(geo::PrecomputeTrig(pair.to));
+    }
+    std::vector<double> distances(pairs.size());
+    geo::ComputeClosestDistances(from.From(0), to.From(0), pairs.size(), distances.data());
+
+    size_t fail_count = 0;
+    double max_error = 0;
+    for (size_t i = 0; i < pairs.size(); ++i)
+    {
+        fail_count += CheckDistance(name, pairs[i], distances[i], max_error) ? 0 : 1;
+    }
+
+    //known distances hold only for the pairs themselves
+    double max_error_from_point = 0;
+    for (size_t first = 0; first < pairs.size(); first += BLOCK_SIZE)
+    {
+        const size_t count = std::min(BLOCK_SIZE, pairs.size() - first);
+        geo::ComputeClosestDistances(geo::PrecomputeTrig(pairs[first].from), to.From(first), count, distances.data());
+        for (size_t i = 0; i < count; ++i)
+        {
+            const PointsPair &pair = pairs[first + i];
+            const PointsPair from_first{pairs[first].from, pair.to, i == 0 ? pair.distance : -1};
+            fail_count += CheckDistance(name, from_first, distances[i], max_error_from_point) ? 0 : 1;
+        }
+    }
+    std::cerr << name << ": "sv << pairs.size() << " pairs, max error "sv << max_error << " m, from one point "sv
+              << max_error_from_point << " m, "sv << fail_count << " failed"sv << std::endl;
+    return fail_count;
+}
+} // namespace
+
+int main()
+{
+    const size_t fail_count = Check("edge cases"sv, MakeEdgeCases()) + Check("random"sv, MakeRandomPairs());
+    return fail_count == 0 ? 0 : 1;
+}
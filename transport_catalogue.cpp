@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <iostream>
 #include <set>
+#include <stdexcept>
 #include <string>
 #include <string_view>
 #include <unordered_map>
@@ -16,8 +17,103 @@ namespace transport_catalogue
 using namespace domain;
 void TransportCatalogue::AddStop(std::string stop_name, geo::Coordinates coordinates)
 {
-    all_stops_.push_back(Stop(stop_name, coordinates));
+    all_stops_.push_back(Stop(std::move(stop_name), coordinates, all_stops_.size()));
     stop_name_to_stop_[all_stops_.back().GetName()] = &all_stops_.back();
+    id_to_stop_.push_back(&all_stops_.back());
+}
+
+void TransportCatalogue::AddBus(std::string bus_name, std::vector<StopPtr> stops, bool is_circle)
+{
+    if (!is_circle && stops.size() > 1)
+    {
+        //there and back again
+        stops.reserve(stops.size() * 2 - 1);
+        for (size_t i = stops.size() - 1; i > 0; i--)
+        {
+            stops.push_back(stops[i - 1]);
+        }
+    }
+    all_buses_.emplace_back(bus_name, std::move(stops), is_circle);
+    BusPtr current_bus = &all_buses_.back();
+    bus_name_to_bus_[current_bus->GetName()] = current_bus;
+    all_buses_names_.insert(current_bus->GetName());
+}
+
+void TransportCatalogue::BulkLoad(CatalogueData data)
+{
+    if (!all_stops_.empty() || !all_buses_.empty())
+    {
+        throw std::logic_error("Bulk load into non-empty catalogue");
+    }
+
+    const size_t stops_count = data.stops.size();
+    id_to_stop_.reserve(stops_count);
+    for (auto &stop : data.stops)
+    {
+        AddStop(std::move(stop.name), stop.coordinates);
+    }
+
+    auto get_stop = [this, stops_count](uint32_t stop_id)
+    {
+        if (stop_id >= stops_count)
+        {
+            throw std::logic_error("Unknown stop id " + std::to_string(stop_id));
+        }
+        return id_to_stop_[stop_id];
+    };
+
+    distance_between_stops_.reserve(data.distances.size());
+    for (const auto &distance : data.distances)
+    {
+        distance_between_stops_[{get_stop(distance.from_stop_id), get_stop(distance.to_stop_id)}] = distance.distance;
+    }
+
+    bus_name_to_bus_.reserve(data.buses.size());
+    for (auto &bus : data.buses)
+    {
+        std::vector<StopPtr> bus_stops;
+        bus_stops.reserve(bus.is_circle ? bus.stop_ids.size() : bus.stop_ids.size() * 2);
+        for (uint32_t stop_id : bus.stop_ids)
+        {
+            bus_stops.push_back(get_stop(stop_id));
+        }
+        AddBus(std::move(bus.name), std::move(bus_stops), bus.is_circle);
+    }
+
+    BuildStopToBusesIndex();
+}
+
+CatalogueData TransportCatalogue::GetData() const
+{
+    CatalogueData data;
+    data.stops.reserve(all_stops_.size());
+    for (const Stop &stop : all_stops_)
+    {
+        data.stops.push_back({stop.GetName(), stop.GetCoordinates()});
+    }
+
+    data.buses.reserve(all_buses_.size());
+    for (const Bus &bus : all_buses_)
+    {
+        CatalogueData::BusData &bus_data = data.buses.emplace_back();
+        bus_data.name = bus.GetName();
+        bus_data.is_circle = bus.IsCircle();
+        //the way back of a linear bus is added by AddBus
+        const std::vector<StopPtr> &stops = bus.GetStops();
+        const size_t forward_stops = bus.IsCircle() ? stops.size() : (stops.size() + 1) / 2;
+        bus_data.stop_ids.reserve(forward_stops);
+        for (size_t i = 0; i < forward_stops; i++)
+        {
+            bus_data.stop_ids.push_back(static_cast<uint32_t>(stops[i]->GetId()));
+        }
+    }
+
+    data.distances.reserve(distance_between_stops_.size());
+    for (const auto &[stops, distance] : distance_between_stops_)
+    {
+        data.distances.push_back({static_cast<uint32_t>(stops.first->GetId()), static_cast<uint32_t>(stops.second->GetId()), distance});
+    }
+    return data;
 }
 
 void TransportCatalogue::AddStopsDistance(const std::string &from_stop, const std::string &to_stop, int distance)
@@ -37,6 +133,25 @@ StopPtr TransportCatalogue::GetStop(std::string_view stop) const
     return iter->second;
 }
 
+StopPtr TransportCatalogue::GetStopById(size_t stop_id) const
+{
+    if (stop_id >= id_to_stop_.size())
+    {
+        return nullptr;
+    }
+    return id_to_stop_[stop_id];
+}
+
+void TransportCatalogue::SetStopsIndex(spatial_index::StopsSpatialIndex stops_index)
+{
+    stops_index_ = std::move(stops_index);
+}
+
+void TransportCatalogue::SetStopNamesIndex(name_search::StopNamesIndex stop_names_index)
+{
+    stop_names_index_ = std::move(stop_names_index);
+}
+
 BusPtr TransportCatalogue::GetBus(std::string_view bus) const
 {
     auto iter = bus_name_to_bus_.find(bus);
@@ -48,27 +163,66 @@ BusPtr TransportCatalogue::GetBus(std::string_view bus) const
     return iter->second;
 }
 
-const std::unordered_map<Stop *, std::set<std::string_view>> &TransportCatalogue::GetAllStopToBuses() const
+void TransportCatalogue::BuildStopToBusesIndex()
 {
-    return stop_to_buses_;
+    bus_names_by_id_.assign(all_buses_names_.begin(), all_buses_names_.end());
+
+    //buses are visited in order of ids, so the buses of every stop come out sorted
+    std::vector<uint32_t> last_bus_of_stop(all_stops_.size(), UINT32_MAX);
+    auto for_each_bus_stop = [this, &last_bus_of_stop](auto action)
+    {
+        std::fill(last_bus_of_stop.begin(), last_bus_of_stop.end(), UINT32_MAX);
+        for (uint32_t bus_id = 0; bus_id < bus_names_by_id_.size(); ++bus_id)
+        {
+            for (const StopPtr stop : GetBus(bus_names_by_id_[bus_id])->GetStops())
+            {
+                if (last_bus_of_stop[stop->GetId()] != bus_id)
+                {
+                    last_bus_of_stop[stop->GetId()] = bus_id;
+                    action(stop->GetId(), bus_id);
+                }
+            }
+        }
+    };
+
+    stop_buses_offsets_.assign(all_stops_.size() + 1, 0);
+    for_each_bus_stop([this](size_t stop_id, uint32_t)
+                      { ++stop_buses_offsets_[stop_id + 1]; });
+    using_stops_count_ = 0;
+    for (size_t stop_id = 0; stop_id < all_stops_.size(); ++stop_id)
+    {
+        if (stop_buses_offsets_[stop_id + 1] > 0)
+        {
+            ++using_stops_count_;
+        }
+        stop_buses_offsets_[stop_id + 1] += stop_buses_offsets_[stop_id];
+    }
+
+    bus_ids_through_stops_.resize(stop_buses_offsets_.back());
+    std::vector<uint32_t> positions(stop_buses_offsets_.begin(), stop_buses_offsets_.end() - 1);
+    for_each_bus_stop([this, &positions](size_t stop_id, uint32_t bus_id)
+                      { bus_ids_through_stops_[positions[stop_id]++] = bus_id; });
 }
 
-const std::optional<std::set<std::string_view>> TransportCatalogue::GetBusesThroughStop(std::string_view stop_name) const
+std::optional<StopBusesRange> TransportCatalogue::GetBusesThroughStop(std::string_view stop_name) const
 {
     domain::StopPtr stop = GetStop(stop_name);
     if (stop == nullptr)
     {
         return std::nullopt;
     }
-    const auto &stop_to_buses = GetAllStopToBuses();
-    auto iter = stop_to_buses.find(stop);
+    return GetBusesThroughStop(stop);
+}
 
-    if (iter == stop_to_buses.end())
+StopBusesRange TransportCatalogue::GetBusesThroughStop(const StopPtr stop) const
+{
+    const size_t stop_id = stop->GetId();
+    if (stop_id + 1 >= stop_buses_offsets_.size())
     {
-        const static std::set<std::string_view> empty_set;
-        return empty_set;
+        return {nullptr, nullptr, nullptr};
     }
-    return iter->second;
+    const uint32_t *bus_ids = bus_ids_through_stops_.data();
+    return {bus_ids + stop_buses_offsets_[stop_id], bus_ids + stop_buses_offsets_[stop_id + 1], bus_names_by_id_.data()};
 }
 
 int TransportCatalogue::CalculateRoute(const BusPtr bus) const
@@ -110,17 +264,47 @@ int TransportCatalogue::GetDistanceBetweenStops(const StopPtr from, const StopPt
 
 size_t TransportCatalogue::GetUsingStopsCount() const
 {
-    return stop_to_buses_.size();
+    return using_stops_count_;
 }
 
 std::set<std::string_view> TransportCatalogue::GetAllUsingStops() const
 {
-    return using_stops_;
+    std::set<std::string_view> result;
+    for (const StopPtr stop : id_to_stop_)
+    {
+        if (!GetBusesThroughStop(stop).empty())
+        {
+            result.insert(stop->GetName());
+        }
+    }
+    return result;
 }
 
-std::deque<domain::Bus> TransportCatalogue::GetAllBuses() const
+memory_usage::MemoryUsage TransportCatalogue::GetMemoryUsage() const
 {
-    return all_buses_;
+    using namespace memory_usage;
+
+    size_t stops = OfDeque(all_stops_);
+    for (const Stop &stop : all_stops_)
+    {
+        stops += OfString(stop.GetName());
+    }
+    size_t buses = OfDeque(all_buses_);
+    for (const Bus &bus : all_buses_)
+    {
+        buses += OfString(bus.GetName()) + OfVector(bus.GetStops());
+    }
+
+    return {
+        {"stops", stops},
+        {"buses", buses},
+        {"distances", OfHashTable(distance_between_stops_)},
+        {"names_lookup", OfTree(stop_name_to_stop_) + OfHashTable(bus_name_to_bus_) + OfTree(all_buses_names_) +
+                             OfVector(id_to_stop_)},
+        {"stop_to_buses", OfVector(stop_buses_offsets_) + OfVector(bus_ids_through_stops_) + OfVector(bus_names_by_id_)},
+        {"spatial_index", stops_index_.GetMemoryUsage()},
+        {"names_index", stop_names_index_.GetMemoryUsage()},
+    };
 }
 
 } //namespace transport_catalogue
\ No newline at end of file
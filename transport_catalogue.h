@@ -1,11 +1,17 @@
 #pragma once
 
 #include "domain.h"
+#include "memory_usage.h"
+#include "name_search.h"
+#include "spatial_index.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <deque>
 #include <iostream>
+#include <iterator>
 #include <map>
+#include <optional>
 #include <set>
 #include <string>
 #include <string_view>
@@ -17,39 +23,134 @@
 namespace transport_catalogue
 {
 
+//names of buses passing through a stop in lexicographical order, a view into the catalogue index
+class StopBusesRange
+{
+public:
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const std::string_view *;
+        using reference = const std::string_view &;
+
+        Iterator(const uint32_t *bus_id, const std::string_view *bus_names)
+            : bus_id_(bus_id), bus_names_(bus_names)
+        {
+        }
+
+        reference operator*() const
+        {
+            return bus_names_[*bus_id_];
+        }
+
+        Iterator &operator++()
+        {
+            ++bus_id_;
+            return *this;
+        }
+
+        bool operator==(const Iterator &other) const
+        {
+            return bus_id_ == other.bus_id_;
+        }
+
+        bool operator!=(const Iterator &other) const
+        {
+            return bus_id_ != other.bus_id_;
+        }
+
+    private:
+        const uint32_t *bus_id_;
+        const std::string_view *bus_names_;
+    };
+
+    StopBusesRange(const uint32_t *begin, const uint32_t *end, const std::string_view *bus_names)
+        : begin_(begin), end_(end), bus_names_(bus_names)
+    {
+    }
+
+    Iterator begin() const
+    {
+        return {begin_, bus_names_};
+    }
+
+    Iterator end() const
+    {
+        return {end_, bus_names_};
+    }
+
+    size_t size() const
+    {
+        return end_ - begin_;
+    }
+
+    bool empty() const
+    {
+        return begin_ == end_;
+    }
+
+private:
+    const uint32_t *begin_;
+    const uint32_t *end_;
+    const std::string_view *bus_names_;
+};
+
+//whole catalogue content for TransportCatalogue::BulkLoad, stops are referenced by position in stops
+struct CatalogueData
+{
+    struct StopData
+    {
+        std::string name;
+        geo::Coordinates coordinates;
+    };
+
+    struct BusData
+    {
+        std::string name;
+        std::vector<uint32_t> stop_ids;
+        bool is_circle = false;
+    };
+
+    struct DistanceData
+    {
+        uint32_t from_stop_id;
+        uint32_t to_stop_id;
+        int distance;
+    };
+
+    std::vector<StopData> stops;
+    std::vector<BusData> buses;
+    std::vector<DistanceData> distances;
+};
+
 class TransportCatalogue
 {
 public:
     template <typename Container>
     void AddBus(std::string bus_name, Container stops, bool is_circle = false)
     {
-        domain::Bus tmp_bus(bus_name, is_circle);
-        all_buses_.emplace_back(std::move(tmp_bus));
-        domain::BusPtr current_bus = &all_buses_.back();
-        bus_name_to_bus_[current_bus->GetName()] = current_bus;
-        all_buses_names_.insert(current_bus->GetName());
+        std::vector<domain::StopPtr> bus_stops;
+        bus_stops.reserve(is_circle ? stops.size() : stops.size() * 2);
         for (std::string_view stop_name : stops)
         {
-            if (stop_name_to_stop_.count(stop_name))
-            {
-                stop_to_buses_[stop_name_to_stop_.at(stop_name)].insert(current_bus->GetName());
-                auto stop = stop_name_to_stop_.at(stop_name);
-                using_stops_.insert(stop->GetName());
-
-                current_bus->AddStop(stop);
-            }
-        }
-        if (!is_circle)
-        {
-            for (int i = stops.size() - 2; i >= 0; i--)
+            const auto iter = stop_name_to_stop_.find(stop_name);
+            if (iter != stop_name_to_stop_.end())
             {
-                auto stop = stop_name_to_stop_.at(stops[i]);
-                using_stops_.insert(stop->GetName());
-                current_bus->AddStop(stop);
+                bus_stops.push_back(iter->second);
             }
         }
+        AddBus(std::move(bus_name), std::move(bus_stops), is_circle);
     }
 
+    //fills empty catalogue at once and builds all indices, throws std::logic_error on wrong stop ids
+    void BulkLoad(CatalogueData data);
+
+    //content in the form of BulkLoad, stops and buses keep their order and buses only their forward stops
+    CatalogueData GetData() const;
+
     void AddStop(std::string stop_name, geo::Coordinates coordinates);
 
     void AddStopsDistance(const std::string &from_stop, const std::string &to_stop, int distance);
@@ -57,21 +158,30 @@ public:
     //get Stop by stop_name
     domain::StopPtr GetStop(std::string_view stop_name) const;
 
+    //get Stop by id, ids are given in order of adding stops
+    domain::StopPtr GetStopById(size_t stop_id) const;
+
     //get bus by bus_name
     domain::BusPtr GetBus(std::string_view bus_name) const;
 
-    const std::set<std::string_view> &GetAllBusesNames() const
+    void SetStopsIndex(spatial_index::StopsSpatialIndex stops_index);
+
+    const spatial_index::StopsSpatialIndex &GetStopsIndex() const
     {
-        return all_buses_names_;
+        return stops_index_;
     }
 
-    //return std::set buses passing through the stop_name
-    const std::set<std::string_view> &GetStopInfo(std::string_view stop_name) const;
+    void SetStopNamesIndex(name_search::StopNamesIndex stop_names_index);
 
-    //return std::set buses passing through the Stop
-    const std::set<std::string_view> &GetStopInfo(domain::Stop *stop) const;
+    const name_search::StopNamesIndex &GetStopNamesIndex() const
+    {
+        return stop_names_index_;
+    }
 
-    const std::unordered_map<domain::Stop *, std::set<std::string_view>> &GetAllStopToBuses() const;
+    const std::set<std::string_view> &GetAllBusesNames() const
+    {
+        return all_buses_names_;
+    }
 
     const std::map<std::string_view, domain::StopPtr> &GetAllStops() const
     {
@@ -81,17 +191,43 @@ public:
     //calculate all distances between stops in bus route
     int CalculateRoute(const domain::BusPtr bus) const;
 
-    const std::optional<std::set<std::string_view>> GetBusesThroughStop(std::string_view stop_name) const;
+    //builds index of buses passing through stops, must be called after the last AddBus
+    void BuildStopToBusesIndex();
+
+    //std::nullopt if there is no such stop
+    std::optional<StopBusesRange> GetBusesThroughStop(std::string_view stop_name) const;
+
+    StopBusesRange GetBusesThroughStop(const domain::StopPtr stop) const;
 
     size_t GetUsingStopsCount() const;
 
-    std::deque<domain::Bus> GetAllBuses() const;
+    //buses in order of adding
+    const std::deque<domain::Bus> &GetAllBuses() const
+    {
+        return all_buses_;
+    }
+
+    //calls action(from, to, distance) for every distance given to the catalogue
+    template <typename Action>
+    void ForEachDistance(Action action) const
+    {
+        for (const auto &[stops, distance] : distance_between_stops_)
+        {
+            action(stops.first, stops.second, distance);
+        }
+    }
 
     int GetDistanceBetweenStops(std::string_view from, std::string_view to) const;
 
     std::set<std::string_view> GetAllUsingStops() const;
 
+    //approximate heap bytes of every table
+    memory_usage::MemoryUsage GetMemoryUsage() const;
+
 private:
+    //stops are given in the forward direction only
+    void AddBus(std::string bus_name, std::vector<domain::StopPtr> stops, bool is_circle);
+
     int GetDistanceBetweenStops(const domain::StopPtr from, const domain::StopPtr to) const;
 
     struct PairHasher
@@ -109,11 +245,18 @@ private:
 
     std::deque<domain::Bus> all_buses_;
     std::deque<domain::Stop> all_stops_;
+    std::vector<domain::StopPtr> id_to_stop_;
+    spatial_index::StopsSpatialIndex stops_index_;
+    name_search::StopNamesIndex stop_names_index_;
     std::set<std::string_view> all_buses_names_;
-    std::set<std::string_view> using_stops_;
     std::map<std::string_view, domain::StopPtr> stop_name_to_stop_;
     std::unordered_map<std::string_view, domain::BusPtr> bus_name_to_bus_;
-    std::unordered_map<domain::Stop *, std::set<std::string_view>> stop_to_buses_;
+    //CSR index: buses of stop with id i are bus_ids_through_stops_[stop_buses_offsets_[i]..stop_buses_offsets_[i + 1]),
+    //bus ids are positions in the sorted bus_names_by_id_
+    std::vector<uint32_t> stop_buses_offsets_;
+    std::vector<uint32_t> bus_ids_through_stops_;
+    std::vector<std::string_view> bus_names_by_id_;
+    size_t using_stops_count_ = 0;
     std::unordered_map<std::pair<const domain::StopPtr, const domain::StopPtr>, int, PairHasher> distance_between_stops_;
 };
 } //namespace transport_catalogue
\ No newline at end of file
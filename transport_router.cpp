@@ -2,6 +2,8 @@
 #include "router.h"
 #include "transport_catalogue.h"
 
+#include <algorithm>
+#include <limits>
 #include <memory>
 #include <string>
 #include <string_view>
@@ -13,6 +15,67 @@ namespace transport_catalogue
 namespace transport_router
 {
 
+namespace
+{
+const size_t NO_ID = std::numeric_limits<size_t>::max();
+
+RouteItem MakeRouteItem(const graph::Edge<double> &edge)
+{
+    return {edge.type, edge.bus_name, edge.stop_name, edge.stop_to_name, edge.span_count, edge.wait_time, edge.time_in_road};
+}
+
+//ids[i] is the id of the i-th item in the base or NO_ID; an item keeps its base id if it is less than id_count,
+//other items take the free ids in order, so the result is distinct ids in [0, id_count), id_count >= ids.size()
+std::vector<size_t> KeepBaseIds(std::vector<size_t> ids, size_t id_count)
+{
+    std::vector<bool> is_taken(id_count);
+    for (size_t id : ids)
+    {
+        if (id < id_count)
+        {
+            is_taken[id] = true;
+        }
+    }
+    size_t free_id = 0;
+    for (size_t &id : ids)
+    {
+        if (id < id_count)
+        {
+            continue;
+        }
+        while (is_taken[free_id])
+        {
+            free_id++;
+        }
+        id = free_id;
+        is_taken[free_id] = true;
+    }
+    return ids;
+}
+
+//all fields of the edge, equal edges have equal keys
+std::string GetEdgeKey(const graph::Edge<double> &edge)
+{
+    std::string key;
+    key.reserve(edge.bus_name.size() + edge.stop_name.size() + edge.stop_to_name.size() + 64);
+    key.append(edge.bus_name).push_back('\0');
+    key.append(edge.stop_name).push_back('\0');
+    key.append(edge.stop_to_name).push_back('\0');
+    auto append_bytes = [&key](const auto &value)
+    {
+        key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    };
+    append_bytes(edge.type);
+    append_bytes(edge.span_count);
+    append_bytes(edge.wait_time);
+    append_bytes(edge.time_in_road);
+    append_bytes(edge.from);
+    append_bytes(edge.to);
+    append_bytes(edge.weight);
+    return key;
+}
+} // namespace
+
 std::optional<RouteInfo> TransportRouter::BuildRoute(const std::string& stop_from, const std::string& stop_to) const
 {
     auto stop_from_iter = stops_to_vertex_id_.find(stop_from);
@@ -37,14 +100,97 @@ std::optional<RouteInfo> TransportRouter::BuildRoute(const std::string& stop_fro
     }
     RouteInfo result;
     result.total_time = info->weight;
+    result.items.reserve(info->edges.size());
     for (size_t edge_id : info->edges)
     {
-        const auto &edge = graph_.GetEdge(edge_id);
-        result.items.push_back(edge);
+        result.items.push_back(MakeRouteItem(graph_.GetEdge(edge_id)));
     }
     return result;
 }
 
+std::optional<RouteInfo> TransportRouter::BuildRoute(const std::vector<WalkingStop> &from_stops,
+                                                     const std::vector<WalkingStop> &to_stops,
+                                                     std::optional<double> direct_distance) const
+{
+    using Endpoint = graph::Router<double>::RouteEndpoint;
+    auto make_endpoints = [this](const std::vector<WalkingStop> &stops)
+    {
+        std::vector<Endpoint> endpoints;
+        endpoints.reserve(stops.size());
+        for (const WalkingStop &stop : stops)
+        {
+            const auto iter = stops_to_vertex_id_.find(std::string(stop.stop_name));
+            if (iter == stops_to_vertex_id_.end())
+            {
+                throw std::logic_error("Stop " + std::string(stop.stop_name) + " is not in the routing graph");
+            }
+            endpoints.push_back({iter->second, CalculateTime(stop.distance, walk_velocity_)});
+        }
+        return endpoints;
+    };
+    const std::vector<Endpoint> sources = make_endpoints(from_stops);
+    const std::vector<Endpoint> targets = make_endpoints(to_stops);
+
+    const auto info = router_->BuildRoute(sources, targets);
+    const std::optional<double> direct_time = direct_distance ? std::optional(CalculateTime(*direct_distance, walk_velocity_))
+                                                              : std::nullopt;
+    if (direct_time && (!info || *direct_time <= info->route.weight))
+    {
+        return RouteInfo{*direct_time, {MakeWalkItem({}, {}, *direct_distance)}};
+    }
+    if (!info)
+    {
+        return std::nullopt;
+    }
+
+    auto find_stop = [](const std::vector<WalkingStop> &stops, const std::vector<Endpoint> &endpoints, graph::VertexId vertex)
+    {
+        const auto iter = std::find_if(endpoints.begin(), endpoints.end(), [vertex](const Endpoint &endpoint)
+                                       { return endpoint.vertex == vertex; });
+        return stops[iter - endpoints.begin()];
+    };
+    const WalkingStop &from_stop = find_stop(from_stops, sources, info->from);
+    const WalkingStop &to_stop = find_stop(to_stops, targets, info->to);
+
+    RouteInfo result;
+    result.total_time = info->route.weight;
+    result.items.reserve(info->route.edges.size() + 2);
+    if (from_stop.distance > 0)
+    {
+        result.items.push_back(MakeWalkItem({}, from_stop.stop_name, from_stop.distance));
+    }
+    for (size_t edge_id : info->route.edges)
+    {
+        result.items.push_back(MakeRouteItem(graph_.GetEdge(edge_id)));
+    }
+    if (to_stop.distance > 0)
+    {
+        result.items.push_back(MakeWalkItem(to_stop.stop_name, {}, to_stop.distance));
+    }
+    return result;
+}
+
+graph::Edge<double> TransportRouter::MakeWalkEdge(std::string_view stop_from, std::string_view stop_to, double distance) const
+{
+    graph::Edge<double> walk_edge;
+    walk_edge.type = graph::EdgeType::WALK;
+    walk_edge.stop_name = stop_from;
+    walk_edge.stop_to_name = stop_to;
+    walk_edge.time_in_road = CalculateTime(distance, walk_velocity_);
+    walk_edge.weight = walk_edge.time_in_road;
+    return walk_edge;
+}
+
+RouteItem TransportRouter::MakeWalkItem(std::string_view stop_from, std::string_view stop_to, double distance) const
+{
+    RouteItem walk_item;
+    walk_item.type = graph::EdgeType::WALK;
+    walk_item.stop_name = stop_from;
+    walk_item.stop_to_name = stop_to;
+    walk_item.time_in_road = CalculateTime(distance, walk_velocity_);
+    return walk_item;
+}
+
 double TransportRouter::KilometersToMeters(double velocity) const
 {
     return velocity * 1000.0 / 60.0;
@@ -79,6 +225,39 @@ void TransportRouter::FinishStopRoute(size_t stop_from_pos, const std::vector<st
     }
 }
 
+void TransportRouter::AddWalkingTransfers(const std::unordered_map<std::string, geo::Coordinates> &stops_coordinates,
+                                          double radius)
+{
+    if (radius <= 0)
+    {
+        return;
+    }
+    //index over the graph vertices, so stop ids of the index are vertex ids
+    std::vector<geo::Coordinates> vertex_coordinates(graph_.GetVertexCount());
+    for (const auto &[stop_name, vertex_id] : stops_to_vertex_id_)
+    {
+        vertex_coordinates[vertex_id] = stops_coordinates.at(stop_name);
+    }
+    const spatial_index::StopsSpatialIndex vertex_index(vertex_coordinates);
+
+    for (size_t vertex_from = 0; vertex_from < vertex_coordinates.size(); ++vertex_from)
+    {
+        for (const auto &nearest_stop : vertex_index.FindInRadius(vertex_coordinates[vertex_from], radius))
+        {
+            if (nearest_stop.stop_id == vertex_from)
+            {
+                continue;
+            }
+            graph::Edge<double> walk_edge = MakeWalkEdge(vertex_ids_to_stop_.at(vertex_from),
+                                                         vertex_ids_to_stop_.at(nearest_stop.stop_id),
+                                                         nearest_stop.distance);
+            walk_edge.from = vertex_from;
+            walk_edge.to = nearest_stop.stop_id;
+            graph_.AddEdge(std::move(walk_edge));
+        }
+    }
+}
+
 void TransportRouter::CreateMap()
 {
     size_t current_stop_id = 0;
@@ -90,5 +269,130 @@ void TransportRouter::CreateMap()
     }
 }
 
+void TransportRouter::KeepIdsOf(const TransportRouter &base_router)
+{
+    const std::unordered_map<std::string, size_t> &base_stops_to_vertex_id = base_router.GetStopsToId();
+    std::vector<size_t> vertex_ids(graph_.GetVertexCount(), NO_ID);
+    for (const auto &[stop_name, vertex_id] : stops_to_vertex_id_)
+    {
+        if (const auto iter = base_stops_to_vertex_id.find(stop_name); iter != base_stops_to_vertex_id.end())
+        {
+            vertex_ids[vertex_id] = iter->second;
+        }
+    }
+    vertex_ids = KeepBaseIds(std::move(vertex_ids), vertex_ids.size());
+    vertex_ids_to_stop_.clear();
+    for (auto &[stop_name, vertex_id] : stops_to_vertex_id_)
+    {
+        vertex_id = vertex_ids[vertex_id];
+        vertex_ids_to_stop_[vertex_id] = *using_stops_.find(stop_name);
+    }
+
+    std::vector<graph::Edge<double>> edges = graph_.GetEdges();
+    for (graph::Edge<double> &edge : edges)
+    {
+        edge.from = vertex_ids[edge.from];
+        edge.to = vertex_ids[edge.to];
+    }
+    //an edge equal to an edge of the base takes its id, equal edges of the base are taken one by one
+    std::unordered_map<std::string, std::vector<size_t>> base_edge_ids;
+    const std::vector<graph::Edge<double>> &base_edges = base_router.GetGraph().GetEdges();
+    for (size_t edge_id = base_edges.size(); edge_id > 0; edge_id--)
+    {
+        base_edge_ids[GetEdgeKey(base_edges[edge_id - 1])].push_back(edge_id - 1);
+    }
+    std::vector<size_t> edge_ids(edges.size(), NO_ID);
+    for (size_t i = 0; i < edges.size(); i++)
+    {
+        const auto iter = base_edge_ids.find(GetEdgeKey(edges[i]));
+        if (iter != base_edge_ids.end() && !iter->second.empty())
+        {
+            edge_ids[i] = iter->second.back();
+            iter->second.pop_back();
+        }
+    }
+    //ids of removed edges are not given to other edges, as routes through a moved edge would change;
+    //they are kept by placeholders that are in no incidence list
+    const size_t edge_count = graph_.GetVertexCount() > 0 ? std::max(edges.size(), base_edges.size()) : edges.size();
+    edge_ids = KeepBaseIds(std::move(edge_ids), edge_count);
+
+    graph::Edge<double> placeholder = MakeWalkEdge(vertex_ids_to_stop_[0], vertex_ids_to_stop_[0], 0);
+    placeholder.from = 0;
+    placeholder.to = 0;
+    std::vector<graph::Edge<double>> result_edges(edge_count, placeholder);
+    std::vector<bool> is_placeholder(edge_count, true);
+    for (size_t i = 0; i < edges.size(); i++)
+    {
+        result_edges[edge_ids[i]] = std::move(edges[i]);
+        is_placeholder[edge_ids[i]] = false;
+    }
+    //edges of a vertex go in the order of ids, as AddEdge adds them
+    std::vector<std::vector<graph::EdgeId>> incidence_lists(graph_.GetVertexCount());
+    for (size_t edge_id = 0; edge_id < result_edges.size(); edge_id++)
+    {
+        if (!is_placeholder[edge_id])
+        {
+            incidence_lists[result_edges[edge_id].from].push_back(edge_id);
+        }
+    }
+    graph_.SetEdges(std::move(result_edges));
+    graph_.SetIncidenceLists(std::move(incidence_lists));
+}
+
+memory_usage::MemoryUsage TransportRouter::GetMemoryUsage() const
+{
+    using namespace memory_usage;
+
+    size_t edges = OfVector(graph_.GetEdges());
+    for (const auto &edge : graph_.GetEdges())
+    {
+        edges += OfString(edge.bus_name) + OfString(edge.stop_name) + OfString(edge.stop_to_name);
+    }
+    size_t incidence_lists = OfVector(graph_.GetIncedenceLists());
+    for (const auto &incidence_list : graph_.GetIncedenceLists())
+    {
+        incidence_lists += OfVector(incidence_list);
+    }
+    size_t routes_internal_data = 0;
+    if (router_)
+    {
+        routes_internal_data = router_->GetRoutesStorage().GetMemoryUsage();
+    }
+
+    size_t lookup = OfHashTable(vertex_ids_to_stop_) + OfHashTable(stops_to_vertex_id_) + OfTree(using_stops_) +
+                    OfHashTable(stop_to_stops_distance_) + OfHashTable(bus_to_stops_);
+    for (const auto &[stop_name, vertex_id] : stops_to_vertex_id_)
+    {
+        lookup += OfString(stop_name);
+    }
+    for (const auto &stop_name : using_stops_)
+    {
+        lookup += OfString(stop_name);
+    }
+    for (const auto &[stop_name, distances] : stop_to_stops_distance_)
+    {
+        lookup += OfString(stop_name) + OfHashTable(distances);
+        for (const auto &[stop_to_name, distance] : distances)
+        {
+            lookup += OfString(stop_to_name);
+        }
+    }
+    for (const auto &[bus_name, stops] : bus_to_stops_)
+    {
+        lookup += OfString(bus_name) + OfVector(stops);
+        for (const auto &stop_name : stops)
+        {
+            lookup += OfString(stop_name);
+        }
+    }
+
+    return {
+        {"graph_edges", edges},
+        {"graph_incidence_lists", incidence_lists},
+        {"routes_internal_data", routes_internal_data},
+        {"lookup", lookup},
+    };
+}
+
 } // namespace transport_router
 } // namespace transport_catalogue
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "memory_usage.h"
 #include "router.h"
 #include "transport_catalogue.h"
 
@@ -14,16 +15,42 @@ namespace transport_catalogue
 namespace transport_router
 {
 
+inline const double DEFAULT_WALK_VELOCITY = 5.0;
+
+//wait and ride on a bus or a walk, names point into the graph and the catalogue and live as long as the router
+struct RouteItem
+{
+    graph::EdgeType type = graph::EdgeType::BUS;
+    std::string_view bus_name;
+    std::string_view stop_name;
+    //destination stop of a walk, empty if the walk ends at an arbitrary point
+    std::string_view stop_to_name;
+    int span_count = 0;
+    int wait_time = 0;
+    double time_in_road = 0;
+};
+
 struct RouteInfo
 {
     double total_time;
-    std::vector<graph::Edge<double>> items;
+    std::vector<RouteItem> items;
+};
+
+//stop to get on or off the route by foot
+struct WalkingStop
+{
+    std::string_view stop_name;
+    double distance;
 };
 
 struct TransportRouterParams
 {
     double bus_velocity;
     int bus_wait_time;
+    double walk_velocity = DEFAULT_WALK_VELOCITY;
+    //stops closer than this are connected with walking edges, 0 disables transfers
+    double walk_transfer_radius = 0;
+    std::unordered_map<std::string, geo::Coordinates> stops_coordinates;
     std::unordered_map<std::string, std::unordered_map<std::string, int>> stop_to_stops_distance;
     std::unordered_map<std::string, std::vector<std::string>> bus_to_stops;
     std::set<std::string> using_stops;
@@ -34,16 +61,20 @@ class TransportRouter
 private:
 public:
     using TransportGraph = graph::DirectedWeightedGraph<double>;
+    using RoutesStorage = graph::Router<double>::RoutesStorage;
 
-    explicit TransportRouter(TransportGraph graph, graph::Router<double>::RoutesInternalData internal_data,
-                             std::unordered_map<std::string, size_t> stops_to_vertex_id)
-        : graph_(std::move(graph)), stops_to_vertex_id_(std::move(stops_to_vertex_id))
+    explicit TransportRouter(TransportGraph graph, std::shared_ptr<const RoutesStorage> routes_storage,
+                             std::unordered_map<std::string, size_t> stops_to_vertex_id, double walk_velocity)
+        : walk_velocity_(walk_velocity), graph_(std::move(graph)), stops_to_vertex_id_(std::move(stops_to_vertex_id))
     {
-        router_.emplace(graph_, std::move(internal_data));
+        router_.emplace(graph_, std::move(routes_storage));
     }
 
-    explicit TransportRouter(TransportRouterParams router_params)
+    //with a base router stops and edges that didn't change keep their ids in it,
+    //so a delta against the base has only changed rows of the routes matrix
+    explicit TransportRouter(TransportRouterParams router_params, const TransportRouter *base_router = nullptr)
         : bus_velocity_(router_params.bus_velocity), bus_wait_time_(router_params.bus_wait_time),
+          walk_velocity_(router_params.walk_velocity),
           graph_(router_params.using_stops.size()), stop_to_stops_distance_(std::move(router_params.stop_to_stops_distance)),
           bus_to_stops_(std::move(std::move(router_params.bus_to_stops))), using_stops_(std::move(router_params.using_stops))
     {
@@ -56,16 +87,39 @@ public:
                 FinishStopRoute(i, stops, bus);
             }
         }
+        AddWalkingTransfers(router_params.stops_coordinates, router_params.walk_transfer_radius);
+        if (base_router)
+        {
+            KeepIdsOf(*base_router);
+        }
         router_.emplace(graph_);
     }
 
     std::optional<RouteInfo> BuildRoute(const std::string &stop_from, const std::string &stop_to) const;
 
-    size_t GetStopId(std::string_view stop_name) const;
+    //the fastest route that starts with a walk to one of from_stops and ends with a walk from one of to_stops,
+    //direct_distance is a length of the walk without buses if it is allowed
+    std::optional<RouteInfo> BuildRoute(const std::vector<WalkingStop> &from_stops, const std::vector<WalkingStop> &to_stops,
+                                        std::optional<double> direct_distance) const;
+
+    bool HasStop(const std::string &stop_name) const
+    {
+        return stops_to_vertex_id_.count(stop_name) > 0;
+    }
 
-    const auto &GetRoutesInternalData() const
+    double GetWalkVelocity() const
     {
-        return router_->GetRoutesInternalData();
+        return walk_velocity_;
+    }
+
+    const RoutesStorage &GetRoutesStorage() const
+    {
+        return router_->GetRoutesStorage();
+    }
+
+    const std::shared_ptr<const RoutesStorage> &ShareRoutesStorage() const
+    {
+        return router_->ShareRoutesStorage();
     }
 
     const TransportGraph &GetGraph() const
@@ -78,6 +132,9 @@ public:
         return stops_to_vertex_id_;
     }
 
+    //approximate heap bytes of the graph, the routes matrix and the lookup tables
+    memory_usage::MemoryUsage GetMemoryUsage() const;
+
 private:
     int GetDistanceBetweenStops(const std::string &stop_from, const std::string &stop_to) const
     {
@@ -101,14 +158,24 @@ private:
 
     double CalculateTime(double distanse, double velocity) const;
 
+    graph::Edge<double> MakeWalkEdge(std::string_view stop_from, std::string_view stop_to, double distance) const;
+
+    RouteItem MakeWalkItem(std::string_view stop_from, std::string_view stop_to, double distance) const;
+
     void FinishStopRoute(size_t stop_from_pos, const std::vector<std::string> &stops, const std::string& bus_name);
 
+    void AddWalkingTransfers(const std::unordered_map<std::string, geo::Coordinates> &stops_coordinates, double radius);
+
     void FinishConstructRouter();
 
     void CreateMap();
 
+    //renumbers vertices and edges of the built graph
+    void KeepIdsOf(const TransportRouter &base_router);
+
     double bus_velocity_;
     int bus_wait_time_;
+    double walk_velocity_ = DEFAULT_WALK_VELOCITY;
     TransportGraph graph_;
     std::optional<graph::Router<double>> router_ = std::nullopt;
     std::unordered_map<size_t, std::string_view> vertex_ids_to_stop_;
@@ -0,0 +1,28 @@
+#include "versioned_catalogue.h"
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+namespace transport_catalogue
+{
+
+std::shared_ptr<const CatalogueVersion> VersionedCatalogue::Acquire() const
+{
+    return std::atomic_load(&current_);
+}
+
+uint64_t VersionedCatalogue::Publish(std::shared_ptr<const FrozenCatalogue> catalogue)
+{
+    std::lock_guard guard(publish_mutex_);
+    auto version = std::make_shared<const CatalogueVersion>(CatalogueVersion{++last_version_, std::move(catalogue)});
+    std::atomic_store(&current_, std::move(version));
+    return last_version_;
+}
+
+uint64_t VersionedCatalogue::Load(const std::string &file_name)
+{
+    return Publish(FrozenCatalogue::Load(file_name));
+}
+
+} // namespace transport_catalogue
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "frozen_catalogue.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace transport_catalogue
+{
+
+struct CatalogueVersion
+{
+    uint64_t number = 0;
+    std::shared_ptr<const FrozenCatalogue> catalogue;
+};
+
+//Holds the current version of the catalogue and allows to replace it while it is being queried.
+//A reader acquires the version once per request and keeps using it even if a new one is published,
+//the old version is freed when the last reader releases it.
+class VersionedCatalogue
+{
+public:
+    //nullptr if nothing has been published yet
+    std::shared_ptr<const CatalogueVersion> Acquire() const;
+
+    //returns number of the published version
+    uint64_t Publish(std::shared_ptr<const FrozenCatalogue> catalogue);
+
+    //loads the database file and publishes it, queries are not blocked while loading
+    uint64_t Load(const std::string &file_name);
+
+private:
+    std::mutex publish_mutex_;
+    uint64_t last_version_ = 0;
+    std::shared_ptr<const CatalogueVersion> current_;
+};
+
+} // namespace transport_catalogue